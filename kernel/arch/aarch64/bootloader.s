@@ -7,13 +7,27 @@ _start:
     // Save the DTB pointer (x0) into x19 (callee-saved register) so it survives function calls.
     mov x19, x0
 
-    // Set up stack pointer
+    // Exceptions run on SP_EL1, with a stack of their own
+    ldr x1, =_exception_stack_top
+    mov sp, x1
+
+    // Everything else, threads included, runs on SP_EL0 (see exceptions.s)
+    msr spsel, #0
     ldr x1, =_stack_top
     mov sp, x1
 
+    ldr x1, =exception_vectors
+    msr vbar_el1, x1
+
+    // This is CPU 0 (cpu::id()), and no thread runs yet (current_thread())
+    msr tpidr_el1, xzr
+    msr tpidrro_el0, xzr
+
     // Enable FPU/SIMD (CPACR_EL1)
     //    Bits [20:21] control access to SIMD/FP at EL0/EL1.
     //    (3 << 20) sets both bits to 1 (access allowed).
+    //    Only the boot code runs with it on throughout. From the first context
+    //    switch on it traps until a thread uses it (threading.s).
     mrs x0, cpacr_el1
     orr x0, x0, #(3 << 20)
     msr cpacr_el1, x0
@@ -35,3 +49,53 @@ _start:
     b 1b
 
 .size _start, . - _start
+
+// PSCI CPU_ON starts the other CPUs here, with the MMU off and x0 pointing at
+// their BootBlock (see smp.cpp)
+.global _secondary_start
+.type _secondary_start, %function
+
+_secondary_start:
+    mov x19, x0
+
+    // The boot CPU's translation, then the MMU and caches on
+    ldr x1, [x19, #0]
+    msr mair_el1, x1
+    ldr x1, [x19, #8]
+    msr tcr_el1, x1
+    ldr x1, [x19, #16]
+    msr ttbr0_el1, x1
+    isb
+    tlbi vmalle1
+    ic iallu
+    dsb nsh
+    isb
+    ldr x1, [x19, #24]
+    msr sctlr_el1, x1
+    isb
+
+    // Exception and thread stacks, as on the boot CPU
+    ldr x1, [x19, #32]
+    mov sp, x1
+    msr spsel, #0
+    ldr x1, [x19, #40]
+    mov sp, x1
+
+    ldr x1, =exception_vectors
+    msr vbar_el1, x1
+
+    // Enable FPU/SIMD (CPACR_EL1), lazily switched once threads run
+    mrs x1, cpacr_el1
+    orr x1, x1, #(3 << 20)
+    msr cpacr_el1, x1
+    isb
+
+    ldr x0, [x19, #48]
+    msr tpidr_el1, x0
+    msr tpidrro_el0, xzr
+    bl secondary_main
+
+1:  wfe
+    b 1b
+
+.size _secondary_start, . - _secondary_start
@@ -0,0 +1,84 @@
+#pragma once
+#include "common/std/stdint.hpp"
+
+namespace cpu {
+    constexpr unsigned MAX_CPUS = 8;
+
+    // Index of this CPU, 0 for the boot CPU. Kept in TPIDR_EL1 from boot on.
+    inline unsigned id() {
+        std::uint64_t value;
+        asm volatile("mrs %0, tpidr_el1" : "=r"(value));
+        return static_cast<unsigned>(value);
+    };
+
+    // Virtual counter (CNTVCT_EL0), the isb keeps it from being read early
+    inline std::uint64_t counter() {
+        std::uint64_t value;
+        asm volatile("isb\n\tmrs %0, cntvct_el0" : "=r"(value) : : "memory");
+        return value;
+    };
+
+    // Counter ticks per second
+    inline std::uint64_t counter_frequency() {
+        std::uint64_t value;
+        asm volatile("mrs %0, cntfrq_el0" : "=r"(value));
+        return value;
+    };
+
+    // Whole and partial seconds are converted apart, so neither overflows
+    inline std::uint64_t counter_to_ns(const std::uint64_t ticks) {
+        const std::uint64_t frequency = counter_frequency();
+        return ticks / frequency * 1'000'000'000 + ticks % frequency * 1'000'000'000 / frequency;
+    };
+
+    // Rounds up, so a deadline computed with it is never early
+    inline std::uint64_t ns_to_counter(const std::uint64_t ns) {
+        const std::uint64_t frequency = counter_frequency();
+        return ns / 1'000'000'000 * frequency +
+               (ns % 1'000'000'000 * frequency + 999'999'999) / 1'000'000'000;
+    };
+
+    // Affinity fields of MPIDR_EL1 (Aff3..Aff0), as used in the FDT cpu reg
+    inline std::uint64_t affinity() {
+        std::uint64_t value;
+        asm volatile("mrs %0, mpidr_el1" : "=r"(value));
+        return value & 0xff00ffffffull;
+    };
+
+    // Masks IRQs, returns the previous DAIF for irq_restore()
+    inline std::uint64_t irq_save() {
+        std::uint64_t flags;
+        asm volatile("mrs %0, daif\n\tmsr daifset, #2" : "=r"(flags) : : "memory");
+        return flags;
+    };
+
+    inline void irq_restore(const std::uint64_t flags) {
+        asm volatile("msr daif, %0" : : "r"(flags) : "memory");
+    };
+
+    inline bool irqs_enabled() {
+        std::uint64_t flags;
+        asm volatile("mrs %0, daif" : "=r"(flags));
+        return !(flags & (1 << 7));
+    };
+
+    inline void irq_enable() {
+        asm volatile("msr daifclr, #2" : : : "memory");
+    };
+
+    // Spin-wait hint
+    inline void relax() {
+        asm volatile("yield" : : : "memory");
+    };
+
+    // Makes earlier stores visible, then wakes every CPU in wait_for_event()
+    inline void send_event() {
+        asm volatile("dsb ishst\n\tsev" : : : "memory");
+    };
+
+    // Sleeps until send_event() on any CPU or an interrupt. An event sent since
+    // the last wait ends it at once, so one sent after a check isn't missed.
+    inline void wait_for_event() {
+        asm volatile("wfe" : : : "memory");
+    };
+}; // namespace cpu
@@ -0,0 +1,64 @@
+#include "exceptions.hpp"
+#include "irq.hpp"
+
+#include <common/cppruntime_support.hpp>
+#include <common/lib/stack.hpp>
+#include <common/lib/thread.hpp>
+#include <common/std/print.hpp>
+
+// ESR_EL1 exception classes
+constexpr std::uint64_t EC_INSTRUCTION_ABORT = 0x21; // Same EL
+constexpr std::uint64_t EC_DATA_ABORT        = 0x25; // Same EL
+
+static const char* const KIND_NAMES[] = {
+    "synchronous", "IRQ", "FIQ", "SError",
+};
+
+static bool is_translation_fault(const std::uint64_t esr) {
+    // DFSC/IFSC 0b0001LL: translation fault at level LL
+    return (esr & 0x3c) == 0x04;
+};
+
+static void dump_frame(const ExceptionKind kind, const ExceptionFrame& frame,
+                       const std::uint64_t esr, const std::uint64_t far) {
+    const auto slot = static_cast<std::uint64_t>(kind);
+    std::println("Unhandled {} exception ({})", KIND_NAMES[slot % 4],
+                 slot < 4 ? "thread" : slot < 8 ? "in a handler" : "lower EL");
+    std::println("  ESR {}  FAR {}", reinterpret_cast<void*>(esr),
+                 reinterpret_cast<void*>(far));
+    std::println("  ELR {}  SPSR {}  SP {}", reinterpret_cast<void*>(frame.elr),
+                 reinterpret_cast<void*>(frame.spsr), reinterpret_cast<void*>(frame.sp_el0));
+
+    for (int i = 0; i < 31; i += 2) {
+        if (i == 30)
+            std::println("  x30 {}", reinterpret_cast<void*>(frame.x[30]));
+        else
+            std::println("  x{} {}  x{} {}", i, reinterpret_cast<void*>(frame.x[i]), i + 1,
+                         reinterpret_cast<void*>(frame.x[i + 1]));
+    };
+};
+
+extern "C" bool handle_exception(const ExceptionKind kind, ExceptionFrame* frame) {
+    if (kind == ExceptionKind::IRQ_SP0 || kind == ExceptionKind::IRQ_SPX) {
+        irq::dispatch();
+
+        // Only threads are preempted, never a handler
+        return kind == ExceptionKind::IRQ_SP0 && preemption_pending();
+    };
+
+    std::uint64_t esr, far;
+    asm volatile("mrs %0, esr_el1" : "=r"(esr));
+    asm volatile("mrs %0, far_el1" : "=r"(far));
+
+    const std::uint64_t ec = esr >> 26;
+    // Demand-grown thread stacks. Faults from SP_EL1 come from exceptions.s
+    // pushing a preempted thread's registers onto its stack.
+    const bool sync = kind == ExceptionKind::SYNC_SP0 || kind == ExceptionKind::SYNC_SPX;
+    if (sync && ec == EC_DATA_ABORT && is_translation_fault(esr)) {
+        if (stack_handle_fault(far))
+            return false;
+    };
+
+    dump_frame(kind, *frame, esr, far);
+    panic(ec == EC_DATA_ABORT || ec == EC_INSTRUCTION_ABORT ? "Page fault" : "Exception");
+};
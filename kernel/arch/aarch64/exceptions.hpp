@@ -0,0 +1,37 @@
+#pragma once
+#include "common/std/stdint.hpp"
+
+// Registers saved on exception entry (exceptions.s). Changes made by a handler
+// are restored on return.
+struct ExceptionFrame {
+    std::uint64_t x[31];
+    std::uint64_t elr;
+    std::uint64_t spsr;
+    std::uint64_t sp_el0;
+};
+
+static_assert(sizeof(ExceptionFrame) == 272, "exceptions.s relies on this layout");
+
+// Vector table slots, in table order
+enum class ExceptionKind : std::uint64_t {
+    SYNC_SP0,
+    IRQ_SP0,
+    FIQ_SP0,
+    SERROR_SP0,
+    SYNC_SPX,
+    IRQ_SPX,
+    FIQ_SPX,
+    SERROR_SPX,
+    SYNC_LOWER_64,
+    IRQ_LOWER_64,
+    FIQ_LOWER_64,
+    SERROR_LOWER_64,
+    SYNC_LOWER_32,
+    IRQ_LOWER_32,
+    FIQ_LOWER_32,
+    SERROR_LOWER_32,
+};
+
+// Returns true to preempt the interrupted thread: exceptions.s then moves the
+// frame onto the thread's own stack and switches away through preempt_schedule()
+extern "C" bool handle_exception(ExceptionKind kind, ExceptionFrame* frame);
@@ -0,0 +1,368 @@
+// EL1 exception vectors
+//
+// Threads run on SP_EL0 (EL1t), so exceptions taken from them enter through the
+// "current EL with SP0" slots and run on SP_EL1, a separate exception stack. A
+// thread that overflows into its guard page can therefore still be handled.
+// Anything taken while already on SP_EL1 is a fault in a handler and fatal,
+// apart from stack faults on the preemption path below and FP/SIMD traps.
+//
+// Entry saves every general purpose register plus ELR, SPSR and SP_EL0 as an
+// ExceptionFrame (exceptions.hpp). FP/SIMD is switched lazily (threading.s):
+// when CPACR_EL1 lets it through, the registers hold the interrupted thread's
+// live state, and entry saves every one of them below the frame. A C++ handler
+// only preserves the low halves of v8-v15, and interrupted code may have live
+// values anywhere. When it traps, they hold nothing of the thread's and entry
+// saves nothing. A handler that uses FP/SIMD then gets it enabled for itself
+// by fp_trap, and it traps again once the handler returns.
+//
+// To preempt a thread, the IRQ path can't switch while its frame sits on the
+// shared exception stack. It copies the frame, plus the thread's FP/SIMD state,
+// onto the thread's own stack and erets into preempt_resume on that stack.
+// There the thread yields like any other, and when it is picked again the
+// full frame is restored and it resumes where the interrupt hit.
+
+.equ FRAME_SIZE,         272
+.equ FP_FRAME_SIZE,      528    // q0-q31, FPSR/FPCR
+.equ PREEMPT_FRAME_SIZE, 800    // ExceptionFrame, q0-q31, FPSR/FPCR
+.equ SPSR_EL1T_MASKED,   0x3c4  // EL1t with DAIF all set
+.equ CONTEXT_FP,         128    // ThreadContext::fp, ctx is Thread's first member
+.equ CPACR_FPEN,         (3 << 20)
+.equ EC_FP_ACCESS,       0x07   // ESR_EL1 class of a trapped FP/SIMD instruction
+
+.macro VECTOR kind
+    .balign 0x80
+    sub sp, sp, #FRAME_SIZE
+    stp x0, x1, [sp, #16 * 0]
+    mov x0, #\kind
+    b exception_entry
+.endm
+
+.text
+.balign 2048
+.global exception_vectors
+.type exception_vectors, %function
+
+exception_vectors:
+    VECTOR 0    // Current EL, SP0: synchronous
+    VECTOR 1    // IRQ
+    VECTOR 2    // FIQ
+    VECTOR 3    // SError
+    VECTOR 4    // Current EL, SPx
+    VECTOR 5
+    VECTOR 6
+    VECTOR 7
+    VECTOR 8    // Lower EL, AArch64
+    VECTOR 9
+    VECTOR 10
+    VECTOR 11
+    VECTOR 12   // Lower EL, AArch32
+    VECTOR 13
+    VECTOR 14
+    VECTOR 15
+
+.size exception_vectors, .-exception_vectors
+
+.type exception_entry, %function
+
+// x0 = kind, x0/x1 already saved
+exception_entry:
+    bic x1, x0, #4              // Kinds 0 and 4: synchronous, from a thread or a handler
+    cbnz x1, 1f
+    mrs x1, esr_el1
+    lsr x1, x1, #26
+    cmp x1, #EC_FP_ACCESS
+    b.eq fp_trap
+
+1:
+    stp x2, x3, [sp, #16 * 1]
+    stp x4, x5, [sp, #16 * 2]
+    stp x6, x7, [sp, #16 * 3]
+    stp x8, x9, [sp, #16 * 4]
+    stp x10, x11, [sp, #16 * 5]
+    stp x12, x13, [sp, #16 * 6]
+    stp x14, x15, [sp, #16 * 7]
+    stp x16, x17, [sp, #16 * 8]
+    stp x18, x19, [sp, #16 * 9]
+    stp x20, x21, [sp, #16 * 10]
+    stp x22, x23, [sp, #16 * 11]
+    stp x24, x25, [sp, #16 * 12]
+    stp x26, x27, [sp, #16 * 13]
+    stp x28, x29, [sp, #16 * 14]
+    mrs x1, elr_el1
+    stp x30, x1, [sp, #16 * 15]
+    mrs x2, spsr_el1
+    mrs x3, sp_el0
+    stp x2, x3, [sp, #16 * 16]
+    mov x1, sp                  // ExceptionFrame*
+
+    // x20 = CPACR_EL1 on entry, restored from the frame on return like x19
+    mrs x20, cpacr_el1
+    sub sp, sp, #FP_FRAME_SIZE
+    tbz x20, #20, 1f
+    stp q0, q1, [sp, #32 * 0]
+    stp q2, q3, [sp, #32 * 1]
+    stp q4, q5, [sp, #32 * 2]
+    stp q6, q7, [sp, #32 * 3]
+    stp q8, q9, [sp, #32 * 4]
+    stp q10, q11, [sp, #32 * 5]
+    stp q12, q13, [sp, #32 * 6]
+    stp q14, q15, [sp, #32 * 7]
+    stp q16, q17, [sp, #32 * 8]
+    stp q18, q19, [sp, #32 * 9]
+    stp q20, q21, [sp, #32 * 10]
+    stp q22, q23, [sp, #32 * 11]
+    stp q24, q25, [sp, #32 * 12]
+    stp q26, q27, [sp, #32 * 13]
+    stp q28, q29, [sp, #32 * 14]
+    stp q30, q31, [sp, #32 * 15]
+    mrs x2, fpsr
+    mrs x3, fpcr
+    str x2, [sp, #32 * 16]      // Past the reach of stp
+    str x3, [sp, #32 * 16 + 8]
+
+1:
+    bl handle_exception
+    and w19, w0, #0xff          // Preempt? x19 itself is restored from the frame
+
+    tbnz x20, #20, 1f
+
+    // Nothing of the thread's to restore. If the handler used FP/SIMD, trap again.
+    mrs x2, cpacr_el1
+    tbz x2, #20, 2f
+    msr cpacr_el1, x20
+    isb
+    b 2f
+
+1:
+    ldr x2, [sp, #32 * 16]
+    ldr x3, [sp, #32 * 16 + 8]
+    msr fpsr, x2
+    msr fpcr, x3
+    ldp q0, q1, [sp, #32 * 0]
+    ldp q2, q3, [sp, #32 * 1]
+    ldp q4, q5, [sp, #32 * 2]
+    ldp q6, q7, [sp, #32 * 3]
+    ldp q8, q9, [sp, #32 * 4]
+    ldp q10, q11, [sp, #32 * 5]
+    ldp q12, q13, [sp, #32 * 6]
+    ldp q14, q15, [sp, #32 * 7]
+    ldp q16, q17, [sp, #32 * 8]
+    ldp q18, q19, [sp, #32 * 9]
+    ldp q20, q21, [sp, #32 * 10]
+    ldp q22, q23, [sp, #32 * 11]
+    ldp q24, q25, [sp, #32 * 12]
+    ldp q26, q27, [sp, #32 * 13]
+    ldp q28, q29, [sp, #32 * 14]
+    ldp q30, q31, [sp, #32 * 15]
+
+2:
+    add sp, sp, #FP_FRAME_SIZE
+    cbnz w19, .Lpreempt
+
+    // The handler may have changed the frame (e.g. to skip an instruction)
+    ldp x2, x3, [sp, #16 * 16]
+    msr spsr_el1, x2
+    msr sp_el0, x3
+    ldp x30, x1, [sp, #16 * 15]
+    msr elr_el1, x1
+    ldp x0, x1, [sp, #16 * 0]
+    ldp x2, x3, [sp, #16 * 1]
+    ldp x4, x5, [sp, #16 * 2]
+    ldp x6, x7, [sp, #16 * 3]
+    ldp x8, x9, [sp, #16 * 4]
+    ldp x10, x11, [sp, #16 * 5]
+    ldp x12, x13, [sp, #16 * 6]
+    ldp x14, x15, [sp, #16 * 7]
+    ldp x16, x17, [sp, #16 * 8]
+    ldp x18, x19, [sp, #16 * 9]
+    ldp x20, x21, [sp, #16 * 10]
+    ldp x22, x23, [sp, #16 * 11]
+    ldp x24, x25, [sp, #16 * 12]
+    ldp x26, x27, [sp, #16 * 13]
+    ldp x28, x29, [sp, #16 * 14]
+    add sp, sp, #FRAME_SIZE
+    eret
+
+.Lpreempt:
+    // x2 = preempt frame, just below the interrupted thread's SP. These writes
+    // may fault in more stack pages, through the SP_EL1 sync vector.
+    ldr x2, [sp, #16 * 16 + 8]
+    sub x2, x2, #PREEMPT_FRAME_SIZE
+
+    // The frame always carries the thread's FP/SIMD state, so nothing that
+    // preempt_schedule() does with FP/SIMD can reach it. If the thread hadn't
+    // used FP/SIMD since it was switched in, its state is still in ctx.fp:
+    // load it like fp_trap would.
+    tbnz x20, #20, 1f
+    orr x4, x20, #CPACR_FPEN
+    msr cpacr_el1, x4
+    isb
+    mrs x3, tpidrro_el0         // current_thread()
+    add x3, x3, #CONTEXT_FP
+    ldp q0, q1, [x3, #32 * 0]
+    ldp q2, q3, [x3, #32 * 1]
+    ldp q4, q5, [x3, #32 * 2]
+    ldp q6, q7, [x3, #32 * 3]
+    ldp q8, q9, [x3, #32 * 4]
+    ldp q10, q11, [x3, #32 * 5]
+    ldp q12, q13, [x3, #32 * 6]
+    ldp q14, q15, [x3, #32 * 7]
+    ldp q16, q17, [x3, #32 * 8]
+    ldp q18, q19, [x3, #32 * 9]
+    ldp q20, q21, [x3, #32 * 10]
+    ldp q22, q23, [x3, #32 * 11]
+    ldp q24, q25, [x3, #32 * 12]
+    ldp q26, q27, [x3, #32 * 13]
+    ldp q28, q29, [x3, #32 * 14]
+    ldp q30, q31, [x3, #32 * 15]
+    ldr x4, [x3, #32 * 16]
+    msr fpsr, x4
+    ldr x4, [x3, #32 * 16 + 8]
+    msr fpcr, x4
+
+1:
+    add x3, x2, #FRAME_SIZE
+    stp q0, q1, [x3, #32 * 0]
+    stp q2, q3, [x3, #32 * 1]
+    stp q4, q5, [x3, #32 * 2]
+    stp q6, q7, [x3, #32 * 3]
+    stp q8, q9, [x3, #32 * 4]
+    stp q10, q11, [x3, #32 * 5]
+    stp q12, q13, [x3, #32 * 6]
+    stp q14, q15, [x3, #32 * 7]
+    stp q16, q17, [x3, #32 * 8]
+    stp q18, q19, [x3, #32 * 9]
+    stp q20, q21, [x3, #32 * 10]
+    stp q22, q23, [x3, #32 * 11]
+    stp q24, q25, [x3, #32 * 12]
+    stp q26, q27, [x3, #32 * 13]
+    stp q28, q29, [x3, #32 * 14]
+    stp q30, q31, [x3, #32 * 15]
+    mrs x4, fpsr
+    mrs x5, fpcr
+    str x4, [x3, #32 * 16]      // Past the reach of stp
+    str x5, [x3, #32 * 16 + 8]
+
+    // Then the general purpose frame, 16 bytes at a time
+    mov x3, sp
+    mov x6, x2
+    mov x7, #FRAME_SIZE / 16
+1:
+    ldp x4, x5, [x3], #16
+    stp x4, x5, [x6], #16
+    subs x7, x7, #1
+    b.ne 1b
+
+    // Leave the exception stack empty and "return" into preempt_resume on the
+    // thread's stack, still masked so nothing else lands on top of the frame
+    add sp, sp, #FRAME_SIZE
+    msr sp_el0, x2
+    adr x3, preempt_resume
+    msr elr_el1, x3
+    mov x3, #SPSR_EL1T_MASKED
+    msr spsr_el1, x3
+    eret
+
+.size exception_entry, .-exception_entry
+
+.type preempt_resume, %function
+
+// On the preempted thread's stack, SP = its preempt frame
+preempt_resume:
+    bl preempt_schedule
+
+    // Picked again: restore everything and return to the interrupted code.
+    // IRQs are still masked, so ELR/SPSR stay ours until the eret. FP/SIMD is
+    // enabled for the registers from the frame, which supersede ctx.fp.
+    mrs x1, cpacr_el1
+    orr x1, x1, #CPACR_FPEN
+    msr cpacr_el1, x1
+    isb
+    add x0, sp, #FRAME_SIZE
+    ldp q0, q1, [x0, #32 * 0]
+    ldp q2, q3, [x0, #32 * 1]
+    ldp q4, q5, [x0, #32 * 2]
+    ldp q6, q7, [x0, #32 * 3]
+    ldp q8, q9, [x0, #32 * 4]
+    ldp q10, q11, [x0, #32 * 5]
+    ldp q12, q13, [x0, #32 * 6]
+    ldp q14, q15, [x0, #32 * 7]
+    ldp q16, q17, [x0, #32 * 8]
+    ldp q18, q19, [x0, #32 * 9]
+    ldp q20, q21, [x0, #32 * 10]
+    ldp q22, q23, [x0, #32 * 11]
+    ldp q24, q25, [x0, #32 * 12]
+    ldp q26, q27, [x0, #32 * 13]
+    ldp q28, q29, [x0, #32 * 14]
+    ldp q30, q31, [x0, #32 * 15]
+    ldr x1, [x0, #32 * 16]
+    ldr x2, [x0, #32 * 16 + 8]
+    msr fpsr, x1
+    msr fpcr, x2
+
+    ldp x1, x2, [sp, #16 * 15 + 8]  // ELR, SPSR
+    msr elr_el1, x1
+    msr spsr_el1, x2
+    ldp x0, x1, [sp, #16 * 0]
+    ldp x2, x3, [sp, #16 * 1]
+    ldp x4, x5, [sp, #16 * 2]
+    ldp x6, x7, [sp, #16 * 3]
+    ldp x8, x9, [sp, #16 * 4]
+    ldp x10, x11, [sp, #16 * 5]
+    ldp x12, x13, [sp, #16 * 6]
+    ldp x14, x15, [sp, #16 * 7]
+    ldp x16, x17, [sp, #16 * 8]
+    ldp x18, x19, [sp, #16 * 9]
+    ldp x20, x21, [sp, #16 * 10]
+    ldp x22, x23, [sp, #16 * 11]
+    ldp x24, x25, [sp, #16 * 12]
+    ldp x26, x27, [sp, #16 * 13]
+    ldp x28, x29, [sp, #16 * 14]
+    ldr x30, [sp, #16 * 15]
+    add sp, sp, #PREEMPT_FRAME_SIZE
+    eret
+
+.size preempt_resume, .-preempt_resume
+
+.type fp_trap, %function
+
+// The first FP/SIMD instruction since a switch, x0 = kind, x0/x1 saved. A
+// thread gets its own registers loaded. A handler's registers are scratch, and
+// the IRQ return path disables FP/SIMD again. Either way, the instruction
+// runs again after the eret.
+fp_trap:
+    mrs x1, cpacr_el1
+    orr x1, x1, #CPACR_FPEN
+    msr cpacr_el1, x1
+    isb
+    cbnz x0, 1f
+
+    mrs x0, tpidrro_el0         // current_thread()
+    add x0, x0, #CONTEXT_FP
+    ldp q0, q1, [x0, #32 * 0]
+    ldp q2, q3, [x0, #32 * 1]
+    ldp q4, q5, [x0, #32 * 2]
+    ldp q6, q7, [x0, #32 * 3]
+    ldp q8, q9, [x0, #32 * 4]
+    ldp q10, q11, [x0, #32 * 5]
+    ldp q12, q13, [x0, #32 * 6]
+    ldp q14, q15, [x0, #32 * 7]
+    ldp q16, q17, [x0, #32 * 8]
+    ldp q18, q19, [x0, #32 * 9]
+    ldp q20, q21, [x0, #32 * 10]
+    ldp q22, q23, [x0, #32 * 11]
+    ldp q24, q25, [x0, #32 * 12]
+    ldp q26, q27, [x0, #32 * 13]
+    ldp q28, q29, [x0, #32 * 14]
+    ldp q30, q31, [x0, #32 * 15]
+    ldr x1, [x0, #32 * 16]
+    msr fpsr, x1
+    ldr x1, [x0, #32 * 16 + 8]
+    msr fpcr, x1
+
+1:
+    ldp x0, x1, [sp, #16 * 0]
+    add sp, sp, #FRAME_SIZE
+    eret
+
+.size fp_trap, .-fp_trap
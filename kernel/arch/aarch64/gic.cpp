@@ -0,0 +1,242 @@
+#include "gic.hpp"
+#include "cpu.hpp"
+#include "mmu.hpp"
+
+#include <common/drivers/fdt.hpp>
+#include <common/std/print.hpp>
+
+// Distributor registers
+constexpr std::uintptr_t GICD_CTLR       = 0x000;
+constexpr std::uintptr_t GICD_TYPER      = 0x004;
+constexpr std::uintptr_t GICD_IGROUPR    = 0x080;
+constexpr std::uintptr_t GICD_ISENABLER  = 0x100;
+constexpr std::uintptr_t GICD_ICENABLER  = 0x180;
+constexpr std::uintptr_t GICD_IPRIORITYR = 0x400;
+constexpr std::uintptr_t GICD_ITARGETSR  = 0x800;  // v2 only
+constexpr std::uintptr_t GICD_IROUTER    = 0x6000; // v3 only, 64 bits per SPI
+
+constexpr std::uint32_t GICD_CTLR_RWP = 1u << 31;
+
+// GICv2 CPU interface registers
+constexpr std::uintptr_t GICC_CTLR = 0x000;
+constexpr std::uintptr_t GICC_PMR  = 0x004;
+constexpr std::uintptr_t GICC_IAR  = 0x00c;
+constexpr std::uintptr_t GICC_EOIR = 0x010;
+
+// GICv3 redistributor: an RD_base frame, then the SGI_base frame holding the
+// SGI and PPI registers
+constexpr std::uintptr_t GICR_FRAME_SIZE = 0x20000;
+constexpr std::uintptr_t GICR_TYPER      = 0x008;
+constexpr std::uintptr_t GICR_WAKER      = 0x014;
+constexpr std::uintptr_t GICR_SGI_BASE   = 0x10000;
+constexpr std::uintptr_t GICR_IGROUPR0   = GICR_SGI_BASE + 0x080;
+constexpr std::uintptr_t GICR_ISENABLER0 = GICR_SGI_BASE + 0x100;
+constexpr std::uintptr_t GICR_ICENABLER0 = GICR_SGI_BASE + 0x180;
+constexpr std::uintptr_t GICR_IPRIORITYR = GICR_SGI_BASE + 0x400;
+constexpr std::uint64_t  GICR_TYPER_LAST = 1u << 4;
+constexpr std::uint32_t  WAKER_SLEEP     = 1u << 1; // ProcessorSleep
+constexpr std::uint32_t  WAKER_CHILDREN  = 1u << 2; // ChildrenAsleep
+
+constexpr std::uint8_t DEFAULT_PRIORITY = 0xa0; // Lower is more urgent, PMR lets all through
+
+// GICv3 first, the rest are GICv2
+static const char* const COMPATIBLES[] = {"arm,gic-v3", "arm,cortex-a15-gic", "arm,gic-400",
+                                          "arm,cortex-a9-gic", nullptr};
+
+static unsigned       gic_version;
+static std::uintptr_t distributor;
+static std::uintptr_t cpu_interface;                 // v2, banked per CPU
+static fdt::Region    redistributor_region;          // v3
+static std::uintptr_t redistributors[cpu::MAX_CPUS]; // v3, each CPU's RD_base
+
+static volatile std::uint32_t& gicd(const std::uintptr_t offset) {
+    return *reinterpret_cast<volatile std::uint32_t*>(distributor + offset);
+};
+
+static volatile std::uint32_t& gicc(const std::uintptr_t offset) {
+    return *reinterpret_cast<volatile std::uint32_t*>(cpu_interface + offset);
+};
+
+static volatile std::uint32_t& gicr(const std::uintptr_t offset) {
+    return *reinterpret_cast<volatile std::uint32_t*>(redistributors[cpu::id()] + offset);
+};
+
+static void wait_for_rwp() {
+    while (gicd(GICD_CTLR) & GICD_CTLR_RWP) {};
+};
+
+// Redistributors are packed frames, each naming the CPU it serves in the top
+// half of GICR_TYPER as Aff3.Aff2.Aff1.Aff0
+static std::uintptr_t find_redistributor(const fdt::Region& region) {
+    const std::uint64_t mpidr    = cpu::affinity();
+    const std::uint64_t affinity = ((mpidr >> 32) & 0xff) << 24 | (mpidr & 0xffffff);
+
+    for (std::uintptr_t frame = region.base; frame < region.base + region.size;
+         frame += GICR_FRAME_SIZE) {
+        const std::uint64_t typer =
+            *reinterpret_cast<volatile std::uint64_t*>(frame + GICR_TYPER);
+        if (typer >> 32 == affinity)
+            return frame;
+        if (typer & GICR_TYPER_LAST)
+            break;
+    };
+
+    return 0;
+};
+
+static void initialize_v2(const unsigned lines) {
+    // Everything off at a common priority, SPIs routed to this CPU
+    gicd(GICD_CTLR) = 0;
+    for (unsigned i = 0; i < lines; i += 32) gicd(GICD_ICENABLER + i / 8) = ~0u;
+    for (unsigned i = 0; i < lines; i += 4) {
+        gicd(GICD_IPRIORITYR + i) = DEFAULT_PRIORITY * 0x01010101u;
+        if (i >= 32)
+            gicd(GICD_ITARGETSR + i) = 0x01010101u;
+    };
+
+    gicd(GICD_CTLR) = 1;
+};
+
+// Banked per CPU: the SGI and PPI registers of the distributor and the whole
+// CPU interface
+static void initialize_v2_cpu() {
+    gicd(GICD_ICENABLER) = ~0u;
+    for (unsigned i = 0; i < 32; i += 4)
+        gicd(GICD_IPRIORITYR + i) = DEFAULT_PRIORITY * 0x01010101u;
+
+    gicc(GICC_PMR)  = 0xff;
+    gicc(GICC_CTLR) = 1;
+};
+
+static void initialize_v3(const unsigned lines) {
+    // Affinity routing (ARE) on before anything else, then SPIs as Group 1,
+    // disabled, at a common priority and routed to this CPU
+    gicd(GICD_CTLR) = 0;
+    wait_for_rwp();
+    gicd(GICD_CTLR) = 1u << 4;
+    wait_for_rwp();
+
+    for (unsigned i = 32; i < lines; i += 32) {
+        gicd(GICD_ICENABLER + i / 8) = ~0u;
+        gicd(GICD_IGROUPR + i / 8)   = ~0u;
+    };
+    for (unsigned i = 32; i < lines; i += 4)
+        gicd(GICD_IPRIORITYR + i) = DEFAULT_PRIORITY * 0x01010101u;
+    for (unsigned i = 32; i < lines && i < 1020; ++i)
+        *reinterpret_cast<volatile std::uint64_t*>(distributor + GICD_IROUTER + i * 8) =
+            cpu::affinity();
+
+    gicd(GICD_CTLR) = 1u << 4 | 1u << 1; // ARE, EnableGrp1
+    wait_for_rwp();
+};
+
+static void initialize_v3_cpu() {
+    // Wake this CPU's redistributor, then set up its SGIs and PPIs like the SPIs
+    gicr(GICR_WAKER) = gicr(GICR_WAKER) & ~WAKER_SLEEP;
+    while (gicr(GICR_WAKER) & WAKER_CHILDREN) {};
+
+    gicr(GICR_ICENABLER0) = ~0u;
+    gicr(GICR_IGROUPR0)   = ~0u;
+    for (unsigned i = 0; i < 32; i += 4)
+        gicr(GICR_IPRIORITYR + i) = DEFAULT_PRIORITY * 0x01010101u;
+
+    // The CPU interface is the ICC system registers
+    std::uint64_t sre;
+    asm volatile("mrs %0, icc_sre_el1" : "=r"(sre));
+    asm volatile("msr icc_sre_el1, %0\n\tisb" : : "r"(sre | 1));
+    asm volatile("msr icc_pmr_el1, %0" : : "r"(0xffull));
+    asm volatile("msr icc_igrpen1_el1, %0\n\tisb" : : "r"(1ull));
+};
+
+namespace gic {
+    bool initialize() {
+        fdt::InterruptController node;
+        if (!fdt::get_interrupt_controller(COMPATIBLES, node) || node.region_count < 2) {
+            std::println("GIC: no GICv2 or GICv3 in the device tree, interrupts stay off");
+            return false;
+        };
+
+        // The v2 virtualisation regions that follow aren't used
+        for (std::size_t i = 0; i < 2; ++i) {
+            if (!mmu::map_identity(node.regions[i].base, node.regions[i].size,
+                                   mmu::MemoryType::DEVICE))
+                return false;
+        };
+
+        distributor          = node.regions[0].base;
+        const unsigned lines = ((gicd(GICD_TYPER) & 0x1f) + 1) * 32;
+
+        if (node.compatible == COMPATIBLES[0]) {
+            redistributor_region = node.regions[1];
+            gic_version          = 3;
+            initialize_v3(lines);
+        }
+        else {
+            cpu_interface = node.regions[1].base;
+            gic_version   = 2;
+            initialize_v2(lines);
+        };
+
+        if (!initialize_cpu()) {
+            gic_version = 0;
+            return false;
+        };
+
+        std::println("GIC: v{} with {} interrupt lines", gic_version, lines);
+        return true;
+    };
+
+    bool initialize_cpu() {
+        if (gic_version == 2) {
+            initialize_v2_cpu();
+            return true;
+        };
+
+        if (gic_version != 3)
+            return false;
+
+        redistributors[cpu::id()] = find_redistributor(redistributor_region);
+        if (!redistributors[cpu::id()]) {
+            std::println("GIC: no redistributor for CPU {}, its interrupts stay off", cpu::id());
+            return false;
+        };
+
+        initialize_v3_cpu();
+        return true;
+    };
+
+    unsigned version() {
+        return gic_version;
+    };
+
+    void enable(const unsigned intid) {
+        if (gic_version == 3 && intid < 32)
+            gicr(GICR_ISENABLER0) = 1u << intid;
+        else if (gic_version)
+            gicd(GICD_ISENABLER + intid / 32 * 4) = 1u << (intid % 32);
+    };
+
+    void disable(const unsigned intid) {
+        if (gic_version == 3 && intid < 32)
+            gicr(GICR_ICENABLER0) = 1u << intid;
+        else if (gic_version)
+            gicd(GICD_ICENABLER + intid / 32 * 4) = 1u << (intid % 32);
+    };
+
+    unsigned acknowledge() {
+        if (gic_version == 3) {
+            std::uint64_t iar;
+            asm volatile("mrs %0, icc_iar1_el1" : "=r"(iar) : : "memory");
+            return iar & 0xffffff;
+        };
+
+        return gicc(GICC_IAR) & 0x3ff;
+    };
+
+    void end_of_interrupt(const unsigned intid) {
+        if (gic_version == 3)
+            asm volatile("msr icc_eoir1_el1, %0" : : "r"(std::uint64_t{intid}) : "memory");
+        else
+            gicc(GICC_EOIR) = intid;
+    };
+}; // namespace gic
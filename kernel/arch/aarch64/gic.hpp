@@ -0,0 +1,30 @@
+#pragma once
+#include "common/std/stdint.hpp"
+
+// GICv2 or GICv3 interrupt controller, whichever the FDT interrupt-controller
+// node describes (QEMU virt picks with gic-version=). Every CPU sets up its own
+// interface; shared interrupts (SPIs) are all routed to the boot CPU.
+namespace gic {
+    constexpr unsigned SPURIOUS = 1023; // acknowledge() with nothing pending
+
+    // Finds the GIC in the FDT, maps it and enables it with every interrupt
+    // disabled. False if there is none.
+    bool initialize();
+
+    // The calling CPU's interface (and v3 redistributor), for secondary CPUs
+    // once initialize() succeeded on the boot CPU. Its SGIs and PPIs start
+    // disabled.
+    bool initialize_cpu();
+
+    // 2 or 3, 0 before a successful initialize()
+    unsigned version();
+
+    // SGIs and PPIs (below 32) only on the calling CPU
+    void enable(unsigned intid);
+    void disable(unsigned intid);
+
+    // Highest-priority pending interrupt, which becomes active until
+    // end_of_interrupt()
+    unsigned acknowledge();
+    void     end_of_interrupt(unsigned intid);
+}; // namespace gic
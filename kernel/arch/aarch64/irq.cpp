@@ -0,0 +1,129 @@
+#include "irq.hpp"
+#include "cpu.hpp"
+#include "gic.hpp"
+
+#include <common/cppruntime_support.hpp>
+#include <common/lib/spinlock.hpp>
+#include <common/std/print.hpp>
+
+struct IrqEntry {
+    irq::Handler   handler;
+    void*          context;
+    irq::IrqStats* stats; // From the first registration on, kept after unregister
+};
+
+static IrqEntry handlers[irq::MAX_IRQS];
+static SpinLock handlers_lock; // Registration only, dispatch() reads without it
+
+// Every CPU dispatches its own PPIs, so the stats are updated atomically
+static void record(std::uint64_t* histogram, std::uint64_t& max, const std::uint64_t ticks) {
+    const unsigned log2   = 63 - __builtin_clzll(ticks | 1);
+    const unsigned bucket = log2 < irq::HISTOGRAM_BUCKETS ? log2 : irq::HISTOGRAM_BUCKETS - 1;
+    __atomic_fetch_add(&histogram[bucket], 1, __ATOMIC_RELAXED);
+
+    std::uint64_t seen = __atomic_load_n(&max, __ATOMIC_RELAXED);
+    while (ticks > seen &&
+           !__atomic_compare_exchange_n(&max, &seen, ticks, true, __ATOMIC_RELAXED,
+                                        __ATOMIC_RELAXED)) {};
+};
+
+static void dump_histogram(const char* name, const std::uint64_t* histogram) {
+    for (unsigned i = 0; i < irq::HISTOGRAM_BUCKETS; ++i) {
+        if (histogram[i])
+            std::println("  {} >= {} ns: {}", name, cpu::counter_to_ns(i ? 1ull << i : 0),
+                         histogram[i]);
+    };
+};
+
+namespace irq {
+    bool register_handler(const unsigned intid, const Handler handler, void* context) {
+        if (intid >= MAX_IRQS || !handler || handlers[intid].handler)
+            return false;
+
+        // Allocated before IRQs are masked, the heap may block
+        IrqStats* stats = handlers[intid].stats ? nullptr : new IrqStats{};
+
+        bool registered = false;
+        {
+            const IrqSpinLockScope guard(handlers_lock);
+            IrqEntry&              entry = handlers[intid];
+            if (!entry.handler) {
+                if (!entry.stats) {
+                    entry.stats = stats;
+                    stats       = nullptr;
+                };
+
+                entry.context = context;
+                __atomic_store_n(&entry.handler, handler, __ATOMIC_RELEASE);
+                gic::enable(intid);
+                registered = true;
+            };
+        };
+
+        // Another CPU registered first, or the stats of an earlier registration are kept
+        delete stats;
+        return registered;
+    };
+
+    void unregister_handler(const unsigned intid) {
+        if (intid >= MAX_IRQS)
+            return;
+
+        const IrqSpinLockScope guard(handlers_lock);
+        gic::disable(intid);
+        handlers[intid].handler = nullptr;
+        handlers[intid].context = nullptr;
+    };
+
+    void dispatch() {
+        // 1020-1022 are special INTIDs with nothing to handle
+        for (unsigned intid; (intid = gic::acknowledge()) < MAX_IRQS;) {
+            const IrqEntry&    entry   = handlers[intid];
+            const irq::Handler handler = __atomic_load_n(&entry.handler, __ATOMIC_ACQUIRE);
+            if (!handler) {
+                // Nothing will clear it, so keep it from firing again
+                gic::disable(intid);
+                gic::end_of_interrupt(intid);
+                std::println("Unexpected IRQ {}, disabled", intid);
+                continue;
+            };
+
+            const std::uint64_t start  = cpu::counter();
+            const std::uint64_t raised = handler(entry.context);
+            const std::uint64_t end    = cpu::counter();
+            gic::end_of_interrupt(intid);
+
+            IrqStats& stats = *entry.stats;
+            __atomic_fetch_add(&stats.count, 1, __ATOMIC_RELAXED);
+            record(stats.service_histogram, stats.service_max, end - start);
+            if (raised && raised <= start)
+                record(stats.latency_histogram, stats.latency_max, start - raised);
+        };
+    };
+
+    bool get_stats(const unsigned intid, IrqStats& out) {
+        if (intid >= MAX_IRQS || !handlers[intid].stats)
+            return false;
+
+        // A snapshot, other CPUs may be counting meanwhile
+        out = *handlers[intid].stats;
+        return true;
+    };
+
+    void dump_stats() {
+        std::println("--- IRQ Stats ---");
+        for (unsigned intid = 0; intid < MAX_IRQS; ++intid) {
+            IrqStats stats;
+            if (!get_stats(intid, stats) || !stats.count)
+                continue;
+
+            std::println("IRQ {}: {} taken, latency max {} ns, handler max {} ns", intid,
+                         stats.count, cpu::counter_to_ns(stats.latency_max),
+                         cpu::counter_to_ns(stats.service_max));
+            dump_histogram("latency", stats.latency_histogram);
+            dump_histogram("handler", stats.service_histogram);
+        };
+
+        std::println("-----------------");
+    };
+}; // namespace irq
@@ -0,0 +1,40 @@
+#pragma once
+#include "common/std/stdint.hpp"
+
+// Interrupt dispatch: one handler per GIC INTID, with per-interrupt counters and
+// CNTVCT_EL0-based timing
+namespace irq {
+    constexpr unsigned MAX_IRQS          = 1020; // SGIs, PPIs and SPIs. 1020+ are special.
+    constexpr unsigned HISTOGRAM_BUCKETS = 16;
+
+    // Runs on the exception stack with IRQs masked, so it may wake threads but
+    // never block. Returns the counter value when the device raised the
+    // interrupt if it knows it (a timer deadline), else 0.
+    using Handler = std::uint64_t (*)(void* context);
+
+    // Times are in counter ticks. Bucket i of a histogram counts the times in
+    // [2^i, 2^(i+1)), the last one everything above.
+    struct IrqStats {
+        std::uint64_t count;
+        std::uint64_t latency_max; // Raised until the handler ran, if known
+        std::uint64_t service_max; // Time in the handler
+        std::uint64_t latency_histogram[HISTOGRAM_BUCKETS];
+        std::uint64_t service_histogram[HISTOGRAM_BUCKETS];
+    };
+
+    // Installs the handler and unmasks intid at the GIC. False if intid is out
+    // of range or already has one. A PPI is unmasked on the calling CPU only,
+    // other CPUs gic::enable() it themselves.
+    bool register_handler(unsigned intid, Handler handler, void* context);
+    void unregister_handler(unsigned intid);
+
+    // From the IRQ exception: acknowledges and handles interrupts until none
+    // is pending, so a burst costs one exception entry
+    void dispatch();
+
+    // False if intid never had a handler
+    bool get_stats(unsigned intid, IrqStats& out);
+
+    // Counts and histograms of every interrupt taken so far
+    void dump_stats();
+}; // namespace irq
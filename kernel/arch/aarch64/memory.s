@@ -0,0 +1,429 @@
+// memcpy / memmove / memset / memcmp
+//
+// With the MMU off every data access is Device memory: unaligned accesses and
+// DC ZVA fault there. Each routine checks SCTLR_EL1.M and falls back to a path
+// that only issues naturally aligned accesses until the MMU is enabled.
+
+.text
+.global memcpy
+.type memcpy, %function
+
+// x0 = dest, x1 = src, x2 = n. Returns dest.
+// Safe for overlapping buffers when dest < src (memmove relies on this).
+memcpy:
+    add x4, x1, x2              // src end
+    add x5, x0, x2              // dest end
+    mrs x6, sctlr_el1
+    tbz x6, #0, .Lcopy_strict
+
+    cmp x2, #16
+    b.hi .Lcopy_17_plus
+
+    // Up to 16 bytes: load both ends (possibly overlapping), then store.
+    // .Lcopy_17_plus does the same with q registers up to 64 bytes.
+    cmp x2, #8
+    b.lo .Lcopy_0_7
+    ldr x6, [x1]
+    ldr x7, [x4, #-8]
+    str x6, [x0]
+    str x7, [x5, #-8]
+    ret
+
+.Lcopy_0_7:
+    cmp x2, #4
+    b.lo .Lcopy_0_3
+    ldr w6, [x1]
+    ldr w7, [x4, #-4]
+    str w6, [x0]
+    str w7, [x5, #-4]
+    ret
+
+.Lcopy_0_3:
+    cbz x2, .Lcopy_done
+    lsr x8, x2, #1              // Middle byte, covers n == 3
+    ldrb w6, [x1]
+    ldrb w7, [x4, #-1]
+    ldrb w9, [x1, x8]
+    strb w6, [x0]
+    strb w9, [x0, x8]
+    strb w7, [x5, #-1]
+.Lcopy_done:
+    ret
+
+.Lcopy_17_plus:
+    cmp x2, #32
+    b.hi .Lcopy_33_plus
+    ldr q0, [x1]
+    ldr q1, [x4, #-16]
+    str q0, [x0]
+    str q1, [x5, #-16]
+    ret
+
+.Lcopy_33_plus:
+    cmp x2, #64
+    b.hi .Lcopy_long
+    ldp q0, q1, [x1]
+    ldp q2, q3, [x4, #-32]
+    stp q0, q1, [x0]
+    stp q2, q3, [x5, #-32]
+    ret
+
+.Lcopy_long:
+    // Head and tail are loaded up front and stored last, so a forward
+    // overlapping copy never reads bytes the loop already overwrote
+    ldr q16, [x1]
+    ldp q17, q18, [x4, #-64]
+    ldp q19, q20, [x4, #-32]
+
+    // Align dest to 16 bytes, src keeps the same offset
+    add x6, x0, #16
+    and x6, x6, #-16            // dest cursor
+    sub x7, x6, x0
+    add x7, x1, x7              // src cursor
+    sub x8, x5, #64             // The tail covers everything past this
+    cmp x6, x8
+    b.hs 2f
+
+1:
+    ldp q0, q1, [x7]
+    ldp q2, q3, [x7, #32]
+    add x7, x7, #64
+    stp q0, q1, [x6]
+    stp q2, q3, [x6, #32]
+    add x6, x6, #64
+    cmp x6, x8
+    b.lo 1b
+
+2:
+    stp q17, q18, [x5, #-64]
+    stp q19, q20, [x5, #-32]
+    str q16, [x0]
+    ret
+
+.Lcopy_strict:
+    // Aligned accesses only, forward
+    mov x6, x0
+1:
+    tst x6, #15
+    b.eq 2f
+    cbz x2, 6f
+    ldrb w7, [x1], #1
+    strb w7, [x6], #1
+    sub x2, x2, #1
+    b 1b
+
+2:
+    tst x1, #15
+    b.ne 4f
+3:
+    cmp x2, #32
+    b.lo 4f
+    ldp q0, q1, [x1], #32
+    stp q0, q1, [x6], #32
+    sub x2, x2, #32
+    b 3b
+
+4:
+    tst x1, #7
+    b.ne 5f
+41:
+    cmp x2, #8
+    b.lo 5f
+    ldr x7, [x1], #8
+    str x7, [x6], #8
+    sub x2, x2, #8
+    b 41b
+
+5:
+    cbz x2, 6f
+    ldrb w7, [x1], #1
+    strb w7, [x6], #1
+    sub x2, x2, #1
+    b 5b
+
+6:
+    ret
+
+.size memcpy, .-memcpy
+
+.global memmove
+.type memmove, %function
+
+// x0 = dest, x1 = src, x2 = n. Returns dest.
+memmove:
+    sub x3, x0, x1
+    cmp x3, x2
+    b.hs memcpy                 // dest below src or disjoint: forward is safe
+    cbz x3, .Lmove_done
+
+    // dest overlaps the end of src: copy backwards
+    add x4, x1, x2
+    add x5, x0, x2
+    mrs x6, sctlr_el1
+    tbz x6, #0, .Lmove_strict
+
+    cmp x2, #64
+    b.ls memcpy                 // Short copies load everything before storing
+
+    // The first 64 bytes are loaded now and stored last, they cover whatever
+    // is left once fewer than 64 bytes remain. Each 64-byte block from the end
+    // is loaded completely before it is stored.
+    ldp q16, q17, [x1]
+    ldp q18, q19, [x1, #32]
+
+1:
+    ldp q0, q1, [x4, #-64]
+    ldp q2, q3, [x4, #-32]
+    sub x4, x4, #64
+    stp q0, q1, [x5, #-64]
+    stp q2, q3, [x5, #-32]
+    sub x5, x5, #64
+    sub x2, x2, #64
+    cmp x2, #64
+    b.hi 1b
+
+    stp q16, q17, [x0]
+    stp q18, q19, [x0, #32]
+.Lmove_done:
+    ret
+
+.Lmove_strict:
+    // Aligned accesses only, backward
+1:
+    tst x5, #15
+    b.eq 2f
+    cbz x2, 6f
+    ldrb w7, [x4, #-1]!
+    strb w7, [x5, #-1]!
+    sub x2, x2, #1
+    b 1b
+
+2:
+    tst x4, #15
+    b.ne 4f
+3:
+    cmp x2, #32
+    b.lo 4f
+    ldp q0, q1, [x4, #-32]!
+    stp q0, q1, [x5, #-32]!
+    sub x2, x2, #32
+    b 3b
+
+4:
+    tst x4, #7
+    b.ne 5f
+41:
+    cmp x2, #8
+    b.lo 5f
+    ldr x7, [x4, #-8]!
+    str x7, [x5, #-8]!
+    sub x2, x2, #8
+    b 41b
+
+5:
+    cbz x2, 6f
+    ldrb w7, [x4, #-1]!
+    strb w7, [x5, #-1]!
+    sub x2, x2, #1
+    b 5b
+
+6:
+    ret
+
+.size memmove, .-memmove
+
+.global memset
+.type memset, %function
+
+// x0 = dest, w1 = byte, x2 = n. Returns dest.
+memset:
+    dup v0.16b, w1
+    add x5, x0, x2              // dest end
+    mrs x6, sctlr_el1
+    tbz x6, #0, .Lset_strict
+
+    cmp x2, #16
+    b.hi .Lset_17_plus
+
+    fmov x6, d0
+    cmp x2, #8
+    b.lo 1f
+    str x6, [x0]
+    str x6, [x5, #-8]
+    ret
+1:
+    cmp x2, #4
+    b.lo 2f
+    str w6, [x0]
+    str w6, [x5, #-4]
+    ret
+2:
+    cbz x2, 3f
+    lsr x8, x2, #1
+    strb w6, [x0]
+    strb w6, [x0, x8]
+    strb w6, [x5, #-1]
+3:
+    ret
+
+.Lset_17_plus:
+    cmp x2, #32
+    b.hi 1f
+    str q0, [x0]
+    str q0, [x5, #-16]
+    ret
+1:
+    cmp x2, #64
+    b.hi .Lset_long
+    stp q0, q0, [x0]
+    stp q0, q0, [x5, #-32]
+    ret
+
+.Lset_long:
+    str q0, [x0]
+    add x6, x0, #16
+    and x6, x6, #-16            // 16-byte aligned cursor
+    sub x8, x5, #64             // The tail covers everything past this
+
+    // Large zero fills clear a whole block per DC ZVA
+    tst w1, #0xff
+    b.ne .Lset_loop
+    cmp x2, #256
+    b.lo .Lset_loop
+    mrs x9, dczid_el0
+    tbnz x9, #4, .Lset_loop     // DZP: DC ZVA prohibited
+    and x9, x9, #15
+    mov x10, #4
+    lsl x10, x10, x9            // Block size in bytes
+    cmp x10, #64
+    b.lo .Lset_loop
+
+    sub x11, x10, #1
+    add x12, x6, x11
+    bic x12, x12, x11           // First block boundary
+    add x13, x12, x10
+    cmp x13, x5
+    b.hi .Lset_loop             // Not even one whole block to zero
+
+1:
+    cmp x6, x12
+    b.hs 2f
+    str q0, [x6], #16
+    b 1b
+
+2:
+    sub x13, x5, x10            // Last address a whole block fits at
+3:
+    dc zva, x6
+    add x6, x6, x10
+    cmp x6, x13
+    b.ls 3b
+
+.Lset_loop:
+    cmp x6, x8
+    b.hs 2f
+1:
+    stp q0, q0, [x6]
+    stp q0, q0, [x6, #32]
+    add x6, x6, #64
+    cmp x6, x8
+    b.lo 1b
+2:
+    stp q0, q0, [x8]
+    stp q0, q0, [x8, #32]
+    ret
+
+.Lset_strict:
+    // Aligned accesses only
+    fmov x6, d0
+    mov x7, x0
+1:
+    tst x7, #15
+    b.eq 2f
+    cbz x2, 5f
+    strb w6, [x7], #1
+    sub x2, x2, #1
+    b 1b
+
+2:
+    cmp x2, #32
+    b.lo 3f
+    stp q0, q0, [x7], #32
+    sub x2, x2, #32
+    b 2b
+
+3:
+    cmp x2, #8
+    b.lo 4f
+    str x6, [x7], #8
+    sub x2, x2, #8
+    b 3b
+
+4:
+    cbz x2, 5f
+    strb w6, [x7], #1
+    sub x2, x2, #1
+    b 4b
+
+5:
+    ret
+
+.size memset, .-memset
+
+.global memcmp
+.type memcmp, %function
+
+// x0 = a, x1 = b, x2 = n. Returns <0, 0 or >0 like the first differing byte.
+memcmp:
+    mrs x6, sctlr_el1
+    tbz x6, #0, .Lcmp_bytes
+
+    // 32 bytes per step; a mismatch is located by the word loop below
+1:
+    cmp x2, #32
+    b.lo .Lcmp_words
+    ldp q0, q1, [x0]
+    ldp q2, q3, [x1]
+    cmeq v0.16b, v0.16b, v2.16b
+    cmeq v1.16b, v1.16b, v3.16b
+    and v0.16b, v0.16b, v1.16b
+    uminv b0, v0.16b
+    fmov w6, s0
+    cmp w6, #0xff
+    b.ne .Lcmp_words
+    add x0, x0, #32
+    add x1, x1, #32
+    sub x2, x2, #32
+    b 1b
+
+.Lcmp_words:
+    cmp x2, #8
+    b.lo .Lcmp_bytes
+    ldr x6, [x0], #8
+    ldr x7, [x1], #8
+    sub x2, x2, #8
+    cmp x6, x7
+    b.eq .Lcmp_words
+
+    // Byte-reverse so the first differing byte is the most significant
+    rev x6, x6
+    rev x7, x7
+    cmp x6, x7
+    mov w0, #1
+    cneg w0, w0, lo
+    ret
+
+.Lcmp_bytes:
+    cbz x2, 1f
+    ldrb w6, [x0], #1
+    ldrb w7, [x1], #1
+    sub x2, x2, #1
+    subs w6, w6, w7
+    b.eq .Lcmp_bytes
+    mov w0, w6
+    ret
+1:
+    mov w0, #0
+    ret
+
+.size memcmp, .-memcmp
@@ -0,0 +1,240 @@
+#include "mmu.hpp"
+
+#include <common/lib/page_alloc.hpp>
+#include <common/lib/thread.hpp>
+
+constexpr std::size_t   TABLE_ENTRIES = 512;
+constexpr std::size_t   EARLY_TABLES  = 16; // Until the page allocator is up
+constexpr std::uint64_t L1_BLOCK_SIZE = 1ull << 30;
+constexpr std::uint64_t L2_BLOCK_SIZE = 1ull << 21;
+
+// Descriptor bits
+constexpr std::uint64_t DESC_VALID     = 1ull << 0;
+constexpr std::uint64_t DESC_TABLE     = 1ull << 1; // Table at level 1-2, page at level 3
+constexpr std::uint64_t DESC_SH_INNER  = 3ull << 8;
+constexpr std::uint64_t DESC_AF        = 1ull << 10;
+constexpr std::uint64_t DESC_PXN       = 1ull << 53;
+constexpr std::uint64_t DESC_UXN       = 1ull << 54;
+constexpr std::uint64_t DESC_ADDR_MASK = 0x0000fffffffff000ull;
+
+constexpr std::uint64_t desc_attr_index(const std::uint64_t index) {
+    return index << 2;
+};
+
+// MAIR_EL1 slots
+constexpr std::uint64_t MAIR_NORMAL_WB    = 0; // 0xff: inner/outer write-back, RW-allocate
+constexpr std::uint64_t MAIR_DEVICE_NGNRE = 1; // 0x04
+constexpr std::uint64_t MAIR_VALUE        = 0xffull | (0x04ull << 8);
+
+// TCR_EL1
+constexpr std::uint64_t TCR_T0SZ       = 64 - 39;
+constexpr std::uint64_t TCR_IRGN0_WBWA = 1ull << 8;
+constexpr std::uint64_t TCR_ORGN0_WBWA = 1ull << 10;
+constexpr std::uint64_t TCR_SH0_INNER  = 3ull << 12;
+constexpr std::uint64_t TCR_TG0_4K     = 0ull << 14;
+constexpr std::uint64_t TCR_EPD1       = 1ull << 23; // No TTBR1 walks
+constexpr std::uint64_t TCR_IPS_SHIFT  = 32;
+
+// SCTLR_EL1
+constexpr std::uint64_t SCTLR_M = 1ull << 0;
+constexpr std::uint64_t SCTLR_A = 1ull << 1;
+constexpr std::uint64_t SCTLR_C = 1ull << 2;
+constexpr std::uint64_t SCTLR_I = 1ull << 12;
+
+alignas(4096) static std::uint64_t early_tables[EARLY_TABLES][TABLE_ENTRIES];
+static std::size_t                 early_used = 0;
+static std::uint64_t*              root       = nullptr;
+
+static std::uint64_t* alloc_table() {
+    if (early_used < EARLY_TABLES)
+        return early_tables[early_used++]; // Zero, they live in .bss
+
+    return static_cast<std::uint64_t*>(alloc_zeroed_pages(0));
+};
+
+static std::uint64_t leaf_attributes(const mmu::MemoryType type) {
+    if (type == mmu::MemoryType::DEVICE)
+        return desc_attr_index(MAIR_DEVICE_NGNRE) | DESC_AF | DESC_PXN | DESC_UXN;
+
+    return desc_attr_index(MAIR_NORMAL_WB) | DESC_SH_INNER | DESC_AF | DESC_UXN;
+};
+
+static std::uint64_t* table_of(const std::uint64_t entry) {
+    return reinterpret_cast<std::uint64_t*>(entry & DESC_ADDR_MASK);
+};
+
+static bool is_table(const std::uint64_t entry) {
+    return (entry & (DESC_TABLE | DESC_VALID)) == (DESC_TABLE | DESC_VALID);
+};
+
+// Table an entry points to, creating it if the entry is empty. nullptr if the
+// entry is a block, which would have to be split.
+static std::uint64_t* next_table(std::uint64_t& entry) {
+    if (!(entry & DESC_VALID)) {
+        std::uint64_t* table = alloc_table();
+        if (!table)
+            return nullptr;
+
+        entry = reinterpret_cast<std::uintptr_t>(table) | DESC_TABLE | DESC_VALID;
+        return table;
+    };
+
+    return is_table(entry) ? table_of(entry) : nullptr;
+};
+
+// Fills an empty leaf, accepts one that already holds the same mapping
+static bool set_leaf(std::uint64_t& entry, const std::uint64_t value) {
+    if (entry & DESC_VALID)
+        return entry == value;
+
+    entry = value;
+    return true;
+};
+
+namespace mmu {
+    bool map(std::uintptr_t va, std::uintptr_t pa, const std::size_t size,
+             const MemoryType type) {
+        const std::uintptr_t end   = (va + size + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+        const std::uint64_t  attrs = leaf_attributes(type);
+
+        pa &= ~(PAGE_SIZE - 1);
+        va &= ~(PAGE_SIZE - 1);
+        if (end > VA_LIMIT || end <= va)
+            return false;
+
+        const CpuLockScope guard(page_lock); // Tables are shared by every CPU
+
+        if (!root)
+            root = alloc_table();
+
+        bool ok = root != nullptr;
+        while (ok && va < end) {
+            const std::uintptr_t remaining = end - va;
+            std::uint64_t&       l1_entry  = root[(va >> 30) % TABLE_ENTRIES];
+
+            if ((va | pa) % L1_BLOCK_SIZE == 0 && remaining >= L1_BLOCK_SIZE &&
+                !(l1_entry & DESC_TABLE)) {
+                ok  = set_leaf(l1_entry, pa | attrs | DESC_VALID);
+                va += L1_BLOCK_SIZE;
+                pa += L1_BLOCK_SIZE;
+                continue;
+            };
+
+            std::uint64_t* l2 = next_table(l1_entry);
+            if (!l2) {
+                ok = false;
+                break;
+            };
+
+            std::uint64_t& l2_entry = l2[(va >> 21) % TABLE_ENTRIES];
+            if ((va | pa) % L2_BLOCK_SIZE == 0 && remaining >= L2_BLOCK_SIZE &&
+                !(l2_entry & DESC_TABLE)) {
+                ok  = set_leaf(l2_entry, pa | attrs | DESC_VALID);
+                va += L2_BLOCK_SIZE;
+                pa += L2_BLOCK_SIZE;
+                continue;
+            };
+
+            std::uint64_t* l3 = next_table(l2_entry);
+            if (!l3) {
+                ok = false;
+                break;
+            };
+
+            std::uint64_t& l3_entry = l3[(va >> 12) % TABLE_ENTRIES];
+
+            ok  = set_leaf(l3_entry, pa | attrs | DESC_TABLE | DESC_VALID);
+            va += PAGE_SIZE;
+            pa += PAGE_SIZE;
+        };
+
+        // Only empty entries were filled, which the TLB never caches, so making
+        // the stores visible to the table walker is enough
+        if (enabled())
+            asm volatile("dsb ishst\n\tisb" : : : "memory");
+
+        return ok;
+    };
+
+    std::uintptr_t unmap_page(const std::uintptr_t va) {
+        if (!root || va >= VA_LIMIT)
+            return 0;
+
+        const CpuLockScope guard(page_lock);
+
+        // Walk without creating anything; blocks are never split
+        const std::uint64_t l1_entry = root[(va >> 30) % TABLE_ENTRIES];
+        if (!is_table(l1_entry))
+            return 0;
+
+        const std::uint64_t l2_entry = table_of(l1_entry)[(va >> 21) % TABLE_ENTRIES];
+        if (!is_table(l2_entry))
+            return 0;
+
+        std::uint64_t& page = table_of(l2_entry)[(va >> 12) % TABLE_ENTRIES];
+        if (!(page & DESC_VALID))
+            return 0;
+
+        const std::uintptr_t pa = page & DESC_ADDR_MASK;
+        page                    = 0;
+
+        if (enabled()) {
+            asm volatile("dsb ishst\n\t"
+                         "tlbi vaae1is, %0\n\t"
+                         "dsb ish\n\t"
+                         "isb"
+                         :
+                         : "r"(va >> 12)
+                         : "memory");
+        };
+
+        return pa;
+    };
+
+    void enable() {
+        if (!root || enabled())
+            return;
+
+        // The tables were written with the caches off, drop any stale lines
+        // before the walker starts reading them through the cache
+        const auto* tables = reinterpret_cast<const char*>(early_tables);
+        for (std::size_t line = 0; line < early_used * sizeof(early_tables[0]); line += 64)
+            asm volatile("dc ivac, %0" : : "r"(tables + line) : "memory");
+
+        // Output size: whatever the CPU supports (ID_AA64MMFR0_EL1.PARange)
+        std::uint64_t mmfr0;
+        asm volatile("mrs %0, id_aa64mmfr0_el1" : "=r"(mmfr0));
+        std::uint64_t parange = mmfr0 & 0xf;
+        if (parange > 5)
+            parange = 5; // 48 bits, the most a 4 KiB granule without LPA can output
+
+        const std::uint64_t tcr = TCR_T0SZ | TCR_IRGN0_WBWA | TCR_ORGN0_WBWA | TCR_SH0_INNER |
+                                  TCR_TG0_4K | TCR_EPD1 | (parange << TCR_IPS_SHIFT);
+
+        asm volatile("msr mair_el1, %0" : : "r"(MAIR_VALUE));
+        asm volatile("msr tcr_el1, %0" : : "r"(tcr));
+        asm volatile("msr ttbr0_el1, %0" : : "r"(root));
+        asm volatile("dsb ish\n\t"
+                     "isb\n\t"
+                     "tlbi vmalle1\n\t"
+                     "ic iallu\n\t"
+                     "dsb ish\n\t"
+                     "isb"
+                     :
+                     :
+                     : "memory");
+
+        // Unaligned accesses are fine on Normal memory, so alignment checks go
+        std::uint64_t sctlr;
+        asm volatile("mrs %0, sctlr_el1" : "=r"(sctlr));
+        sctlr |= SCTLR_M | SCTLR_C | SCTLR_I;
+        sctlr &= ~SCTLR_A;
+        asm volatile("msr sctlr_el1, %0\n\tisb" : : "r"(sctlr) : "memory");
+    };
+
+    bool enabled() {
+        std::uint64_t sctlr;
+        asm volatile("mrs %0, sctlr_el1" : "=r"(sctlr));
+        return sctlr & SCTLR_M;
+    };
+}; // namespace mmu
@@ -0,0 +1,32 @@
+#pragma once
+#include "common/std/stdint.hpp"
+
+// Stage 1 EL1 translation with a 4 KiB granule and 39-bit addresses (three
+// levels, starting at 1 GiB entries). Only TTBR0 is used.
+namespace mmu {
+    enum class MemoryType : std::uint8_t {
+        NORMAL, // Write-back cacheable, inner shareable
+        DEVICE, // Device-nGnRE, never executable
+    };
+
+    constexpr std::uintptr_t VA_LIMIT = 1ull << 39;
+
+    // Maps [va, va + size) to pa, rounded out to pages. Uses 1 GiB and 2 MiB
+    // blocks wherever alignment allows and 4 KiB pages elsewhere. Fails if part
+    // of the range is already mapped differently, or no table could be allocated.
+    bool map(std::uintptr_t va, std::uintptr_t pa, std::size_t size, MemoryType type);
+
+    inline bool map_identity(const std::uintptr_t base, const std::size_t size,
+                             const MemoryType type) {
+        return map(base, base, size, type);
+    };
+
+    // Removes a 4 KiB page mapping and flushes it from the TLB. Returns the
+    // physical page it mapped, 0 if va was not mapped by a page.
+    std::uintptr_t unmap_page(std::uintptr_t va);
+
+    // Loads the tables and turns on the MMU and both caches
+    void enable();
+
+    [[nodiscard]] bool enabled();
+}; // namespace mmu
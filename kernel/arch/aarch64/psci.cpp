@@ -0,0 +1,53 @@
+#include "psci.hpp"
+
+#include <common/drivers/fdt.hpp>
+#include <common/lib/cstring.hpp>
+
+constexpr std::uint64_t CPU_ON = 0xc4000003; // SMC64 calling convention
+
+static bool present;
+static bool use_smc;
+
+// SMCCC: arguments in x1-x3, the result in x0. x4-x17 may be clobbered.
+static std::int64_t call(const std::uint64_t function, const std::uint64_t arg0,
+                         const std::uint64_t arg1, const std::uint64_t arg2) {
+    register std::uint64_t x0 asm("x0") = function;
+    register std::uint64_t x1 asm("x1") = arg0;
+    register std::uint64_t x2 asm("x2") = arg1;
+    register std::uint64_t x3 asm("x3") = arg2;
+
+    if (use_smc)
+        asm volatile("smc #0"
+                     : "+r"(x0), "+r"(x1), "+r"(x2), "+r"(x3)
+                     :
+                     : "x4", "x5", "x6", "x7", "x8", "x9", "x10", "x11", "x12", "x13", "x14",
+                       "x15", "x16", "x17", "memory");
+    else
+        asm volatile("hvc #0"
+                     : "+r"(x0), "+r"(x1), "+r"(x2), "+r"(x3)
+                     :
+                     : "x4", "x5", "x6", "x7", "x8", "x9", "x10", "x11", "x12", "x13", "x14",
+                       "x15", "x16", "x17", "memory");
+
+    return static_cast<std::int64_t>(x0);
+};
+
+namespace psci {
+    bool initialize() {
+        const char* method = fdt::get_psci_method();
+        if (!method)
+            return false;
+
+        use_smc = strcmp(method, "smc") == 0;
+        present = use_smc || strcmp(method, "hvc") == 0;
+        return present;
+    };
+
+    std::int64_t cpu_on(const std::uint64_t mpidr, const std::uintptr_t entry,
+                        const std::uint64_t context) {
+        if (!present)
+            return INTERNAL_ERROR;
+
+        return call(CPU_ON, mpidr, entry, context);
+    };
+}; // namespace psci
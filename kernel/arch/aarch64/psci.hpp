@@ -0,0 +1,18 @@
+#pragma once
+#include "common/std/stdint.hpp"
+
+// Power State Coordination Interface: firmware (or the hypervisor) calls to
+// power CPUs on, through HVC or SMC as the FDT's /psci node says
+namespace psci {
+    constexpr std::int64_t SUCCESS        = 0;
+    constexpr std::int64_t INVALID_PARAMS = -2;
+    constexpr std::int64_t ALREADY_ON     = -4;
+    constexpr std::int64_t INTERNAL_ERROR = -6;
+
+    // Reads the conduit from the FDT. False if there is no PSCI.
+    bool initialize();
+
+    // Starts the CPU with affinity mpidr at entry, a physical address, with the
+    // MMU off, IRQs masked and context in x0. SUCCESS or a negative error.
+    std::int64_t cpu_on(std::uint64_t mpidr, std::uintptr_t entry, std::uint64_t context);
+}; // namespace psci
@@ -0,0 +1,125 @@
+#include "smp.hpp"
+#include "cpu.hpp"
+#include "gic.hpp"
+#include "psci.hpp"
+#include "timer.hpp"
+
+#include <common/drivers/fdt.hpp>
+#include <common/lib/page_alloc.hpp>
+#include <common/lib/thread.hpp>
+#include <common/std/print.hpp>
+
+constexpr unsigned      STACK_ORDER       = 2; // 16 KiB, for each of the two stacks
+constexpr std::uint64_t ONLINE_TIMEOUT_MS = 100;
+
+// What _secondary_start needs before it can run C++, read with the MMU off, so
+// it is cleaned to memory first. Offsets are used in bootloader.s.
+struct BootBlock {
+    std::uint64_t mair;            // 0: Same translation as the boot CPU
+    std::uint64_t tcr;             // 8
+    std::uint64_t ttbr0;           // 16
+    std::uint64_t sctlr;           // 24
+    std::uint64_t exception_stack; // 32: Top of SP_EL1
+    std::uint64_t stack;           // 40: Top of SP_EL0, the idle thread's stack
+    std::uint64_t id;              // 48: For cpu::id()
+};
+
+static BootBlock boot_blocks[cpu::MAX_CPUS];
+static unsigned  online = 1;
+
+extern "C" void _secondary_start();
+
+extern "C" [[noreturn]] void secondary_main(const unsigned id) {
+    // Before anything is allocated here, so it comes from this CPU's node
+    set_local_node(fdt::get_cpu_node(cpu::affinity()));
+
+    // No timer without a GIC, the CPU still runs threads between events
+    if (gic::initialize_cpu())
+        timer::initialize_cpu();
+
+    __atomic_fetch_add(&online, 1, __ATOMIC_RELEASE);
+    std::println("SMP: CPU {} online", id);
+
+    run_idle_thread();
+};
+
+static void clean_to_memory(const void* start, const std::size_t size) {
+    const std::uintptr_t end = reinterpret_cast<std::uintptr_t>(start) + size;
+    for (std::uintptr_t line = reinterpret_cast<std::uintptr_t>(start) & ~63ull; line < end;
+         line += 64)
+        asm volatile("dc civac, %0" : : "r"(line) : "memory");
+
+    asm volatile("dsb ish" : : : "memory");
+};
+
+// False if PSCI refused. A CPU that was started but never reported in still
+// keeps its id and stacks, it may yet run.
+static bool start_cpu(const unsigned id, const std::uint64_t mpidr) {
+    void* stack           = alloc_pages(STACK_ORDER);
+    void* exception_stack = alloc_pages(STACK_ORDER);
+    if (!stack || !exception_stack) {
+        free_pages(stack);
+        free_pages(exception_stack);
+        return false;
+    };
+
+    BootBlock& block = boot_blocks[id];
+    asm volatile("mrs %0, mair_el1" : "=r"(block.mair));
+    asm volatile("mrs %0, tcr_el1" : "=r"(block.tcr));
+    asm volatile("mrs %0, ttbr0_el1" : "=r"(block.ttbr0));
+    asm volatile("mrs %0, sctlr_el1" : "=r"(block.sctlr));
+    block.exception_stack = reinterpret_cast<std::uintptr_t>(exception_stack) +
+                            (PAGE_SIZE << STACK_ORDER);
+    block.stack = reinterpret_cast<std::uintptr_t>(stack) + (PAGE_SIZE << STACK_ORDER);
+    block.id    = id;
+    clean_to_memory(&block, sizeof(block));
+
+    const unsigned     before = __atomic_load_n(&online, __ATOMIC_ACQUIRE);
+    const std::int64_t result = psci::cpu_on(
+        mpidr, reinterpret_cast<std::uintptr_t>(_secondary_start),
+        reinterpret_cast<std::uintptr_t>(&block));
+    if (result != psci::SUCCESS) {
+        std::println("SMP: CPU {} refused to start ({})", id, result);
+        free_pages(stack);
+        free_pages(exception_stack);
+        return false;
+    };
+
+    const std::uint64_t deadline =
+        cpu::counter() + cpu::counter_frequency() * ONLINE_TIMEOUT_MS / 1000;
+    while (__atomic_load_n(&online, __ATOMIC_ACQUIRE) == before) {
+        if (cpu::counter() > deadline) {
+            std::println("SMP: CPU {} didn't come online", id);
+            break;
+        };
+
+        cpu::relax();
+    };
+
+    return true;
+};
+
+namespace smp {
+    unsigned start_secondaries() {
+        if (!psci::initialize()) {
+            std::println("SMP: no PSCI, running on the boot CPU only");
+            return online_cpus();
+        };
+
+        std::uint64_t     mpidrs[cpu::MAX_CPUS * 2];
+        const std::size_t count = fdt::get_cpus(mpidrs, cpu::MAX_CPUS * 2);
+
+        unsigned next_id = 1;
+        for (std::size_t i = 0; i < count && next_id < cpu::MAX_CPUS; ++i) {
+            if (mpidrs[i] != cpu::affinity() && start_cpu(next_id, mpidrs[i]))
+                next_id++;
+        };
+
+        std::println("SMP: {} CPUs online", online_cpus());
+        return online_cpus();
+    };
+
+    unsigned online_cpus() {
+        return __atomic_load_n(&online, __ATOMIC_ACQUIRE);
+    };
+}; // namespace smp
@@ -0,0 +1,12 @@
+#pragma once
+
+// Secondary CPUs, started through PSCI. Each sets up its own GIC interface and
+// timer, then becomes an idle thread that steals work from the other CPUs.
+namespace smp {
+    // Starts every other CPU in the FDT, up to cpu::MAX_CPUS in all. Needs the
+    // boot CPU's MMU, GIC and timer set up and the static constructors run.
+    // Returns the number of CPUs online, the boot CPU included.
+    unsigned start_secondaries();
+
+    unsigned online_cpus();
+}; // namespace smp
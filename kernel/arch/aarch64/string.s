@@ -0,0 +1,146 @@
+// strlen / strcmp / strncmp
+//
+// A 16-byte load never reads past the page holding the string's terminator:
+// strlen only issues aligned loads, the compare loops fall back to single
+// bytes whenever a load would cross into the next page. As in memory.s,
+// unaligned loads are only used once the MMU is on.
+
+.text
+.global strlen
+.type strlen, %function
+
+// x0 = str. Returns the length.
+strlen:
+    bic x1, x0, #15             // Aligned block holding the first byte
+    ldr q0, [x1]
+    cmeq v0.16b, v0.16b, #0
+    shrn v0.8b, v0.8h, #4       // 4 bits per byte
+    fmov x2, d0
+    and x3, x0, #15
+    lsl x3, x3, #2
+    lsr x2, x2, x3              // Drop the bytes before the string
+    cbz x2, 1f
+    rbit x2, x2
+    clz x2, x2
+    lsr x0, x2, #2
+    ret
+
+1:
+    ldr q0, [x1, #16]!
+    cmeq v0.16b, v0.16b, #0
+    umaxv b1, v0.16b
+    fmov w2, s1
+    cbz w2, 1b
+
+    shrn v0.8b, v0.8h, #4
+    fmov x2, d0
+    rbit x2, x2
+    clz x2, x2
+    sub x0, x1, x0
+    add x0, x0, x2, lsr #2
+    ret
+
+.size strlen, .-strlen
+
+.global strcmp
+.type strcmp, %function
+
+// x0 = a, x1 = b. Returns the difference of the first differing bytes.
+strcmp:
+    mrs x9, sctlr_el1
+    tbz x9, #0, .Lstrcmp_byte
+
+.Lstrcmp_loop:
+    and x2, x0, #4095
+    and x3, x1, #4095
+    cmp x2, #4080
+    b.hi .Lstrcmp_byte
+    cmp x3, #4080
+    b.hi .Lstrcmp_byte
+
+    ldr q0, [x0]
+    ldr q1, [x1]
+    cmeq v2.16b, v0.16b, v1.16b
+    cmeq v3.16b, v0.16b, #0
+    bic v2.16b, v2.16b, v3.16b  // 0xff where equal and not the end
+    uminv b4, v2.16b
+    fmov w4, s4
+    cbz w4, .Lstrcmp_stop
+    add x0, x0, #16
+    add x1, x1, #16
+    b .Lstrcmp_loop
+
+.Lstrcmp_stop:
+    // Index of the first byte that differs or ends the string
+    not v2.16b, v2.16b
+    shrn v2.8b, v2.8h, #4
+    fmov x4, d2
+    rbit x4, x4
+    clz x4, x4
+    lsr x4, x4, #2
+    ldrb w5, [x0, x4]
+    ldrb w6, [x1, x4]
+    sub w0, w5, w6
+    ret
+
+.Lstrcmp_byte:
+    ldrb w5, [x0], #1
+    ldrb w6, [x1], #1
+    cmp w5, w6
+    b.ne 1f
+    cbz w5, 1f
+    tbz x9, #0, .Lstrcmp_byte   // MMU off: stay on bytes
+    b .Lstrcmp_loop
+1:
+    sub w0, w5, w6
+    ret
+
+.size strcmp, .-strcmp
+
+.global strncmp
+.type strncmp, %function
+
+// x0 = a, x1 = b, x2 = n. Like strcmp, but compares at most n bytes.
+strncmp:
+    mrs x9, sctlr_el1
+
+.Lstrncmp_loop:
+    cbz x2, 2f
+    tbz x9, #0, .Lstrncmp_byte
+    cmp x2, #16
+    b.lo .Lstrncmp_byte
+    and x3, x0, #4095
+    and x4, x1, #4095
+    cmp x3, #4080
+    b.hi .Lstrncmp_byte
+    cmp x4, #4080
+    b.hi .Lstrncmp_byte
+
+    ldr q0, [x0]
+    ldr q1, [x1]
+    cmeq v2.16b, v0.16b, v1.16b
+    cmeq v3.16b, v0.16b, #0
+    bic v2.16b, v2.16b, v3.16b
+    uminv b4, v2.16b
+    fmov w4, s4
+    cbz w4, .Lstrcmp_stop       // n >= 16, so the stop byte is in range
+    add x0, x0, #16
+    add x1, x1, #16
+    sub x2, x2, #16
+    b .Lstrncmp_loop
+
+.Lstrncmp_byte:
+    ldrb w5, [x0], #1
+    ldrb w6, [x1], #1
+    sub x2, x2, #1
+    cmp w5, w6
+    b.ne 1f
+    cbnz w5, .Lstrncmp_loop
+1:
+    sub w0, w5, w6
+    ret
+2:
+    mov w0, #0
+    ret
+
+.size strncmp, .-strncmp
@@ -1,9 +1,25 @@
+// Thread context switch
+//
+// FP/SIMD is switched lazily. A thread's registers are only live on its CPU
+// from its first FP/SIMD instruction after being switched in, which traps
+// through CPACR_EL1 and loads them (fp_trap in exceptions.s). So the switch
+// saves them only if FP/SIMD is enabled, and always leaves it trapping for the
+// next thread. Threads that never touch it save and load nothing.
+//
+// The switch also makes the new thread current_thread(). Until the old
+// thread's registers are saved, a trap must load the old thread's, so the
+// scheduler can't do it any earlier.
+
+.equ CONTEXT_FP, 128          // ThreadContext::fp
+.equ CPACR_FPEN, (3 << 20)    // FP/SIMD at EL1 and EL0 without trapping
+
 .text
 .global context_switch
 .type context_switch, %function
 
 // x0 = old_ctx (ptr), x1 = new_ctx (ptr)
 context_switch:
+    mrs x4, cpacr_el1
     cbz x0, 1f                 // If old_ctx == 0, skip saving
 
     // Save callee-saved registers
@@ -21,7 +37,42 @@ context_switch:
     // Save LR (x30) as the PC for the next time we resume
     str x30, [x0, #8]
 
+    // Save all of FP/SIMD if it was used since this thread was switched in.
+    // Across a call only d8-d15 matter, but the trap reloads everything.
+    tbz x4, #20, 1f
+    add x2, x0, #CONTEXT_FP
+    stp q0, q1, [x2, #32 * 0]
+    stp q2, q3, [x2, #32 * 1]
+    stp q4, q5, [x2, #32 * 2]
+    stp q6, q7, [x2, #32 * 3]
+    stp q8, q9, [x2, #32 * 4]
+    stp q10, q11, [x2, #32 * 5]
+    stp q12, q13, [x2, #32 * 6]
+    stp q14, q15, [x2, #32 * 7]
+    stp q16, q17, [x2, #32 * 8]
+    stp q18, q19, [x2, #32 * 9]
+    stp q20, q21, [x2, #32 * 10]
+    stp q22, q23, [x2, #32 * 11]
+    stp q24, q25, [x2, #32 * 12]
+    stp q26, q27, [x2, #32 * 13]
+    stp q28, q29, [x2, #32 * 14]
+    stp q30, q31, [x2, #32 * 15]
+    mrs x3, fpsr
+    str x3, [x2, #32 * 16]     // Past the reach of stp
+    mrs x3, fpcr
+    str x3, [x2, #32 * 16 + 8]
+
 1:
+    // The new thread traps on its first FP/SIMD instruction
+    tbz x4, #20, 2f
+    bic x4, x4, #CPACR_FPEN
+    msr cpacr_el1, x4
+    isb
+
+2:
+    // current_thread(), ctx is Thread's first member
+    msr tpidrro_el0, x1
+
     // Restore SP
     ldr x2, [x1, #0]
     mov sp, x2
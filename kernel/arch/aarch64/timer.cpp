@@ -0,0 +1,78 @@
+#include "timer.hpp"
+#include "cpu.hpp"
+#include "gic.hpp"
+#include "irq.hpp"
+
+#include <common/lib/thread.hpp>
+#include <common/lib/timer_wheel.hpp>
+
+// Every CPU has its own CNTV, programmed for whichever deadline comes first.
+// 0 means none.
+struct Deadlines {
+    std::uint64_t slice;
+    std::uint64_t wheel;
+};
+
+static Deadlines deadlines[cpu::MAX_CPUS];
+
+static void program(const Deadlines& pending) {
+    std::uint64_t next = pending.slice;
+    if (pending.wheel && (!next || pending.wheel < next))
+        next = pending.wheel;
+
+    if (!next) {
+        asm volatile("msr cntv_ctl_el0, %0" : : "r"(0ull)); // Disabled
+        return;
+    };
+
+    // A deadline already past fires as soon as IRQs are unmasked
+    asm volatile("msr cntv_cval_el0, %0" : : "r"(next));
+    asm volatile("msr cntv_ctl_el0, %0\n\tisb" : : "r"(1ull)); // Enabled, not masked
+};
+
+// Absolute deadlines don't drift with interrupt latency. Reports the earliest
+// one that fell due as the raise time.
+static std::uint64_t handle_irq(void*) {
+    Deadlines&          pending = deadlines[cpu::id()];
+    const std::uint64_t now     = cpu::counter();
+    std::uint64_t       raised  = 0;
+
+    if (pending.slice && pending.slice <= now) {
+        raised        = pending.slice;
+        pending.slice = 0;
+        time_slice_expired();
+    };
+
+    if (pending.wheel && pending.wheel <= now) {
+        if (!raised || pending.wheel < raised)
+            raised = pending.wheel;
+
+        pending.wheel = 0;
+        run_timers(); // Sets the next wheel deadline
+    };
+
+    program(pending);
+    return raised;
+};
+
+namespace timer {
+    void initialize() {
+        irq::register_handler(IRQ, handle_irq, nullptr);
+    };
+
+    void initialize_cpu() {
+        gic::enable(IRQ);
+    };
+
+    void set_slice_deadline(const std::uint64_t deadline) {
+        Deadlines& pending = deadlines[cpu::id()];
+        pending.slice      = deadline;
+        program(pending);
+    };
+
+    void set_wheel_deadline(const std::uint64_t deadline) {
+        Deadlines& pending = deadlines[cpu::id()];
+        pending.wheel      = deadline;
+        program(pending);
+    };
+}; // namespace timer
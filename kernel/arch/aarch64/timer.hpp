@@ -0,0 +1,22 @@
+#pragma once
+#include "common/std/stdint.hpp"
+
+// One-shot deadlines on the EL1 virtual timer (CNTV), which counts the same
+// CNTVCT_EL0 ticks as cpu::counter(). Nothing ticks: each CPU's timer is only
+// programmed for the end of the running thread's time slice or the next timer
+// wheel slot, whichever is first, and is off while neither is pending.
+namespace timer {
+    constexpr unsigned IRQ = 27; // CNTV is PPI 11
+
+    // Installs the interrupt handler. It reports the deadline that fell due as
+    // the raise time, so the IRQ latency histogram of the timer is exact.
+    void initialize();
+
+    // Unmasks the timer on a secondary CPU, once initialize() ran on the boot CPU
+    void initialize_cpu();
+
+    // cpu::counter() values at which this CPU calls time_slice_expired() or
+    // run_timers(), 0 for never. Each replaces the previous one. IRQs masked.
+    void set_slice_deadline(std::uint64_t deadline);
+    void set_wheel_deadline(std::uint64_t deadline);
+}; // namespace timer
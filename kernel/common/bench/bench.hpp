@@ -0,0 +1,16 @@
+#pragma once
+
+// Micro-benchmarks, built with -DPRISM_BENCH=ON and run from kernel_main
+namespace bench {
+    // memcpy/memset/memmove/memcmp throughput over a size sweep, compared with
+    // the byte loops they replaced
+    void run_memory();
+
+    // Cost of a yield() with 1 to 16k threads in the run queue, which should
+    // stay flat
+    void run_scheduler();
+
+    // memset and a byte checksum over 16 MiB, on one CPU and through
+    // parallel_for()/parallel_reduce()
+    void run_parallel();
+}; // namespace bench
@@ -0,0 +1,134 @@
+#include "bench.hpp"
+
+#include <arch/aarch64/cpu.hpp>
+#include <common/lib/memory.hpp>
+#include <common/lib/page_alloc.hpp>
+#include <common/std/print.hpp>
+
+// The byte loops memory.cpp used before the NEON versions. GCC would turn them
+// back into memcpy/memset calls without the optimize attribute.
+#define BYTE_LOOP __attribute__((noinline, optimize("no-tree-loop-distribute-patterns")))
+
+BYTE_LOOP static void* byte_memcpy(void* dest, const void* src, const std::size_t n) {
+    const auto d = static_cast<char*>(dest);
+    const auto s = static_cast<const char*>(src);
+    for (std::size_t i = 0; i < n; ++i) d[i] = s[i];
+
+    return dest;
+};
+
+BYTE_LOOP static void* byte_memset(void* dest, const int c, const std::size_t n) {
+    auto* p = static_cast<unsigned char*>(dest);
+    for (std::size_t i = 0; i < n; ++i) p[i] = static_cast<unsigned char>(c);
+
+    return dest;
+};
+
+BYTE_LOOP static void* byte_memmove(void* dest, const void* src, const std::size_t n) {
+    const auto d = static_cast<char*>(dest);
+    const auto s = static_cast<const char*>(src);
+    if (d < s) {
+        for (std::size_t i = 0; i < n; ++i) d[i] = s[i];
+    }
+    else {
+        for (std::size_t i = n; i > 0; --i) d[i - 1] = s[i - 1];
+    };
+
+    return dest;
+};
+
+BYTE_LOOP static int byte_memcmp(const void* a, const void* b, const std::size_t n) {
+    const auto x = static_cast<const unsigned char*>(a);
+    const auto y = static_cast<const unsigned char*>(b);
+    for (std::size_t i = 0; i < n; ++i) {
+        if (x[i] != y[i])
+            return x[i] - y[i];
+    };
+
+    return 0;
+};
+
+constexpr std::size_t SIZES[] = {8,    16,    32,    64,     128,    256,   512,
+                                 1024, 4096,  16384, 65536,  262144, 1048576};
+constexpr std::size_t MAX_SIZE         = 1048576;
+constexpr std::size_t BYTES_PER_SAMPLE = 16 * 1024 * 1024; // Work done per measurement
+
+enum class Op { COPY, SET, MOVE, COMPARE };
+
+static char* buffer_a;
+static char* buffer_b;
+
+// Runs op over size bytes until BYTES_PER_SAMPLE have been processed, returns ticks
+static std::uint64_t measure(const Op op, const bool optimized, const std::size_t size) {
+    char*             dest       = buffer_a;
+    const char*       src        = buffer_b + 3; // Source deliberately unaligned
+    const std::size_t iterations = BYTES_PER_SAMPLE / size;
+
+    volatile int        sink  = 0; // Keeps the memcmp results alive
+    const std::uint64_t start = cpu::counter();
+    for (std::size_t i = 0; i < iterations; ++i) {
+        switch (op) {
+        case Op::COPY:
+            optimized ? memcpy(dest, src, size) : byte_memcpy(dest, src, size);
+            break;
+        case Op::SET:
+            optimized ? memset(dest, 0, size) : byte_memset(dest, 0, size);
+            break;
+        case Op::MOVE: // Overlapping, dest above src
+            optimized ? memmove(dest + 8, dest, size) : byte_memmove(dest + 8, dest, size);
+            break;
+        case Op::COMPARE:
+            sink = optimized ? memcmp(dest, dest + MAX_SIZE / 2, size)
+                             : byte_memcmp(dest, dest + MAX_SIZE / 2, size);
+            break;
+        };
+    };
+
+    (void)sink;
+    return cpu::counter() - start;
+};
+
+static void sweep(const char* name, const Op op) {
+    const std::uint64_t frequency = cpu::counter_frequency();
+
+    std::println("--- {} (MiB/s) ---", name);
+    std::println("size\tbyte loop\tneon\tspeedup");
+    for (const std::size_t size : SIZES) {
+        // Compare reads from both halves of buffer_a
+        if (op == Op::COMPARE && size > MAX_SIZE / 2)
+            break;
+
+        const std::uint64_t slow = measure(op, false, size);
+        const std::uint64_t fast = measure(op, true, size);
+
+        const std::uint64_t slow_rate = slow ? BYTES_PER_SAMPLE * frequency / slow >> 20 : 0;
+        const std::uint64_t fast_rate = fast ? BYTES_PER_SAMPLE * frequency / fast >> 20 : 0;
+        const std::uint64_t speedup10 = fast ? slow * 10 / fast : 0;
+
+        std::println("{}\t{}\t{}\t{}.{}x", size, slow_rate, fast_rate, speedup10 / 10,
+                     speedup10 % 10);
+    };
+};
+
+namespace bench {
+    void run_memory() {
+        const unsigned order = pages_to_order(2 * MAX_SIZE + 64);
+        buffer_a             = static_cast<char*>(alloc_pages(order));
+        buffer_b             = static_cast<char*>(alloc_pages(order));
+        if (!buffer_a || !buffer_b) {
+            std::println("memory bench: out of memory");
+            return;
+        };
+
+        byte_memset(buffer_a, 0x5a, PAGE_SIZE << order);
+        byte_memset(buffer_b, 0x5a, PAGE_SIZE << order);
+
+        sweep("memcpy", Op::COPY);
+        sweep("memset", Op::SET);
+        sweep("memmove", Op::MOVE);
+        sweep("memcmp", Op::COMPARE);
+
+        free_pages(buffer_a);
+        free_pages(buffer_b);
+    };
+}; // namespace bench
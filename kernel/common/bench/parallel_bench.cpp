@@ -0,0 +1,71 @@
+#include "bench.hpp"
+
+#include <arch/aarch64/cpu.hpp>
+#include <common/lib/memory.hpp>
+#include <common/lib/page_alloc.hpp>
+#include <common/lib/parallel.hpp>
+#include <common/std/print.hpp>
+
+constexpr std::size_t BUFFER_SIZE = 16 * 1024 * 1024;
+constexpr int         ROUNDS      = 8;
+
+static unsigned char* buffer;
+
+// A 64-bit sum of the bytes of [lo, hi), a stand-in for a real checksum
+static std::uint64_t checksum(const std::size_t lo, const std::size_t hi) {
+    std::uint64_t sum = 0;
+    for (std::size_t i = lo; i < hi; ++i) sum += buffer[i];
+
+    return sum;
+};
+
+static std::uint64_t add(const std::uint64_t a, const std::uint64_t b) {
+    return a + b;
+};
+
+// Runs op ROUNDS times, returns MiB/s
+template <typename Op>
+static std::uint64_t rate(Op op) {
+    const std::uint64_t start = cpu::counter();
+    for (int i = 0; i < ROUNDS; ++i) op();
+    const std::uint64_t ticks = cpu::counter() - start;
+
+    return ticks ? ROUNDS * BUFFER_SIZE * cpu::counter_frequency() / ticks >> 20 : 0;
+};
+
+static void report(const char* name, const std::uint64_t serial, const std::uint64_t parallel) {
+    const std::uint64_t speedup10 = serial ? parallel * 10 / serial : 0;
+    std::println("{}\t{}\t{}\t{}.{}x", name, serial, parallel, speedup10 / 10, speedup10 % 10);
+};
+
+namespace bench {
+    void run_parallel() {
+        buffer = static_cast<unsigned char*>(alloc_pages(pages_to_order(BUFFER_SIZE)));
+        if (!buffer) {
+            std::println("parallel bench: out of memory");
+            return;
+        };
+
+        volatile std::uint64_t sink = 0; // Keeps the checksums alive
+
+        std::println("--- parallel_for / parallel_reduce over 16 MiB (MiB/s) ---");
+        std::println("op\tserial\tparallel\tspeedup");
+
+        const std::uint64_t serial_set   = rate([] { memset(buffer, 0x5a, BUFFER_SIZE); });
+        const std::uint64_t parallel_set = rate([] {
+            parallel_for(0, BUFFER_SIZE, [](const std::size_t lo, const std::size_t hi) {
+                memset(buffer + lo, 0x5a, hi - lo);
+            });
+        });
+        report("memset", serial_set, parallel_set);
+
+        const std::uint64_t serial_sum   = rate([&] { sink = checksum(0, BUFFER_SIZE); });
+        const std::uint64_t parallel_sum = rate([&] {
+            sink = parallel_reduce(0, BUFFER_SIZE, std::uint64_t{0}, checksum, add);
+        });
+        report("checksum", serial_sum, parallel_sum);
+
+        (void)sink;
+        free_pages(buffer);
+    };
+}; // namespace bench
@@ -0,0 +1,115 @@
+#include "bench.hpp"
+
+#include <arch/aarch64/cpu.hpp>
+#include <common/lib/task.hpp>
+#include <common/lib/thread.hpp>
+#include <common/lib/thread_pool.hpp>
+#include <common/std/print.hpp>
+#include <common/std/thread.hpp>
+
+constexpr std::size_t THREAD_COUNTS[]   = {1, 16, 256, 1024, 4096, 16384};
+constexpr int         YIELDS_PER_THREAD = 32;
+constexpr std::size_t SPAWN_COUNT       = 4096;
+
+static std::uint64_t yields; // Counted from every CPU
+
+static WaitQueue   tasks_done;
+static std::size_t tasks_left;
+
+// Spawns count threads that each yield YIELDS_PER_THREAD times, returns the
+// ticks spent between the first switch and the last join
+static std::uint64_t measure(const std::size_t count) {
+    auto* threads = new std::thread[count];
+    for (std::size_t i = 0; i < count; ++i) {
+        threads[i] = std::thread([] {
+            for (int k = 0; k < YIELDS_PER_THREAD; ++k) {
+                __atomic_fetch_add(&yields, 1, __ATOMIC_RELAXED);
+                yield();
+            };
+        });
+    };
+
+    const std::uint64_t start = cpu::counter();
+    for (std::size_t i = 0; i < count; ++i) threads[i].join();
+    const std::uint64_t ticks = cpu::counter() - start;
+
+    delete[] threads;
+    return ticks;
+};
+
+static Task<void> yielding_task() {
+    for (int k = 0; k < YIELDS_PER_THREAD; ++k) {
+        __atomic_fetch_add(&yields, 1, __ATOMIC_RELAXED);
+        co_await async_yield();
+    };
+
+    if (__atomic_sub_fetch(&tasks_left, 1, __ATOMIC_ACQ_REL) == 0)
+        wake_all(tasks_done);
+};
+
+// measure() with count tasks on the executor threads instead of count threads
+static std::uint64_t measure_tasks(const std::size_t count) {
+    tasks_left = count;
+
+    const std::uint64_t start = cpu::counter();
+    for (std::size_t i = 0; i < count; ++i) spawn_task(yielding_task());
+
+    {
+        const IrqSpinLockScope guard(tasks_done.lock);
+        while (__atomic_load_n(&tasks_left, __ATOMIC_ACQUIRE)) {
+            block_on(tasks_done);
+        };
+    };
+
+    return cpu::counter() - start;
+};
+
+// Spawns and joins SPAWN_COUNT empty threads one after another, returns the
+// ticks spent. Past the first, each reuses the last one's Thread and stack.
+static std::uint64_t measure_spawn() {
+    const std::uint64_t start = cpu::counter();
+    for (std::size_t i = 0; i < SPAWN_COUNT; ++i) {
+        std::thread t([] {});
+        t.join();
+    };
+
+    return cpu::counter() - start;
+};
+
+namespace bench {
+    void run_scheduler() {
+        const std::uint64_t frequency = cpu::counter_frequency();
+
+        std::println("--- yield (ns per switch) ---");
+        std::println("threads\tswitches\tns");
+        for (const std::size_t count : THREAD_COUNTS) {
+            yields                    = 0;
+            const std::uint64_t ticks = measure(count);
+            const std::uint64_t total = __atomic_load_n(&yields, __ATOMIC_RELAXED);
+
+            const std::uint64_t ns = total ? ticks * 1000000000ull / frequency / total : 0;
+            std::println("{}\t{}\t{}", count, total, ns);
+        };
+
+        std::println("--- task yield (ns per resume) ---");
+        std::println("tasks\tresumes\tns");
+        for (const std::size_t count : THREAD_COUNTS) {
+            yields                    = 0;
+            const std::uint64_t ticks = measure_tasks(count);
+            const std::uint64_t total = __atomic_load_n(&yields, __ATOMIC_RELAXED);
+
+            const std::uint64_t ns = total ? ticks * 1000000000ull / frequency / total : 0;
+            std::println("{}\t{}\t{}", count, total, ns);
+        };
+
+        const ThreadPoolStats before = thread_pool_stats();
+        const std::uint64_t   ticks  = measure_spawn();
+        const ThreadPoolStats after  = thread_pool_stats();
+
+        std::println("--- spawn + join (ns per thread) ---");
+        std::println("threads\tns\trecycled\tcreated");
+        std::println("{}\t{}\t{}\t{}", SPAWN_COUNT,
+                     ticks * 1000000000ull / frequency / SPAWN_COUNT,
+                     after.recycled - before.recycled, after.created - before.created);
+    };
+}; // namespace bench
@@ -1,5 +1,13 @@
 #include "console.hpp"
 #if defined(__aarch64__)
+#include <arch/aarch64/cpu.hpp>
+#include <common/lib/spinlock.hpp>
+
+static SpinLock      line_lock;
+static unsigned      line_owner = ~0u;
+static unsigned      line_depth;
+static std::uint64_t line_flags; // Of the outermost lock(), restored by the last unlock()
+
 void console::initialize() {
     static PL011_UART instance{ 0x09000000 };
     m_uart = &instance;
@@ -12,4 +20,26 @@ void console::put_character(const char c) {
 void console::put_string(const char* str) {
     m_uart->put_string(str);
 };
+
+void console::lock() {
+    const std::uint64_t flags = cpu::irq_save();
+    const unsigned      self  = cpu::id();
+    if (__atomic_load_n(&line_owner, __ATOMIC_RELAXED) != self) {
+        line_lock.lock();
+        __atomic_store_n(&line_owner, self, __ATOMIC_RELAXED);
+        line_flags = flags;
+    };
+
+    line_depth++;
+};
+
+void console::unlock() {
+    if (--line_depth)
+        return;
+
+    const std::uint64_t flags = line_flags;
+    __atomic_store_n(&line_owner, ~0u, __ATOMIC_RELAXED);
+    line_lock.unlock();
+    cpu::irq_restore(flags);
+};
 #endif
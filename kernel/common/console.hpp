@@ -11,6 +11,25 @@ public:
     static void put_character(char c);
     static void put_string(const char* str);
 
+    // Keeps lines from different CPUs apart. IRQs stay masked while held, and
+    // the holding CPU may take it again, so a panic mid-line still prints.
+    static void lock();
+    static void unlock();
+
+    struct LineScope {
+        LineScope() {
+            lock();
+        };
+
+        ~LineScope() {
+            unlock();
+        };
+
+        LineScope(const LineScope&) = delete;
+
+        LineScope& operator=(const LineScope&) = delete;
+    };
+
 private:
 #if defined(__aarch64__)
     static inline PL011_UART* m_uart{nullptr};
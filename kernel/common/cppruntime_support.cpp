@@ -180,8 +180,9 @@ extern "C" void __cxa_pure_virtual() {
     panic("Pure virtual function call!");
 };
 
+// Allocations are charged to the caller of new, not to new itself
 void* operator new(const std::size_t size) {
-    void* ptr = malloc(size);
+    void* ptr = heap_alloc(size, __builtin_return_address(0));
     if (!ptr)
         panic("Out of memory!");
 
@@ -189,7 +190,11 @@ void* operator new(const std::size_t size) {
 };
 
 void* operator new[](const std::size_t size) {
-    return operator new(size);
+    void* ptr = heap_alloc(size, __builtin_return_address(0));
+    if (!ptr)
+        panic("Out of memory!");
+
+    return ptr;
 };
 
 void operator delete(void* ptr) noexcept {
@@ -198,7 +203,9 @@ void operator delete(void* ptr) noexcept {
 
 // Sized deallocation (C++14+)
 void operator delete(void* ptr, const std::size_t size) noexcept {
-    (void)size; // We don't use size in our simple free()
+    // free() already dispatches on the page frame, and keeps the heap stats in
+    // step, so the size hint isn't needed
+    (void)size;
     free(ptr);
 };
 
@@ -208,6 +215,39 @@ void operator delete[](void* ptr) noexcept {
 
 // Sized array deallocation (C++14+)
 void operator delete[](void* ptr, const std::size_t size) noexcept {
-    (void)size;
-    operator delete(ptr);
+    operator delete(ptr, size);
+};
+// Over-aligned allocation (C++17)
+void* operator new(const std::size_t size, const std::align_val_t align) {
+    void* ptr =
+        heap_aligned_alloc(static_cast<std::size_t>(align), size, __builtin_return_address(0));
+    if (!ptr)
+        panic("Out of memory!");
+
+    return ptr;
+};
+
+void* operator new[](const std::size_t size, const std::align_val_t align) {
+    void* ptr =
+        heap_aligned_alloc(static_cast<std::size_t>(align), size, __builtin_return_address(0));
+    if (!ptr)
+        panic("Out of memory!");
+
+    return ptr;
+};
+
+void operator delete(void* ptr, std::align_val_t) noexcept {
+    free(ptr);
+};
+
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept {
+    free(ptr);
+};
+
+void operator delete[](void* ptr, std::align_val_t) noexcept {
+    free(ptr);
+};
+
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept {
+    free(ptr);
 };
\ No newline at end of file
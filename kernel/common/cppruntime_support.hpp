@@ -1,4 +1,5 @@
 #pragma once
+#include "std/new.hpp"
 #include "std/stdint.hpp"
 
 typedef void (*func_ptr)();
@@ -81,54 +81,319 @@ namespace fdt {
         g_fdt_blob = dtb_ptr;
     };
 
-    // Capture state for the memory search
-    static std::uint64_t mem_base  = 0;
-    static std::uint64_t mem_size  = 0;
-    static bool          mem_found = false;
-
-    // Callback for finding "device_type = memory"
-    bool get_memory(std::uint64_t& out_base, std::uint64_t& out_size) {
-        mem_found = false;
-        scan_tree([](const char* node, const char* prop, void* data,
-                     const std::uint32_t length) {
+    static std::uint32_t read_cell(const void* data, const std::size_t index) {
+        return __builtin_bswap32(static_cast<const std::uint32_t*>(data)[index]);
+    };
+
+    static std::uint64_t read_cells64(const void* data, const std::size_t index) {
+        return (static_cast<std::uint64_t>(read_cell(data, index)) << 32) |
+               read_cell(data, index + 1);
+    };
+
+    static bool starts_with(const char* str, const char* prefix) {
+        return strncmp(str, prefix, strlen(prefix)) == 0;
+    };
+
+    // Properties of the node being scanned, collected until the next node starts
+    struct MemoryNode {
+        const char*   name;
+        bool          is_memory;
+        const void*   reg;
+        std::uint32_t reg_length;
+        std::uint32_t numa_node;
+    };
+
+    std::size_t get_memory_regions(MemoryRegion* out, const std::size_t max) {
+        std::size_t count   = 0;
+        MemoryNode  current = {};
+
+        // Emits every (base, size) pair of a memory node. QEMU's virt board
+        // uses 2 address and 2 size cells.
+        const auto flush = [&] {
+            if (!current.is_memory || !current.reg)
+                return;
+
+            for (std::uint32_t offset = 0; offset + 16 <= current.reg_length && count < max;
+                 offset += 16) {
+                const std::uint64_t base = read_cells64(current.reg, offset / 4);
+                const std::uint64_t size = read_cells64(current.reg, offset / 4 + 2);
+                if (size > 0)
+                    out[count++] = {base, size, current.numa_node};
+            };
+        };
+
+        scan_tree([&](const char* node, const char* prop, void* data,
+                      const std::uint32_t length) {
+            if (node != current.name) {
+                flush();
+                current           = {};
+                current.name      = node;
+                current.is_memory = node && (strcmp(node, "memory") == 0 ||
+                                             starts_with(node, "memory@"));
+            };
+
             // Check if this node identifies itself as memory
             if (strcmp(prop, "device_type") == 0) {
-                if (strcmp(static_cast<const char*>(data), "memory") == 0) {
-                    mem_found = true;
-                };
+                if (strcmp(static_cast<const char*>(data), "memory") == 0)
+                    current.is_memory = true;
+            }
+            else if (strcmp(prop, "reg") == 0) {
+                current.reg        = data;
+                current.reg_length = length;
+            }
+            else if (strcmp(prop, "numa-node-id") == 0 && length >= 4) {
+                current.numa_node = read_cell(data, 0);
             };
 
-            if (mem_found || (node && strstr(node, "memory") != nullptr)) {
-                if (strcmp(prop, "reg") == 0) {
-                    if (length < 16)
-                        return false; // need at least 2 addr + 2 size cells
+            return false;
+        });
+
+        flush();
+        return count;
+    };
+
+    // True if the compatible string list contains compatible
+    static bool has_compatible(const char* list, const std::uint32_t length,
+                               const char* compatible) {
+        for (std::uint32_t offset = 0; offset < length;) {
+            const char* entry = list + offset;
+            if (strcmp(entry, compatible) == 0)
+                return true;
 
-                    const auto* cells = static_cast<std::uint32_t*>(data);
+            offset += strlen(entry) + 1;
+        };
+
+        return false;
+    };
+
+    std::size_t get_device_regions(const char* compatible, Region* out, const std::size_t max) {
+        std::size_t   count      = 0;
+        const char*   current    = nullptr;
+        bool          matches    = false;
+        const void*   reg        = nullptr;
+        std::uint32_t reg_length = 0;
+
+        const auto flush = [&] {
+            if (!matches || !reg)
+                return;
+
+            for (std::uint32_t offset = 0; offset + 16 <= reg_length && count < max;
+                 offset += 16) {
+                out[count++] = {read_cells64(reg, offset / 4),
+                                read_cells64(reg, offset / 4 + 2)};
+            };
+        };
+
+        scan_tree([&](const char* node, const char* prop, void* data,
+                      const std::uint32_t length) {
+            if (node != current) {
+                flush();
+                current = node;
+                matches = false;
+                reg     = nullptr;
+            };
+
+            if (strcmp(prop, "compatible") == 0) {
+                matches = has_compatible(static_cast<const char*>(data), length, compatible);
+            }
+            else if (strcmp(prop, "reg") == 0) {
+                reg        = data;
+                reg_length = length;
+            };
+
+            return false;
+        });
+
+        flush();
+        return count;
+    };
+
+    bool get_interrupt_controller(const char* const* compatibles, InterruptController& out) {
+        const char*   current       = nullptr;
+        bool          is_controller = false;
+        const char*   matched       = nullptr;
+        const void*   reg           = nullptr;
+        std::uint32_t reg_length    = 0;
+        bool          found         = false;
+
+        const auto flush = [&] {
+            if (found || !is_controller || !matched || !reg)
+                return;
+
+            out.compatible   = matched;
+            out.region_count = 0;
+            for (std::uint32_t offset = 0; offset + 16 <= reg_length && out.region_count < 4;
+                 offset += 16) {
+                out.regions[out.region_count++] = {read_cells64(reg, offset / 4),
+                                                   read_cells64(reg, offset / 4 + 2)};
+            };
+
+            found = true;
+        };
 
-                    // Read base address (2 cells)
-                    const std::uint64_t base_high = __builtin_bswap32(cells[0]);
-                    const std::uint64_t base_low  = __builtin_bswap32(cells[1]);
-                    mem_base                      = (base_high << 32) | base_low;
+        scan_tree([&](const char* node, const char* prop, void* data,
+                      const std::uint32_t length) {
+            if (node != current) {
+                flush();
+                if (found)
+                    return true;
 
-                    // Read size (2 cells)
-                    const std::uint64_t size_high = __builtin_bswap32(cells[2]);
-                    const std::uint64_t size_low  = __builtin_bswap32(cells[3]);
-                    mem_size                      = (size_high << 32) | size_low;
+                current       = node;
+                is_controller = false;
+                matched       = nullptr;
+                reg           = nullptr;
+            };
 
-                    return true; // We found RAM
+            if (strcmp(prop, "interrupt-controller") == 0) {
+                is_controller = true;
+            }
+            else if (strcmp(prop, "compatible") == 0) {
+                for (const char* const* c = compatibles; *c && !matched; ++c) {
+                    if (has_compatible(static_cast<const char*>(data), length, *c))
+                        matched = *c;
                 };
+            }
+            else if (strcmp(prop, "reg") == 0) {
+                reg        = data;
+                reg_length = length;
             };
 
             return false;
         });
 
-        if (mem_size > 0) {
-            out_base = mem_base;
-            out_size = mem_size;
-            return true;
+        flush();
+        return found;
+    };
+
+    std::uint32_t get_device_interrupt(const std::uint64_t base) {
+        const char*   current    = nullptr;
+        bool          matches    = false;
+        const void*   interrupts = nullptr;
+        std::uint32_t intid      = 0;
+
+        // The GIC binding: <type number flags>, type 0 is an SPI and 1 a PPI.
+        // QEMU virt has no other interrupt parent.
+        const auto flush = [&] {
+            if (!matches || !interrupts || intid)
+                return;
+
+            const std::uint32_t type   = read_cell(interrupts, 0);
+            const std::uint32_t number = read_cell(interrupts, 1);
+            intid                      = number + (type == 0 ? 32 : 16);
         };
 
-        return false;
+        scan_tree([&](const char* node, const char* prop, void* data,
+                      const std::uint32_t length) {
+            if (node != current) {
+                flush();
+                if (intid)
+                    return true;
+
+                current    = node;
+                matches    = false;
+                interrupts = nullptr;
+            };
+
+            if (strcmp(prop, "reg") == 0 && length >= 8) {
+                matches = read_cells64(data, 0) == base;
+            }
+            else if (strcmp(prop, "interrupts") == 0 && length >= 12) {
+                interrupts = data;
+            };
+
+            return false;
+        });
+
+        flush();
+        return intid;
+    };
+
+    std::uint32_t get_cpu_node(const std::uint64_t mpidr) {
+        const char*   current_name = nullptr;
+        bool          matches      = false;
+        std::uint32_t numa_node    = 0;
+        bool          found        = false;
+
+        scan_tree([&](const char* node, const char* prop, void* data,
+                      const std::uint32_t length) {
+            if (node != current_name) {
+                current_name = node;
+                matches      = false;
+                found        = false;
+            };
+
+            if (!node || !starts_with(node, "cpu@"))
+                return false;
+
+            // reg holds the MPIDR affinity, in one or two cells
+            if (strcmp(prop, "reg") == 0) {
+                const std::uint64_t reg = length >= 8 ? read_cells64(data, 0)
+                                        : length >= 4 ? read_cell(data, 0)
+                                                      : ~0ull;
+                matches = reg == mpidr;
+            }
+            else if (strcmp(prop, "numa-node-id") == 0 && length >= 4) {
+                numa_node = read_cell(data, 0);
+                found     = true;
+            };
+
+            return matches && found;
+        });
+
+        return matches && found ? numa_node : 0;
+    };
+
+    std::size_t get_cpus(std::uint64_t* mpidrs, const std::size_t max) {
+        std::size_t count = 0;
+
+        scan_tree([&](const char* node, const char* prop, void* data,
+                      const std::uint32_t length) {
+            if (!node || !starts_with(node, "cpu@") || strcmp(prop, "reg") != 0)
+                return false;
+
+            if (length >= 4)
+                mpidrs[count++] = length >= 8 ? read_cells64(data, 0) : read_cell(data, 0);
+
+            return count == max;
+        });
+
+        return count;
+    };
+
+    const char* get_psci_method() {
+        const char* method = nullptr;
+
+        scan_tree([&](const char* node, const char* prop, void* data,
+                      const std::uint32_t length) {
+            if (!node || !starts_with(node, "psci") || strcmp(prop, "method") != 0 ||
+                length == 0)
+                return false;
+
+            method = static_cast<const char*>(data);
+            return true;
+        });
+
+        return method;
+    };
+
+    std::size_t get_numa_distances(NumaDistance* out, const std::size_t max) {
+        std::size_t count = 0;
+
+        scan_tree([&](const char* node, const char* prop, void* data,
+                      const std::uint32_t length) {
+            if (!node || !starts_with(node, "distance-map") ||
+                strcmp(prop, "distance-matrix") != 0)
+                return false;
+
+            // (from, to, distance) triples
+            for (std::uint32_t i = 0; i + 3 <= length / 4 && count < max; i += 3)
+                out[count++] = {read_cell(data, i), read_cell(data, i + 1),
+                                read_cell(data, i + 2)};
+
+            return true;
+        });
+
+        return count;
     };
 
     // VirtIO Scanner
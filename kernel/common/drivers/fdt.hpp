@@ -6,8 +6,56 @@ namespace fdt {
     // Must be called in kernel_main before using other functions
     void initialize(void* dtb_ptr);
 
-    // Returns true if memory node found, filling base and size
-    bool get_memory(std::uint64_t& out_base, std::uint64_t& out_size);
+    struct MemoryRegion {
+        std::uint64_t base;
+        std::uint64_t size;
+        std::uint32_t node; // numa-node-id, 0 if absent
+    };
+
+    struct Region {
+        std::uint64_t base;
+        std::uint64_t size;
+    };
+
+    struct InterruptController {
+        const char* compatible; // The entry of the caller's list that matched
+        Region      regions[4];
+        std::size_t region_count;
+    };
+
+    struct NumaDistance {
+        std::uint32_t from;
+        std::uint32_t to;
+        std::uint32_t distance;
+    };
+
+    // Fills out with every reg range of every memory node, returns the number
+    // found (at most max)
+    std::size_t get_memory_regions(MemoryRegion* out, std::size_t max);
+
+    // reg ranges of every node whose compatible list contains compatible
+    std::size_t get_device_regions(const char* compatible, Region* out, std::size_t max);
+
+    // First node marked interrupt-controller whose compatible list contains
+    // one of compatibles (nullptr terminated). False if there is none.
+    bool get_interrupt_controller(const char* const* compatibles, InterruptController& out);
+
+    // GIC INTID of the first interrupts entry of the node whose first reg range
+    // starts at base, 0 if there is none
+    std::uint32_t get_device_interrupt(std::uint64_t base);
+
+    // numa-node-id of the cpu node whose reg matches mpidr, 0 if absent
+    std::uint32_t get_cpu_node(std::uint64_t mpidr);
+
+    // reg (the MPIDR affinity) of every cpu node, returns the number found (at
+    // most max)
+    std::size_t get_cpus(std::uint64_t* mpidrs, std::size_t max);
+
+    // method of the /psci node, "hvc" or "smc", nullptr if there is none
+    const char* get_psci_method();
+
+    // Entries of /distance-map's distance-matrix, returns the number found
+    std::size_t get_numa_distances(NumaDistance* out, std::size_t max);
 
     // Find a VirtIO MMIO device with a specific Device ID
     // device_id: 1 = Net, 2 = Block, etc.
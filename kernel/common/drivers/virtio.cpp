@@ -1,23 +1,43 @@
 #include "virtio.hpp"
-#include "common/lib/memory.hpp" // malloc, free
+#include "common/drivers/fdt.hpp"    // get_device_interrupt
+#include "common/lib/memory.hpp"     // malloc, free
+#include "common/lib/page_alloc.hpp" // alloc_zeroed_pages
+#include "common/lib/task.hpp"       // AsyncEvent
+#include "common/lib/thread.hpp"     // block_on, wake_all
 #include "common/std/print.hpp"  // println
 
+#include <arch/aarch64/irq.hpp>
+
 // Global Driver State
 static volatile std::uint32_t* virtio_base = nullptr;
 static VirtQueue               rx_queue; // Queue 0
 static VirtQueue               tx_queue; // Queue 1
+static std::uint32_t           net_irq;  // 0 if the device can only be polled
+static WaitQueue               rx_waiters;
+static AsyncEvent              rx_event; // Tasks in virtio_net_wait_async()
+
+static bool rx_pending() {
+    return rx_queue.last_used_idx != rx_queue.used->idx;
+};
+
+// Used buffer notification: wake whoever sleeps in virtio_net_wait() or
+// virtio_net_wait_async()
+static std::uint64_t handle_irq(void*) {
+    const std::uint32_t status = virtio_base[VIRTIO_MMIO_INT_STATUS / 4];
+
+    virtio_base[VIRTIO_MMIO_INT_ACK / 4] = status;
+
+    if (status & 1) {
+        wake_all(rx_waiters);
+        rx_event.notify_all();
+    };
 
-// Helper: Allocate a 4KB aligned page
-static void* alloc_page() {
-    // Crude alignment: alloc 8KB, find 4KB boundary
-    void*                p       = malloc(8192);
-    const auto           addr    = reinterpret_cast<std::uintptr_t>(p);
-    const std::uintptr_t aligned = (addr + 4095) & ~4095;
-    return reinterpret_cast<void*>(aligned);
+    return 0; // The device doesn't say when it raised it
 };
 
-// Helper: Initialize a single queue
-static void setup_queue(int queue_idx, VirtQueue& vq) {
+// Helper: Initialize a single queue. False if the device lacks it or there is
+// no memory for its rings.
+static bool setup_queue(int queue_idx, VirtQueue& vq) {
     vq.index         = queue_idx;
     vq.last_used_idx = 0;
 
@@ -28,7 +48,7 @@ static void setup_queue(int queue_idx, VirtQueue& vq) {
     std::uint32_t max_size = virtio_base[VIRTIO_MMIO_QUEUE_NUM_MAX / 4];
     if (max_size == 0) {
         std::println("VirtIO: Queue {} unavailable", queue_idx);
-        return;
+        return false;
     };
 
     // Set queue size (must be power of 2, <= max_size)
@@ -40,8 +60,12 @@ static void setup_queue(int queue_idx, VirtQueue& vq) {
     // NOTE: This assumes 16 descriptors fits in one page (it easily does)
     virtio_base[VIRTIO_MMIO_QUEUE_ALIGN / 4] = 4096;
 
-    void* queue_mem = alloc_page();
-    std::memset(queue_mem, 0, 4096);
+    // Two pages: Desc + Avail in the first, Used in the second
+    void* queue_mem = alloc_zeroed_pages(1);
+    if (!queue_mem) {
+        std::println("VirtIO: No memory for queue {}", queue_idx);
+        return false;
+    };
 
     // Calculate offsets within that page
     // Desc Table: 16 * 16 bytes = 256 bytes
@@ -75,19 +99,20 @@ static void setup_queue(int queue_idx, VirtQueue& vq) {
     // Tell Device the Physical Page Number (Legacy MMIO)
     const auto phys_addr                   = reinterpret_cast<std::uintptr_t>(queue_mem);
     virtio_base[VIRTIO_MMIO_QUEUE_PFN / 4] = phys_addr / 4096;
+    return true;
 };
 
-void virtio_net_init(std::uint64_t base_addr) {
+bool virtio_net_init(std::uint64_t base_addr) {
     virtio_base = reinterpret_cast<volatile std::uint32_t*>(base_addr);
 
     if (virtio_base[VIRTIO_MMIO_MAGIC_VALUE / 4] != 0x74726976) {
         std::println("VirtIO: Bad Magic Value");
-        return;
+        return false;
     };
 
     if (virtio_base[VIRTIO_MMIO_DEVICE_ID / 4] != VIRTIO_DEV_NET) {
         std::println("VirtIO: Not a network device");
-        return;
+        return false;
     };
 
     // Initialization Sequence
@@ -107,14 +132,29 @@ void virtio_net_init(std::uint64_t base_addr) {
     // virtio_base[0x020/4] = ...; // Write Guest Features
 
     // Setup Queues
-    setup_queue(0, rx_queue); // RX
-    setup_queue(1, tx_queue); // TX
+    if (!setup_queue(0, rx_queue) || !setup_queue(1, tx_queue)) {
+        // Reset first, so the device lets go of the RX ring before it is freed
+        virtio_base[VIRTIO_MMIO_STATUS / 4] = 0;
+        free_pages(rx_queue.desc); // nullptr if RX failed
+        rx_queue.desc = nullptr;
+
+        virtio_base[VIRTIO_MMIO_STATUS / 4] = 128; // FAILED
+        return false;
+    };
 
     // Go!
     status                              |= 4; // DRIVER_OK
     virtio_base[VIRTIO_MMIO_STATUS / 4]  = status;
 
     std::println("VirtIO Net: Initialized at {}", reinterpret_cast<void*>(base_addr));
+
+    if (const std::uint32_t intid = fdt::get_device_interrupt(base_addr);
+        intid && irq::register_handler(intid, handle_irq, nullptr)) {
+        net_irq = intid;
+        std::println("VirtIO Net: IRQ {}", intid);
+    };
+
+    return true;
 };
 
 void virtio_net_init_rx() {
@@ -181,7 +221,7 @@ void virtio_net_send(const void* data, std::uint32_t length) {
 
 void virtio_net_poll() {
     // Check RX Used Ring
-    while (rx_queue.last_used_idx != rx_queue.used->idx) {
+    while (rx_pending()) {
         std::uint16_t used_slot = rx_queue.last_used_idx % rx_queue.size;
         auto [id, length]       = rx_queue.used->ring[used_slot];
 
@@ -211,4 +251,29 @@ void virtio_net_poll() {
 
     // Notify if we recycled anything (check if indices moved)
     // virtio_base[VIRTIO_MMIO_QUEUE_NOTIFY / 4] = 0;
+};
+
+void virtio_net_wait() {
+    if (!net_irq) {
+        yield();
+        return;
+    };
+
+    // The queue stays locked from the check to block_on(), or the interrupt
+    // could land in between, on any CPU, and its wake-up would be lost
+    const IrqSpinLockScope guard(rx_waiters.lock);
+    while (!rx_pending()) {
+        block_on(rx_waiters);
+    };
+};
+
+Task<void> virtio_net_wait_async() {
+    if (!net_irq) {
+        co_await async_yield();
+        co_return;
+    };
+
+    while (!rx_pending()) {
+        co_await rx_event.wait(rx_pending);
+    };
 };
\ No newline at end of file
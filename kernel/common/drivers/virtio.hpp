@@ -1,4 +1,5 @@
 #pragma once
+#include <common/lib/task.hpp>
 #include <common/std/stdint.hpp>
 
 // VirtIO MMIO Register Offsets
@@ -13,6 +14,8 @@ constexpr std::uint32_t VIRTIO_MMIO_QUEUE_NUM     = 0x038;
 constexpr std::uint32_t VIRTIO_MMIO_QUEUE_ALIGN   = 0x03C;
 constexpr std::uint32_t VIRTIO_MMIO_QUEUE_PFN     = 0x040;
 constexpr std::uint32_t VIRTIO_MMIO_QUEUE_NOTIFY  = 0x050;
+constexpr std::uint32_t VIRTIO_MMIO_INT_STATUS    = 0x060;
+constexpr std::uint32_t VIRTIO_MMIO_INT_ACK       = 0x064;
 
 // Device Constants
 constexpr std::uint32_t VIRTIO_DEV_NET     = 1;
@@ -75,8 +78,9 @@ struct virtio_net_hdr {
     // std::uint16_t num_buffers; // Only if VIRTIO_NET_F_MRG_RXBUF is negotiated
 } __attribute__((packed));
 
-// Call this once with the MMIO base address found in FDT
-void virtio_net_init(std::uint64_t base_addr);
+// Call this once with the MMIO base address found in FDT. False if the device
+// can't be used, then nothing else here may be called.
+bool virtio_net_init(std::uint64_t base_addr);
 
 // Call this to initialize the receive buffers
 void virtio_net_init_rx();
@@ -85,4 +89,12 @@ void virtio_net_init_rx();
 void virtio_net_send(const void* data, std::uint32_t length);
 
 // Call this in your main loop to check for incoming packets
-void virtio_net_poll();
\ No newline at end of file
+void virtio_net_poll();
+
+// Sleeps until the RX queue has packets for virtio_net_poll(). Woken by the
+// device's interrupt, or just yields if it has none.
+void virtio_net_wait();
+
+// virtio_net_wait() for a Task: suspends it, rather than the executor thread
+// running it, until the RX queue has packets
+Task<void> virtio_net_wait_async();
\ No newline at end of file
@@ -3,20 +3,78 @@
 
 #include "drivers/fdt.hpp"
 #include "lib/memory.hpp"
+#include "lib/page_alloc.hpp"
+
+#include <arch/aarch64/cpu.hpp>
+#include <arch/aarch64/gic.hpp>
+#include <arch/aarch64/mmu.hpp>
+#include <arch/aarch64/timer.hpp>
+
+constexpr std::size_t    MAX_MEMORY_REGIONS = 8;
+constexpr std::size_t    MAX_DEVICE_REGIONS = 32; // QEMU virt has 32 virtio-mmio slots
+constexpr std::size_t    MAX_DISTANCES      = MAX_NODES * MAX_NODES;
+constexpr std::uintptr_t UART_BASE          = 0x09000000;
+
+// Identity maps RAM as Normal memory and the devices the kernel drives as
+// Device-nGnRE, then turns on the MMU and caches. Until then every access is
+// Device-nGnRnE, so this runs before the page allocator touches its frames.
+static void enable_mmu(const fdt::MemoryRegion* memory, const std::size_t memory_count) {
+    for (std::size_t i = 0; i < memory_count; ++i) {
+        if (!mmu::map_identity(memory[i].base, memory[i].size, mmu::MemoryType::NORMAL)) {
+            std::println("MMU: cannot map RAM at {}, staying off",
+                         reinterpret_cast<void*>(memory[i].base));
+            return;
+        };
+    };
+
+    fdt::Region devices[MAX_DEVICE_REGIONS];
+    std::size_t device_count = fdt::get_device_regions("arm,pl011", devices, 1);
+    if (device_count == 0)
+        devices[device_count++] = {UART_BASE, PAGE_SIZE};
+
+    device_count += fdt::get_device_regions("virtio,mmio", devices + device_count,
+                                            MAX_DEVICE_REGIONS - device_count);
+
+    for (std::size_t i = 0; i < device_count; ++i) {
+        if (!mmu::map_identity(devices[i].base, devices[i].size, mmu::MemoryType::DEVICE)) {
+            std::println("MMU: cannot map device at {}",
+                         reinterpret_cast<void*>(devices[i].base));
+        };
+    };
+
+    mmu::enable();
+};
 
 extern "C" char __bss_start[], __bss_end[];
 extern "C" void _initialize(void* dtb_ptr) {
-    for (char* p = __bss_start; p < __bss_end; ++p)
-        *p = 0;
+    memset(__bss_start, 0, __bss_end - __bss_start);
 
     fdt::initialize(dtb_ptr);
     console::initialize();
 
-    std::uint64_t mem_base, mem_size;
-    if (fdt::get_memory(mem_base, mem_size)) {
-        set_heap(mem_base, mem_size);
-    }
-    else {
-        set_heap(0x40000000, 128 * 1024 * 1024);
+    fdt::MemoryRegion regions[MAX_MEMORY_REGIONS];
+    std::size_t       region_count = fdt::get_memory_regions(regions, MAX_MEMORY_REGIONS);
+    if (region_count == 0)
+        regions[region_count++] = {0x40000000, 128 * 1024 * 1024, 0};
+
+    enable_mmu(regions, region_count);
+
+    // Distances first, so the fallback order is known before anything is allocated
+    fdt::NumaDistance distances[MAX_DISTANCES];
+    const std::size_t distance_count = fdt::get_numa_distances(distances, MAX_DISTANCES);
+    for (std::size_t i = 0; i < distance_count; ++i)
+        page_alloc_set_distance(distances[i].from, distances[i].to, distances[i].distance);
+
+    set_local_node(fdt::get_cpu_node(cpu::affinity()));
+
+    for (std::size_t i = 0; i < region_count; ++i)
+        set_heap(regions[i].base, regions[i].size, regions[i].node);
+
+    // The timer, which only fires for a time slice or a timer wheel deadline.
+    // Slices start once kernel_main adopts the boot thread. The other CPUs are
+    // started from kernel_main too, once the static constructors have run.
+    if (gic::initialize()) {
+        timer::initialize();
+        cpu::irq_enable();
     };
-};
\ No newline at end of file
+};
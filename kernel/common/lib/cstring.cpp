@@ -1,55 +1,116 @@
 #include "cstring.hpp"
-#include "common/std/stdint.hpp"
+#include "memory.hpp"
 
-extern "C" int strcmp(const char* a, const char* b) {
-    while (*a && (*a == *b)) {
-        ++a;
-        ++b;
+// strlen, strcmp and strncmp live in arch/aarch64/string.s
+
+// Maximal suffix of needle under the byte order (or its reverse), as in
+// Crochemore-Perrin. Returns the index just before the suffix, which may be -1
+// (as size_t), and its period.
+static std::size_t maximal_suffix(const unsigned char* needle, const std::size_t length,
+                                  const bool reverse, std::size_t& period) {
+    std::size_t suffix = static_cast<std::size_t>(-1);
+    std::size_t j      = 0;
+    std::size_t k      = 1;
+    std::size_t p      = 1;
+
+    while (j + k < length) {
+        const unsigned char a = needle[suffix + k];
+        const unsigned char b = needle[j + k];
+        if (a == b) {
+            if (k == p) {
+                j += p;
+                k  = 1;
+            }
+            else {
+                ++k;
+            };
+        }
+        else if (reverse ? a < b : a > b) {
+            j += k;
+            k  = 1;
+            p  = j - suffix;
+        }
+        else {
+            suffix = j++;
+            k = p = 1;
+        };
     };
 
-    return static_cast<unsigned char>(*a) - static_cast<unsigned char>(*b);
+    period = p;
+    return suffix;
 };
 
-extern "C" int strncmp(const char* a, const char* b, std::size_t n) {
-    for (; n > 0; --n, ++a, ++b) {
-        const auto ca = static_cast<unsigned char>(*a);
-        const auto cb = static_cast<unsigned char>(*b);
+// Two-Way string matching: O(n + m) time, O(1) space
+static const char* two_way(const unsigned char* haystack, const std::size_t haystack_length,
+                           const unsigned char* needle, const std::size_t length) {
+    // Critical factorization: the later of the two maximal suffixes
+    std::size_t period, reverse_period;
+    std::size_t split         = maximal_suffix(needle, length, false, period);
+    const std::size_t reverse = maximal_suffix(needle, length, true, reverse_period);
+    if (reverse + 1 > split + 1) {
+        split  = reverse;
+        period = reverse_period;
+    };
+
+    // For a periodic needle, the part matched in the previous window is
+    // remembered so it isn't compared again
+    std::size_t memory_start = 0;
+    if (memcmp(needle, needle + period, split + 1) != 0) {
+        const std::size_t left  = split + 1;
+        const std::size_t right = length - split - 1;
+        period                  = (left > right ? left : right) + 1;
+    }
+    else {
+        memory_start = length - period;
+    };
+
+    std::size_t remembered = 0;
+    for (std::size_t pos = 0; pos + length <= haystack_length;) {
+        const unsigned char* window = haystack + pos;
+
+        // Right half, left to right
+        std::size_t k = split + 1 > remembered ? split + 1 : remembered;
+        while (k < length && needle[k] == window[k]) ++k;
+
+        if (k < length) {
+            pos        += k - split;
+            remembered  = 0;
+            continue;
+        };
 
-        if (ca != cb)
-            return ca - cb;
+        // Left half, right to left
+        k = split + 1;
+        while (k > remembered && needle[k - 1] == window[k - 1]) --k;
 
-        if (ca == '\0')
-            return 0;
+        if (k <= remembered)
+            return reinterpret_cast<const char*>(window);
+
+        pos        += period;
+        remembered  = memory_start;
     };
 
-    return 0;
+    return nullptr;
 };
 
 extern "C" char* strstr(const char* haystack, const char* needle) {
     if (*needle == '\0')
         return const_cast<char*>(haystack);
 
-    for (const char* h = haystack; *h != '\0'; ++h) {
-        const char* nh = h;
-        const char* nn = needle;
-        while (*nn && *nh && *nn == *nh) {
-            ++nn;
-            ++nh;
-        };
+    // Skip ahead to the first occurrence of the first character
+    while (*haystack && *haystack != *needle) ++haystack;
 
-        if (*nn == '\0')
-            return const_cast<char*>(h);
-    };
+    if (*haystack == '\0')
+        return nullptr;
 
-    return nullptr;
-};
+    if (needle[1] == '\0')
+        return const_cast<char*>(haystack);
 
-extern "C" std::size_t strlen(const char* str) {
-    std::size_t length = 0;
-    while (*str != '\0') {
-        length++;
-        str++;
-    };
+    const std::size_t length          = strlen(needle);
+    const std::size_t haystack_length = strlen(haystack);
+    if (length > haystack_length)
+        return nullptr;
 
-    return length;
-};
\ No newline at end of file
+    return const_cast<char*>(two_way(reinterpret_cast<const unsigned char*>(haystack),
+                                     haystack_length,
+                                     reinterpret_cast<const unsigned char*>(needle), length));
+};
@@ -1,52 +1,42 @@
 #include "memory.hpp"
+#include "page_alloc.hpp"
+#include "slab.hpp"
+#include "thread.hpp"
+#include "tlsf.hpp"
 
+#include <common/console.hpp>
 #include <common/cppruntime_support.hpp>
 #include <common/std/format.hpp>
 #include <common/std/print.hpp>
 
-extern "C" void* memset(void* dest, const int c, const std::size_t n) {
-    auto* p = static_cast<unsigned char*>(dest);
-    for (std::size_t i = 0; i < n; ++i) p[i] = static_cast<unsigned char>(c);
-
-    return dest;
-};
-
-extern "C" void* memcpy(void* dest, const void* src, const std::size_t n) {
-    const auto d = static_cast<char*>(dest);
-    const auto s = static_cast<const char*>(src);
-    for (std::size_t i = 0; i < n; ++i) d[i] = s[i];
-
-    return dest;
-};
+#if PRISM_HEAP_TRACE
+#include <arch/aarch64/cpu.hpp>
+#endif
 
 constexpr std::size_t ALLOC_ALIGN = 16; // AArch64: 16-byte stack/ABI alignment is safe
-static std::size_t    align_up(const std::size_t x, const std::size_t a) {
-    return (x + (a - 1)) & ~(a - 1);
-};
 
-struct FreeBlock {
-    FreeBlock*  next;
-    std::size_t size;
-};
+// General purpose heaps, one per NUMA node, fed with pools from that node's
+// pages on demand. A block is freed to the heap of the node its page is on.
+static Tlsf general_heaps[MAX_NODES];
 
-static FreeBlock* free_list = nullptr;
+constexpr unsigned    HEAP_POOL_ORDER  = 8;          // 1 MiB pools
+constexpr std::size_t LARGE_ALLOC_SIZE = 256 * 1024; // Served directly by alloc_pages()
 
 extern "C" char __text_start;
 extern "C" char _image_end;
 extern "C" char _heap_start;
 extern "C" char _heap_end;
 
-static char* heap_ptr = &_heap_start;
-static char* heap_end = &_heap_end;
+extern "C" void set_heap(const std::uint64_t mem_base, const std::uint64_t mem_size,
+                         const unsigned node) {
+    // Everything past the kernel image belongs to the page allocator
+    std::uint64_t       start = mem_base;
+    const std::uint64_t end   = mem_base + mem_size;
+    if (start < reinterpret_cast<std::uintptr_t>(&_heap_start))
+        start = reinterpret_cast<std::uintptr_t>(&_heap_start);
 
-extern "C" void set_heap(const std::uint64_t mem_base, const std::uint64_t mem_size) {
-    heap_end = reinterpret_cast<char*>(mem_base + mem_size);
-    if (heap_end < heap_ptr)
-        heap_end = heap_ptr;
-
-    // Keep the bump pointer aligned
-    heap_ptr =
-        reinterpret_cast<char*>(align_up(reinterpret_cast<std::size_t>(heap_ptr), ALLOC_ALIGN));
+    if (end > start)
+        page_alloc_add_range(start, end - start, node);
 
     /*{
         // 1. Total Hardware RAM (Exactly what the bootloader told us)
@@ -81,122 +71,680 @@ extern "C" void set_heap(const std::uint64_t mem_base, const std::uint64_t mem_s
 };
 
 extern "C" std::size_t total_heap_size() {
-    return heap_end - &_heap_start;
+    return total_pages() * PAGE_SIZE;
 };
 
 extern "C" std::size_t used_heap() {
-    return heap_ptr - &_heap_start;
+    return total_heap_size() - free_heap();
 };
 
 extern "C" std::size_t free_heap() {
-    return heap_end - heap_ptr;
-};
+    std::size_t bytes = free_pages_count() * PAGE_SIZE;
+    for (const Tlsf& heap : general_heaps) bytes += heap.free_bytes();
 
-// Helper to get the block from the user pointer
-static FreeBlock* get_block(void* ptr) {
-    return static_cast<FreeBlock*>(ptr) - 1;
+    return bytes;
 };
 
-extern "C" void* malloc(std::size_t size) {
-    if (size == 0)
-        size = 1;
+// Gives node's heap a new pool from node's pages that can hold at least size bytes
+static bool grow_general_heap(const std::size_t size, const unsigned node) {
+    // Leave room for the bin round-up in Tlsf::malloc and the block headers
+    unsigned order = pages_to_order(size + size / 16 + Tlsf::MIN_POOL_SIZE);
+    if (order < HEAP_POOL_ORDER)
+        order = HEAP_POOL_ORDER;
 
-    // Calculate total required bytes (Header + Payload)
-    std::size_t total_size = sizeof(FreeBlock) + size;
-    if (total_size < size) // Check for overflow before alignment
-        return nullptr;
+    void* pool = alloc_pages_on(order, node);
+    if (!pool)
+        return false;
 
-    total_size = align_up(total_size, ALLOC_ALIGN);
-
-    // Find a free block
-    FreeBlock** prev = &free_list;
-    for (FreeBlock* block = free_list; block; block = block->next) {
-        if (block->size >= total_size) {
-            // split if large enough to avoid big internal waste
-            const std::size_t remain = block->size - total_size;
-
-            if (remain >= sizeof(FreeBlock) + ALLOC_ALIGN) {
-                // split tail
-                auto* tail =
-                    reinterpret_cast<FreeBlock*>(reinterpret_cast<char*>(block) + total_size);
-                tail->size = remain;
-                tail->next = block->next;
-
-                // Link previous to tail, giving us 'block'
-                *prev       = tail;
-                block->size = total_size;
-            }
-            else {
-                // Use entire block (remove from list)
-                *prev = block->next;
-            };
-
-            // return pointer just after header
-            return block + 1;
-        };
+    page_frame(pool)->use = PageUse::HEAP;
+    general_heaps[node].add_pool(pool, PAGE_SIZE << order);
+    return true;
+};
+
+static void* heap_malloc(Tlsf& heap, const std::size_t size, const std::size_t alignment) {
+    return alignment > ALLOC_ALIGN ? heap.malloc_aligned(size, alignment) : heap.malloc(size);
+};
 
-        prev = &block->next;
+// A node's free blocks, then its pages, before moving on to the next node
+static void* alloc_from_heaps(const std::size_t size, const unsigned node,
+                              const std::size_t alignment) {
+    // An aligned block may have to skip up to alignment bytes of its pool
+    const std::size_t reserve = alignment > ALLOC_ALIGN ? size + 2 * alignment : size;
+
+    void*    ptr = nullptr;
+    unsigned target;
+    for (unsigned i = 0; !ptr && (target = fallback_node(node, i)) < MAX_NODES; ++i) {
+        ptr = heap_malloc(general_heaps[target], size, alignment);
+        if (!ptr && grow_general_heap(reserve, target))
+            ptr = heap_malloc(general_heaps[target], size, alignment);
     };
 
-    // Bump Allocation
-    const auto current_addr = reinterpret_cast<std::size_t>(heap_ptr);
-    const std::size_t aligned_addr = align_up(current_addr, ALLOC_ALIGN);
+    return ptr;
+};
+
+static void* alloc_general(const std::size_t size, const unsigned node,
+                           const std::size_t alignment = ALLOC_ALIGN) {
+    void* ptr = alloc_from_heaps(size, node, alignment);
+
+    // Blocks waiting in the zeroed pools are free memory too
+    if (!ptr && drain_zeroed_pools())
+        ptr = alloc_from_heaps(size, node, alignment);
 
-    const auto p = reinterpret_cast<char*>(aligned_addr);
-    if (p + total_size > heap_end) {
+    if (!ptr) {
         panic("Out of memory! System halted.");
         // panic(std::format("Out of memory! Tried to allocate {} bytes ({} requested, {}
         // overhead)",
         //     total_size, size, sizeof(FreeBlock)).c_str());
     };
 
-    auto* block = reinterpret_cast<FreeBlock*>(p);
-    block->size = total_size;
+    return ptr;
+};
+
+static void* alloc_large(const std::size_t size, const unsigned node) {
+    void* ptr = alloc_pages_node(pages_to_order(size), node);
+    if (!ptr)
+        panic("Out of memory! System halted.");
+
+    return ptr;
+};
+
+// Bytes that can be used at ptr without reallocating
+static std::size_t usable_size(const void* ptr, const PageFrame* frame) {
+    if (frame && frame->use == PageUse::SLAB)
+        return slab::usable_size(ptr);
+
+    if (frame && frame->use == PageUse::PAGES)
+        return PAGE_SIZE << frame->order;
+
+    return Tlsf::usable_size(ptr);
+};
+
+static bool is_general(const PageFrame* frame) {
+    return !frame || frame->use == PageUse::HEAP || frame->use == PageUse::NONE;
+};
+
+// Instrumentation
+// Counters are always on; they cost a handful of adds per call. Live bytes are
+// tracked in usable (not requested) bytes, so they match what the heap consumes.
+static std::size_t live_bytes      = 0;
+static std::size_t peak_live_bytes = 0;
+static std::size_t alloc_count     = 0;
+static std::size_t free_count      = 0;
+static std::size_t size_histogram[HEAP_HISTOGRAM_BUCKETS];
+
+#if PRISM_HEAP_TRACK_SITES
+// Allocation sites keyed by return address, plus a pointer -> site map so a
+// free can be charged back to the site that made the allocation
+struct SiteEntry {
+    const void* site;
+    std::size_t live_count;
+    std::size_t live_bytes;
+    std::size_t total_count;
+};
+
+struct PtrEntry {
+    const void*   ptr;
+    std::uint32_t site;
+    std::uint32_t bytes;
+};
+
+constexpr std::size_t MAX_SITES       = 1024;
+constexpr unsigned    PTR_TABLE_ORDER = 9; // 2 MiB of pages, 128Ki entries
+constexpr std::size_t PTR_TABLE_SIZE  = (PAGE_SIZE << PTR_TABLE_ORDER) / sizeof(PtrEntry);
+
+static_assert((PTR_TABLE_SIZE & (PTR_TABLE_SIZE - 1)) == 0);
+
+static SiteEntry   sites[MAX_SITES];
+static PtrEntry*   ptr_table       = nullptr;
+static std::size_t ptr_table_count = 0;
+static std::size_t untracked_count = 0; // Allocations that did not fit the tables
+
+static std::size_t hash_ptr(const void* ptr, const std::size_t mask) {
+    const std::uint64_t h = (reinterpret_cast<std::uintptr_t>(ptr) >> 4) * 0x9E3779B97F4A7C15ull;
+    return (h >> 32) & mask;
+};
+
+static std::uint32_t site_index(const void* site) {
+    std::size_t i = hash_ptr(site, MAX_SITES - 1);
+    for (std::size_t probe = 0; probe < MAX_SITES; ++probe, i = (i + 1) & (MAX_SITES - 1)) {
+        if (sites[i].site == site)
+            return i;
+
+        if (!sites[i].site) {
+            sites[i].site = site;
+            return i;
+        };
+    };
+
+    return MAX_SITES; // Table full
+};
+
+static PtrEntry* find_ptr(const void* ptr) {
+    if (!ptr_table)
+        return nullptr;
+
+    for (std::size_t i = hash_ptr(ptr, PTR_TABLE_SIZE - 1);; i = (i + 1) & (PTR_TABLE_SIZE - 1)) {
+        if (ptr_table[i].ptr == ptr)
+            return &ptr_table[i];
+
+        if (!ptr_table[i].ptr)
+            return nullptr;
+    };
+};
+
+// Linear probing with backward-shift deletion, no tombstones
+static void remove_ptr(PtrEntry* entry) {
+    std::size_t hole = entry - ptr_table;
+    std::size_t next = hole;
+    while (true) {
+        next = (next + 1) & (PTR_TABLE_SIZE - 1);
+        if (!ptr_table[next].ptr)
+            break;
+
+        const std::size_t home = hash_ptr(ptr_table[next].ptr, PTR_TABLE_SIZE - 1);
+        const bool        stays =
+            hole <= next ? (home > hole && home <= next) : (home > hole || home <= next);
+        if (!stays) {
+            ptr_table[hole] = ptr_table[next];
+            hole            = next;
+        };
+    };
+
+    ptr_table[hole].ptr = nullptr;
+    ptr_table_count--;
+};
+
+static void track_alloc(const void* ptr, const std::size_t bytes, const void* site) {
+    if (!ptr_table) {
+        ptr_table = static_cast<PtrEntry*>(alloc_pages(PTR_TABLE_ORDER));
+        if (!ptr_table) {
+            untracked_count++;
+            return;
+        };
+
+        memset(ptr_table, 0, PAGE_SIZE << PTR_TABLE_ORDER);
+    };
+
+    const std::uint32_t index = site_index(site);
+    if (index == MAX_SITES || ptr_table_count >= PTR_TABLE_SIZE * 3 / 4) {
+        untracked_count++;
+        return;
+    };
+
+    std::size_t i = hash_ptr(ptr, PTR_TABLE_SIZE - 1);
+    while (ptr_table[i].ptr) i = (i + 1) & (PTR_TABLE_SIZE - 1);
+
+    ptr_table[i] = {ptr, index, static_cast<std::uint32_t>(bytes)};
+    ptr_table_count++;
+
+    sites[index].live_count++;
+    sites[index].live_bytes += bytes;
+    sites[index].total_count++;
+};
+
+static void track_free(const void* ptr) {
+    PtrEntry* entry = find_ptr(ptr);
+    if (!entry)
+        return;
+
+    sites[entry->site].live_count--;
+    sites[entry->site].live_bytes -= entry->bytes;
+    remove_ptr(entry);
+};
+
+static void track_resize(const void* ptr, const std::size_t bytes) {
+    if (PtrEntry* entry = find_ptr(ptr)) {
+        sites[entry->site].live_bytes += bytes;
+        sites[entry->site].live_bytes -= entry->bytes;
+        entry->bytes                   = static_cast<std::uint32_t>(bytes);
+    };
+};
+#endif
+
+static void record_alloc(const void* ptr, const std::size_t size, const void* site) {
+    const std::size_t bytes = usable_size(ptr, page_frame(ptr));
+
+    live_bytes += bytes;
+    if (live_bytes > peak_live_bytes)
+        peak_live_bytes = live_bytes;
+
+    alloc_count++;
+
+    const std::size_t bucket = 63 - __builtin_clzll(size | 1);
+    size_histogram[bucket < HEAP_HISTOGRAM_BUCKETS ? bucket : HEAP_HISTOGRAM_BUCKETS - 1]++;
+
+#if PRISM_HEAP_TRACK_SITES
+    track_alloc(ptr, bytes, site);
+#else
+    (void)site;
+#endif
+};
+
+static void record_free(const void* ptr, const std::size_t bytes) {
+    live_bytes -= bytes;
+    free_count++;
+
+#if PRISM_HEAP_TRACK_SITES
+    track_free(ptr);
+#else
+    (void)ptr;
+#endif
+};
+
+// In-place shrink or growth of a live block
+static void record_resize(const void* ptr, const std::size_t old_bytes) {
+    const std::size_t bytes = usable_size(ptr, page_frame(ptr));
+
+    live_bytes = live_bytes - old_bytes + bytes;
+    if (live_bytes > peak_live_bytes)
+        peak_live_bytes = live_bytes;
+
+#if PRISM_HEAP_TRACK_SITES
+    track_resize(ptr, bytes);
+#endif
+};
+
+static void* allocate(std::size_t size, unsigned node = LOCAL_NODE) {
+    if (size == 0)
+        size = 1;
+
+    if (node >= MAX_NODES)
+        node = local_node();
+
+    // Small objects are served by the size-class slabs. Slab pages come from
+    // the local node, so remote hints skip them.
+    if (size <= slab::MAX_SIZE && node == local_node()) {
+        if (void* ptr = slab::alloc(size))
+            return ptr;
+    };
+
+    if (size >= LARGE_ALLOC_SIZE)
+        return alloc_large(size, node);
+
+    return alloc_general(size, node);
+};
+
+static void* allocate_aligned(const std::size_t alignment, const std::size_t size) {
+    if (alignment <= ALLOC_ALIGN)
+        return allocate(size);
+
+    // Slab objects are aligned to their class
+    if (alignment <= slab::MAX_SIZE) {
+        if (void* ptr = slab::alloc_aligned(size, alignment))
+            return ptr;
+    };
 
-    // Update heap pointer
-    heap_ptr = p + total_size;
+    // Page blocks are aligned to their own size
+    if (size >= LARGE_ALLOC_SIZE || alignment >= PAGE_SIZE)
+        return alloc_large(size < alignment ? alignment : size, LOCAL_NODE);
 
-    return block + 1;
+    return alloc_general(size, local_node(), alignment);
+};
+
+static void release(void* ptr, const PageFrame* frame) {
+    // The page frame tells which layer the pointer came from
+    if (frame && frame->use == PageUse::SLAB) {
+        slab::free(ptr);
+        return;
+    };
+
+    if (frame && frame->use == PageUse::PAGES) {
+        free_pages(ptr);
+        return;
+    };
+
+    general_heaps[page_node(ptr)].free(ptr);
+};
+
+static bool expand(void* ptr, const PageFrame* frame, const std::size_t new_size) {
+    // Slab objects are fixed to their class
+    if (frame && frame->use == PageUse::SLAB)
+        return false;
+
+    if (frame && frame->use == PageUse::PAGES)
+        return expand_pages(ptr, pages_to_order(new_size));
+
+    return general_heaps[page_node(ptr)].try_expand(ptr, new_size);
+};
+
+// Every entry point below holds heap_lock while it touches shared heap state,
+// so no other thread or CPU sees a half-updated free list. It is a CpuLock as
+// realloc() and calloc() call the other entry points. The trace is kept under
+// it too.
+static CpuLock heap_lock;
+
+// Allocation trace
+#if PRISM_HEAP_TRACE
+constexpr unsigned    TRACE_ORDER    = 9; // 2 MiB ring
+constexpr std::size_t TRACE_CAPACITY = (PAGE_SIZE << TRACE_ORDER) / sizeof(HeapTraceRecord);
+
+// Under heap_lock, like the heap operations they record
+static HeapTraceRecord* trace_ring    = nullptr;
+static std::size_t      trace_next    = 0; // Slot the next record goes to
+static std::uint64_t    trace_written = 0; // Since heap_trace_start(), the ring keeps the newest
+static bool             trace_enabled = false;
+
+static std::uint32_t trace_id(const void* ptr) {
+    return static_cast<std::uint32_t>(reinterpret_cast<std::uintptr_t>(ptr) >> 4);
+};
+
+static void trace(const HeapTraceOp op, const void* ptr, const void* old_ptr,
+                  const std::size_t size, const std::size_t alignment = 0) {
+    if (!trace_enabled)
+        return;
+
+    HeapTraceRecord& record = trace_ring[trace_next];
+    record.timestamp        = cpu::counter();
+    record.id               = trace_id(ptr);
+    record.old_id           = trace_id(old_ptr);
+    record.size             = size > 0xffffffff ? 0xffffffff : static_cast<std::uint32_t>(size);
+    record.align_log2       = alignment ? static_cast<std::uint16_t>(__builtin_ctzll(alignment)) : 0;
+    record.op               = op;
+    record.reserved         = 0;
+
+    if (++trace_next == TRACE_CAPACITY)
+        trace_next = 0;
+
+    trace_written++;
+};
+
+void heap_trace_start() {
+    const CpuLockScope guard(heap_lock);
+    if (!trace_ring) {
+        trace_ring = static_cast<HeapTraceRecord*>(alloc_pages(TRACE_ORDER));
+        if (!trace_ring) {
+            std::println("heap trace: no memory for the ring buffer");
+            return;
+        };
+    };
+
+    trace_next    = 0;
+    trace_written = 0;
+    trace_enabled = true;
+};
+
+void heap_trace_stop() {
+    const CpuLockScope guard(heap_lock);
+    trace_enabled = false;
+};
+
+void heap_trace_dump() {
+    // Stopped under the lock, so no CPU is partway through a record while the
+    // ring is printed without it
+    bool        was_enabled;
+    std::size_t count;
+    std::size_t first;
+    std::size_t dropped;
+    {
+        const CpuLockScope guard(heap_lock);
+        if (!trace_ring) {
+            std::println("heap trace: not started");
+            return;
+        };
+
+        was_enabled   = trace_enabled;
+        trace_enabled = false;
+        count         = trace_written < TRACE_CAPACITY ? trace_written : TRACE_CAPACITY;
+        first         = trace_written < TRACE_CAPACITY ? 0 : trace_next;
+        dropped       = trace_written - count;
+    };
+
+    // One record per line in hex, framed so the host tool can cut it out of a
+    // serial log
+    std::println("PRISM-HEAP-TRACE BEGIN records={} dropped={} frequency={}", count, dropped,
+                 cpu::counter_frequency());
+
+    constexpr char DIGITS[] = "0123456789abcdef";
+    char           line[sizeof(HeapTraceRecord) * 2 + 2];
+    for (std::size_t i = 0; i < count; ++i) {
+        const auto* bytes = reinterpret_cast<const std::uint8_t*>(
+            &trace_ring[(first + i) % TRACE_CAPACITY]
+        );
+
+        for (std::size_t b = 0; b < sizeof(HeapTraceRecord); ++b) {
+            line[2 * b]     = DIGITS[bytes[b] >> 4];
+            line[2 * b + 1] = DIGITS[bytes[b] & 0xf];
+        };
+
+        line[sizeof(line) - 2] = '\n';
+        line[sizeof(line) - 1] = '\0';
+
+        // Whole lines, like println(), so other CPUs' output can't split them
+        const console::LineScope scope;
+        console::put_string(line);
+    };
+
+    std::println("PRISM-HEAP-TRACE END");
+
+    const CpuLockScope guard(heap_lock);
+    trace_enabled = was_enabled;
+};
+#else
+static void trace(HeapTraceOp, const void*, const void*, std::size_t, std::size_t = 0) {};
+
+void heap_trace_start() {};
+void heap_trace_stop() {};
+
+void heap_trace_dump() {
+    std::println("heap trace: not built, configure with -DPRISM_HEAP_TRACE=ON");
+};
+#endif
+
+static void* alloc_recorded(const std::size_t size, const void* caller,
+                           const unsigned node = LOCAL_NODE) {
+    void* ptr = allocate(size, node);
+    record_alloc(ptr, size, caller);
+    return ptr;
+};
+
+static void free_recorded(void* ptr) {
+    const PageFrame* frame = page_frame(ptr);
+    record_free(ptr, usable_size(ptr, frame));
+    release(ptr, frame);
+};
+
+void* heap_alloc(const std::size_t size, const void* caller) {
+    const CpuLockScope guard(heap_lock);
+
+    void* ptr = alloc_recorded(size, caller);
+    trace(HeapTraceOp::MALLOC, ptr, nullptr, size);
+    return ptr;
+};
+
+void* heap_alloc_node(const std::size_t size, const unsigned node, const void* caller) {
+    const CpuLockScope guard(heap_lock);
+
+    void* ptr = alloc_recorded(size, caller, node);
+    trace(HeapTraceOp::MALLOC, ptr, nullptr, size);
+    return ptr;
+};
+
+void* heap_aligned_alloc(const std::size_t alignment, const std::size_t size,
+                         const void* caller) {
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0)
+        return nullptr;
+
+    const CpuLockScope guard(heap_lock);
+    void* ptr = allocate_aligned(alignment, size);
+    record_alloc(ptr, size, caller);
+    trace(HeapTraceOp::ALIGNED_ALLOC, ptr, nullptr, size, alignment);
+    return ptr;
+};
+
+extern "C" void* malloc(const std::size_t size) {
+    return heap_alloc(size, __builtin_return_address(0));
+};
+
+extern "C" void* malloc_node(const std::size_t size, const unsigned node) {
+    return heap_alloc_node(size, node, __builtin_return_address(0));
+};
+
+extern "C" void* calloc(const std::size_t count, const std::size_t size) {
+    std::size_t bytes;
+    if (__builtin_mul_overflow(count, size, &bytes))
+        return nullptr;
+
+    // Below half a page the slab or TLSF block is cheaper than the wasted tail
+    if (bytes > PAGE_SIZE / 2 && bytes <= PAGE_SIZE << MAX_ZEROED_ORDER) {
+        const CpuLockScope guard(heap_lock);
+
+        void* ptr = alloc_zeroed_pages(pages_to_order(bytes));
+        if (!ptr)
+            panic("Out of memory! System halted.");
+
+        record_alloc(ptr, bytes, __builtin_return_address(0));
+        trace(HeapTraceOp::MALLOC, ptr, nullptr, bytes);
+        return ptr;
+    };
+
+    void* ptr = heap_alloc(bytes, __builtin_return_address(0));
+    memset(ptr, 0, bytes);
+    return ptr;
+};
+
+extern "C" void* aligned_alloc(const std::size_t alignment, const std::size_t size) {
+    return heap_aligned_alloc(alignment, size, __builtin_return_address(0));
 };
 
 extern "C" void free(void* ptr) {
     if (ptr == nullptr)
         return;
 
-    FreeBlock* block = static_cast<FreeBlock*>(ptr) - 1;
+    const CpuLockScope guard(heap_lock);
 
-    // Simple LIFO insertion (No coalescing)
-    block->next = free_list;
-    free_list   = block;
+    trace(HeapTraceOp::FREE, ptr, nullptr, 0);
+    free_recorded(ptr);
+};
+
+extern "C" bool try_expand(void* ptr, const std::size_t new_size) {
+    if (ptr == nullptr)
+        return false;
+
+    const CpuLockScope guard(heap_lock);
+
+    const PageFrame*  frame     = page_frame(ptr);
+    const std::size_t old_bytes = usable_size(ptr, frame);
+    if (new_size <= old_bytes)
+        return true;
+
+    if (!expand(ptr, frame, new_size))
+        return false;
+
+    record_resize(ptr, old_bytes);
+    trace(HeapTraceOp::REALLOC, ptr, ptr, new_size);
+    return true;
 };
 
 extern "C" void* realloc(void* ptr, const std::size_t size) {
+    const CpuLockScope guard(heap_lock);
+
     if (ptr == nullptr)
-        return malloc(size);
+        return heap_alloc(size, __builtin_return_address(0));
 
     if (size == 0) {
         free(ptr);
         return nullptr;
     };
 
-    const FreeBlock* block = get_block(ptr);
+    const PageFrame*  frame            = page_frame(ptr);
+    const std::size_t old_payload_size = usable_size(ptr, frame);
+
+    // If it fits, give the unused tail back and keep the pointer
+    if (size <= old_payload_size) {
+        if (is_general(frame)) {
+            general_heaps[page_node(ptr)].shrink(ptr, size);
+            record_resize(ptr, old_payload_size);
+        };
 
-    // Calculate actual payload capacity
-    const std::size_t old_total_size   = block->size;
-    const std::size_t old_payload_size = old_total_size - sizeof(FreeBlock);
+        trace(HeapTraceOp::REALLOC, ptr, ptr, size);
+        return ptr;
+    };
 
-    // If it fits, return existing pointer
-    if (size <= old_payload_size)
-        return ptr; // fits in place
+    // Grow in place when the neighbouring memory is free
+    if (expand(ptr, frame, size)) {
+        record_resize(ptr, old_payload_size);
+        trace(HeapTraceOp::REALLOC, ptr, ptr, size);
+        return ptr;
+    };
 
     // Need new block
-    void* new_ptr = malloc(size);
+    void* new_ptr = alloc_recorded(size, __builtin_return_address(0));
     if (!new_ptr)
         return nullptr; // out of memory
 
     // copy old contents
     memcpy(new_ptr, ptr, old_payload_size);
 
-    free(ptr);
+    free_recorded(ptr);
+    trace(HeapTraceOp::REALLOC, new_ptr, ptr, size);
     return new_ptr;
-};
\ No newline at end of file
+};
+
+void heap_get_stats(HeapStats& out) {
+    const CpuLockScope guard(heap_lock);
+
+    out.live_bytes      = live_bytes;
+    out.peak_live_bytes = peak_live_bytes;
+    out.alloc_count     = alloc_count;
+    out.free_count      = free_count;
+    for (std::size_t i = 0; i < HEAP_HISTOGRAM_BUCKETS; ++i)
+        out.size_histogram[i] = size_histogram[i];
+
+    out.free_blocks        = 0;
+    out.free_block_bytes   = 0;
+    out.largest_free_block = 0;
+    for (const Tlsf& heap : general_heaps) {
+        out.free_blocks      += heap.free_blocks();
+        out.free_block_bytes += heap.free_bytes();
+        if (heap.largest_free_block() > out.largest_free_block)
+            out.largest_free_block = heap.largest_free_block();
+    };
+
+    out.free_pages         = free_pages_count();
+    out.largest_free_pages = largest_free_pages();
+};
+
+void heap_dump_stats() {
+    HeapStats stats{};
+    heap_get_stats(stats);
+
+    std::println("--- Heap Stats ---");
+    std::println("Live:           {} KB (peak {} KB)", stats.live_bytes / 1024,
+                 stats.peak_live_bytes / 1024);
+    std::println("Calls:          {} allocs, {} frees", stats.alloc_count, stats.free_count);
+    std::println("TLSF free:      {} blocks, {} KB", stats.free_blocks,
+                 stats.free_block_bytes / 1024);
+    std::println("TLSF largest:   {} KB", stats.largest_free_block / 1024);
+    std::println("Free pages:     {} (largest block {} pages)", stats.free_pages,
+                 stats.largest_free_pages);
+    std::println("Zeroed pool:    {} blocks", zeroed_pool_count());
+
+    if (node_count() > 1) {
+        for (unsigned node = 0; node < node_count(); ++node) {
+            std::println("  node {}:       {} of {} pages free, TLSF {} KB free", node,
+                         node_free_pages(node), node_total_pages(node),
+                         general_heaps[node].free_bytes() / 1024);
+        };
+    };
+
+    std::println("Request sizes:");
+    for (std::size_t i = 0; i < HEAP_HISTOGRAM_BUCKETS; ++i) {
+        if (stats.size_histogram[i])
+            std::println("  >= {}: {}", static_cast<std::size_t>(1) << i, stats.size_histogram[i]);
+    };
+
+#if PRISM_HEAP_TRACK_SITES
+    std::println("Live allocation sites:");
+    for (const SiteEntry& site : sites) {
+        if (site.live_count) {
+            std::println("  {}: {} live, {} bytes ({} total)", const_cast<void*>(site.site),
+                         site.live_count, site.live_bytes, site.total_count);
+        };
+    };
+
+    if (untracked_count)
+        std::println("  ({} allocations not tracked)", untracked_count);
+#endif
+
+    std::println("------------------");
+};
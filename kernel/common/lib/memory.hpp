@@ -1,18 +1,95 @@
 #pragma once
 #include <common/std/stdint.hpp>
 
-extern "C" void set_heap(std::uint64_t mem_base, std::uint64_t mem_size);
+// Hands a RAM range to the allocator, called once per FDT memory region.
+// Anything below the end of the kernel image is skipped.
+extern "C" void set_heap(std::uint64_t mem_base, std::uint64_t mem_size, unsigned node = 0);
 
 extern "C" std::size_t total_heap_size();
 extern "C" std::size_t used_heap();
 extern "C" std::size_t free_heap();
 
+constexpr std::size_t HEAP_HISTOGRAM_BUCKETS = 32;
+
+struct HeapStats {
+    std::size_t live_bytes; // Usable bytes handed out and not yet freed
+    std::size_t peak_live_bytes;
+    std::size_t alloc_count;
+    std::size_t free_count;
+    std::size_t size_histogram[HEAP_HISTOGRAM_BUCKETS]; // Requests by floor(log2(size))
+
+    // Fragmentation
+    std::size_t free_blocks; // Length of the TLSF free lists
+    std::size_t free_block_bytes;
+    std::size_t largest_free_block;
+    std::size_t free_pages;
+    std::size_t largest_free_pages;
+};
+
+void heap_get_stats(HeapStats& out);
+
+// Prints the stats (and the live allocation sites when built with
+// PRISM_HEAP_TRACK_SITES) to the console
+void heap_dump_stats();
+
+// Allocation trace, built with PRISM_HEAP_TRACE. Every malloc/free/realloc is
+// logged to a ring buffer; heap_trace_dump() prints it for tools/alloc_replay.
+enum class HeapTraceOp : std::uint8_t {
+    MALLOC = 1,
+    FREE,
+    REALLOC, // id is the new pointer, old_id the one passed in
+    ALIGNED_ALLOC,
+};
+
+// Layout is shared with tools/alloc_replay, keep them in sync
+struct HeapTraceRecord {
+    std::uint64_t timestamp; // CNTVCT
+    std::uint32_t id;        // Pointer >> 4
+    std::uint32_t old_id;
+    std::uint32_t size; // Requested size
+    std::uint16_t align_log2;
+    HeapTraceOp   op;
+    std::uint8_t  reserved;
+};
+
+static_assert(sizeof(HeapTraceRecord) == 24);
+
+// Starting clears the ring
+void heap_trace_start();
+void heap_trace_stop();
+void heap_trace_dump();
+
+// malloc/aligned_alloc charging the allocation to caller instead of the
+// immediate return address; used by operator new
+void* heap_alloc(std::size_t size, const void* caller);
+void* heap_aligned_alloc(std::size_t alignment, std::size_t size, const void* caller);
+void* heap_alloc_node(std::size_t size, unsigned node, const void* caller);
+
 extern "C" void* malloc(std::size_t size);
 extern "C" void  free(void* ptr);
 extern "C" void* realloc(void* ptr, std::size_t size);
 
+// Zero-filled count * size bytes, nullptr on overflow. Requests between half a
+// page and the largest pre-zeroed block take whole pages from the zeroed pool.
+extern "C" void* calloc(std::size_t count, std::size_t size);
+
+// malloc preferring memory on node (LOCAL_NODE for the calling CPU's node),
+// falling back to the nearest node with room. Freed with free().
+extern "C" void* malloc_node(std::size_t size, unsigned node);
+
+// Grows the allocation at ptr to at least new_size bytes without moving it.
+// Returns false if the neighbouring memory is not free; ptr is left untouched.
+extern "C" bool try_expand(void* ptr, std::size_t new_size);
+
+// alignment must be a power of two; small sizes come from a slab class with that
+// alignment, anything else from a naturally aligned page block
+extern "C" void* aligned_alloc(std::size_t alignment, std::size_t size);
+
+// NEON implementations in arch/aarch64/memory.s
 extern "C" void* memset(void* dest, int c, std::size_t n);
 extern "C" void* memcpy(void* dest, const void* src, std::size_t n);
+extern "C" void* memmove(void* dest, const void* src, std::size_t n);
+extern "C" int   memcmp(const void* a, const void* b, std::size_t n);
 
 namespace std {
     inline void* memset(void* dest, const int c, const std::size_t n) {
@@ -22,4 +99,12 @@ namespace std {
     inline void* memcpy(void* dest, const void* src, const std::size_t n) {
         return __builtin_memcpy(dest, src, n);
     };
+
+    inline void* memmove(void* dest, const void* src, const std::size_t n) {
+        return __builtin_memmove(dest, src, n);
+    };
+
+    inline int memcmp(const void* a, const void* b, const std::size_t n) {
+        return __builtin_memcmp(a, b, n);
+    };
 }; // namespace std
\ No newline at end of file
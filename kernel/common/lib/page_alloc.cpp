@@ -0,0 +1,411 @@
+#include "page_alloc.hpp"
+#include "memory.hpp"
+#include "thread.hpp"
+
+constexpr std::size_t MAX_ZONES = 8;
+
+// A contiguous physical range with its own frame table and buddy free lists.
+// A node owns one or more zones.
+struct Zone {
+    std::uintptr_t base_pfn;
+    std::uintptr_t end_pfn;
+    PageFrame*     frames;
+    PageFrame*     free_lists[MAX_PAGE_ORDER + 1];
+    std::size_t    free_pages;
+    std::size_t    total_pages;
+    unsigned       node;
+};
+
+static Zone        zones[MAX_ZONES];
+static std::size_t zone_count  = 0;
+static std::size_t total_count = 0;
+
+static unsigned     node_limit    = 0; // One past the highest node with a zone
+static std::uint8_t node_mask     = 0; // Bit n set once node n has a zone
+static std::uint8_t distances[MAX_NODES][MAX_NODES];
+static bool         have_distance = false;
+
+static_assert(MAX_NODES <= 8, "node_mask has a bit per node");
+
+// Each CPU's local node, set by the CPU itself
+static unsigned cpu_nodes[cpu::MAX_CPUS];
+
+CpuLock page_lock;
+
+// Nesting depth of calls that modify the free lists, only changed by the CPU
+// holding page_lock. The fences keep the compiler from moving free list updates
+// outside the scope, a fault handler can observe it between any two
+// instructions. page_lock keeps preemption off meanwhile, so the count only
+// ever reflects the running thread.
+static unsigned in_use = 0;
+
+struct InUseScope {
+    const CpuLockScope guard{page_lock};
+
+    InUseScope() {
+        in_use++;
+        __atomic_signal_fence(__ATOMIC_SEQ_CST);
+    };
+
+    ~InUseScope() {
+        __atomic_signal_fence(__ATOMIC_SEQ_CST);
+        in_use--;
+    };
+};
+
+// Nodes in the order allocations for a node fall back to: itself, then the
+// others by increasing distance
+static std::uint8_t fallback[MAX_NODES][MAX_NODES];
+
+static unsigned distance(const unsigned from, const unsigned to) {
+    if (have_distance && distances[from][to])
+        return distances[from][to];
+
+    return from == to ? 10 : 20;
+};
+
+static void build_fallback() {
+    for (unsigned node = 0; node < MAX_NODES; ++node) {
+        std::uint8_t* order = fallback[node];
+        for (unsigned i = 0; i < MAX_NODES; ++i) order[i] = static_cast<std::uint8_t>(i);
+
+        // Insertion sort, stable so equal distances keep the node order
+        for (unsigned i = 1; i < MAX_NODES; ++i) {
+            const std::uint8_t candidate = order[i];
+            const unsigned     key       = candidate == node ? 0 : distance(node, candidate);
+
+            unsigned j = i;
+            for (; j > 0; --j) {
+                const unsigned other = order[j - 1] == node ? 0 : distance(node, order[j - 1]);
+                if (other <= key)
+                    break;
+
+                order[j] = order[j - 1];
+            };
+
+            order[j] = candidate;
+        };
+    };
+};
+
+static std::uintptr_t frame_pfn(const Zone& zone, const PageFrame* frame) {
+    return zone.base_pfn + (frame - zone.frames);
+};
+
+static void push_free(Zone& zone, PageFrame* frame, const unsigned order) {
+    PageFrame*& head = zone.free_lists[order];
+
+    frame->use   = PageUse::FREE;
+    frame->order = order;
+    frame->prev  = nullptr;
+    frame->next  = head;
+    if (head)
+        head->prev = frame;
+
+    head             = frame;
+    zone.free_pages += static_cast<std::size_t>(1) << order;
+};
+
+static void unlink_free(Zone& zone, PageFrame* frame) {
+    if (frame->prev)
+        frame->prev->next = frame->next;
+    else
+        zone.free_lists[frame->order] = frame->next;
+
+    if (frame->next)
+        frame->next->prev = frame->prev;
+
+    frame->use       = PageUse::NONE;
+    zone.free_pages -= static_cast<std::size_t>(1) << frame->order;
+};
+
+// Splits [pfn, end) into the largest naturally aligned blocks
+static void add_free_range(Zone& zone, std::uintptr_t pfn, const std::uintptr_t end) {
+    while (pfn < end) {
+        unsigned order = __builtin_ctzll(pfn);
+        if (order > MAX_PAGE_ORDER)
+            order = MAX_PAGE_ORDER;
+
+        while (pfn + (static_cast<std::uintptr_t>(1) << order) > end) --order;
+
+        push_free(zone, &zone.frames[pfn - zone.base_pfn], order);
+        pfn += static_cast<std::uintptr_t>(1) << order;
+    };
+};
+
+static Zone* zone_of(const std::uintptr_t pfn) {
+    for (std::size_t i = 0; i < zone_count; ++i) {
+        if (pfn >= zones[i].base_pfn && pfn < zones[i].end_pfn)
+            return &zones[i];
+    };
+
+    return nullptr;
+};
+
+static void* alloc_from_zone(Zone& zone, const unsigned order) {
+    unsigned current = order;
+    while (current <= MAX_PAGE_ORDER && !zone.free_lists[current]) ++current;
+
+    if (current > MAX_PAGE_ORDER)
+        return nullptr;
+
+    PageFrame* frame = zone.free_lists[current];
+    unlink_free(zone, frame);
+
+    // Give the upper halves back until the block has the requested size
+    while (current > order) {
+        --current;
+        push_free(zone, frame + (static_cast<std::size_t>(1) << current), current);
+    };
+
+    frame->use   = PageUse::PAGES;
+    frame->order = order;
+    return reinterpret_cast<void*>(frame_pfn(zone, frame) << PAGE_SHIFT);
+};
+
+void page_alloc_add_range(const std::uintptr_t base, const std::size_t size, unsigned node) {
+    if (node >= MAX_NODES)
+        node = 0;
+
+    const std::uintptr_t start = (base + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    const std::uintptr_t end   = (base + size) & ~(PAGE_SIZE - 1);
+    if (end <= start || zone_count == MAX_ZONES)
+        return;
+
+    const std::size_t pages       = (end - start) >> PAGE_SHIFT;
+    const std::size_t table_bytes = pages * sizeof(PageFrame);
+    const std::size_t table_pages = (table_bytes + PAGE_SIZE - 1) >> PAGE_SHIFT;
+    if (table_pages >= pages)
+        return;
+
+    if (zone_count == 0)
+        build_fallback();
+
+    Zone& zone    = zones[zone_count++];
+    zone.base_pfn = start >> PAGE_SHIFT;
+    zone.end_pfn  = end >> PAGE_SHIFT;
+    zone.frames   = reinterpret_cast<PageFrame*>(start);
+    zone.node     = node;
+    memset(zone.frames, 0, table_bytes);
+
+    for (std::size_t i = 0; i < table_pages; ++i) zone.frames[i].use = PageUse::RESERVED;
+
+    add_free_range(zone, zone.base_pfn + table_pages, zone.end_pfn);
+    zone.total_pages  = pages - table_pages;
+    total_count      += zone.total_pages;
+
+    node_mask |= 1u << node;
+    if (node >= node_limit)
+        node_limit = node + 1;
+};
+
+void page_alloc_set_distance(const unsigned from, const unsigned to, const unsigned distance) {
+    if (from >= MAX_NODES || to >= MAX_NODES)
+        return;
+
+    distances[from][to] = static_cast<std::uint8_t>(distance > 255 ? 255 : distance);
+    have_distance       = true;
+    build_fallback();
+};
+
+void set_local_node(const unsigned node) {
+    cpu_nodes[cpu::id()] = node < MAX_NODES ? node : 0;
+};
+
+unsigned local_node() {
+    return cpu_nodes[cpu::id()];
+};
+
+unsigned fallback_node(unsigned node, const unsigned i) {
+    if (node >= MAX_NODES)
+        node = local_node();
+
+    // Nodes without memory are skipped
+    unsigned index = 0;
+    for (const std::uint8_t candidate : fallback[node]) {
+        if ((node_mask >> candidate & 1) && index++ == i)
+            return candidate;
+    };
+
+    return MAX_NODES;
+};
+
+void* alloc_pages_on(const unsigned order, const unsigned node) {
+    if (order > MAX_PAGE_ORDER)
+        return nullptr;
+
+    const InUseScope scope;
+
+    // Zones are few, a linear scan is fine
+    for (std::size_t i = 0; i < zone_count; ++i) {
+        if (zones[i].node != node)
+            continue;
+
+        if (void* ptr = alloc_from_zone(zones[i], order))
+            return ptr;
+    };
+
+    return nullptr;
+};
+
+static void* alloc_by_distance(const unsigned order, const unsigned node) {
+    unsigned target;
+    for (unsigned i = 0; (target = fallback_node(node, i)) < MAX_NODES; ++i) {
+        if (void* ptr = alloc_pages_on(order, target))
+            return ptr;
+    };
+
+    return nullptr;
+};
+
+extern "C" void* alloc_pages_node(const unsigned order, const unsigned node) {
+    if (void* ptr = alloc_by_distance(order, node))
+        return ptr;
+
+    // Blocks waiting in the zeroed pools are free memory too
+    return drain_zeroed_pools() ? alloc_by_distance(order, node) : nullptr;
+};
+
+extern "C" void* alloc_pages(const unsigned order) {
+    return alloc_pages_node(order, local_node());
+};
+
+extern "C" void free_pages(void* ptr) {
+    std::uintptr_t pfn  = reinterpret_cast<std::uintptr_t>(ptr) >> PAGE_SHIFT;
+    Zone*          zone = zone_of(pfn);
+    if (!zone)
+        return;
+
+    // Checked under the lock, so a double free racing another free is caught
+    const InUseScope scope;
+
+    PageFrame* frame = &zone->frames[pfn - zone->base_pfn];
+    if (frame->use == PageUse::NONE || frame->use == PageUse::FREE ||
+        frame->use == PageUse::RESERVED)
+        return; // Not the start of an allocated block
+
+    unsigned order = frame->order;
+    frame->use     = PageUse::NONE;
+
+    // Merge with the buddy for as long as it is a free block of the same order
+    while (order < MAX_PAGE_ORDER) {
+        const std::uintptr_t buddy_pfn = pfn ^ (static_cast<std::uintptr_t>(1) << order);
+        if (buddy_pfn < zone->base_pfn || buddy_pfn >= zone->end_pfn)
+            break;
+
+        PageFrame* buddy = &zone->frames[buddy_pfn - zone->base_pfn];
+        if (buddy->use != PageUse::FREE || buddy->order != order)
+            break;
+
+        unlink_free(*zone, buddy);
+        pfn &= ~(static_cast<std::uintptr_t>(1) << order);
+        ++order;
+    };
+
+    push_free(*zone, &zone->frames[pfn - zone->base_pfn], order);
+};
+
+bool expand_pages(void* ptr, const unsigned order) {
+    const std::uintptr_t pfn  = reinterpret_cast<std::uintptr_t>(ptr) >> PAGE_SHIFT;
+    Zone*                zone = zone_of(pfn);
+    if (!zone || order > MAX_PAGE_ORDER)
+        return false;
+
+    // The buddies are checked and taken in one go, another CPU or the zeroing
+    // thread could take or merge them in between
+    const InUseScope scope;
+
+    PageFrame* frame = &zone->frames[pfn - zone->base_pfn];
+    if (frame->order >= order)
+        return true;
+
+    // Check every level first so a failure leaves the free lists untouched
+    for (unsigned current = frame->order; current < order; ++current) {
+        const std::uintptr_t buddy_pfn = pfn + (static_cast<std::uintptr_t>(1) << current);
+        if ((pfn >> current) & 1 || buddy_pfn >= zone->end_pfn)
+            return false;
+
+        const PageFrame* buddy = &zone->frames[buddy_pfn - zone->base_pfn];
+        if (buddy->use != PageUse::FREE || buddy->order != current)
+            return false;
+    };
+
+    for (unsigned current = frame->order; current < order; ++current)
+        unlink_free(*zone, frame + (static_cast<std::size_t>(1) << current));
+
+    frame->order = order;
+    return true;
+};
+
+PageFrame* page_frame(const void* ptr) {
+    const std::uintptr_t pfn  = reinterpret_cast<std::uintptr_t>(ptr) >> PAGE_SHIFT;
+    Zone*                zone = zone_of(pfn);
+    return zone ? &zone->frames[pfn - zone->base_pfn] : nullptr;
+};
+
+bool page_alloc_in_use() {
+    // Another CPU's call makes this one wait for page_lock, not fail
+    return page_lock.held() && in_use != 0;
+};
+
+unsigned page_node(const void* ptr) {
+    const Zone* zone = zone_of(reinterpret_cast<std::uintptr_t>(ptr) >> PAGE_SHIFT);
+    return zone ? zone->node : 0;
+};
+
+unsigned pages_to_order(const std::size_t bytes) {
+    const std::size_t pages = (bytes + PAGE_SIZE - 1) >> PAGE_SHIFT;
+    return pages <= 1 ? 0 : 64 - __builtin_clzll(pages - 1);
+};
+
+std::size_t total_pages() {
+    return total_count;
+};
+
+std::size_t free_pages_count() {
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < zone_count; ++i) count += zones[i].free_pages;
+
+    return count;
+};
+
+std::size_t largest_free_pages() {
+    std::size_t largest = 0;
+    for (std::size_t i = 0; i < zone_count; ++i) {
+        for (int order = MAX_PAGE_ORDER; order >= 0; --order) {
+            if (zones[i].free_lists[order]) {
+                const std::size_t pages = static_cast<std::size_t>(1) << order;
+                if (pages > largest)
+                    largest = pages;
+
+                break;
+            };
+        };
+    };
+
+    return largest;
+};
+
+unsigned node_count() {
+    return node_limit;
+};
+
+std::size_t node_total_pages(const unsigned node) {
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < zone_count; ++i) {
+        if (zones[i].node == node)
+            count += zones[i].total_pages;
+    };
+
+    return count;
+};
+
+std::size_t node_free_pages(const unsigned node) {
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < zone_count; ++i) {
+        if (zones[i].node == node)
+            count += zones[i].free_pages;
+    };
+
+    return count;
+};
@@ -0,0 +1,114 @@
+#pragma once
+#include <common/lib/spinlock.hpp>
+#include <common/std/stdint.hpp>
+
+constexpr std::size_t PAGE_SHIFT     = 12;
+constexpr std::size_t PAGE_SIZE      = 1 << PAGE_SHIFT;
+constexpr unsigned    MAX_PAGE_ORDER = 18; // Largest block: 2^18 pages (1 GiB)
+
+// NUMA nodes, numbered as in the FDT numa-node-id properties
+constexpr unsigned MAX_NODES  = 8;
+constexpr unsigned LOCAL_NODE = ~0u; // Node hint meaning "the node of the calling CPU"
+
+// What a page frame is currently used for. Only the first frame of a block
+// carries its use, frames inside a block stay NONE.
+enum class PageUse : std::uint8_t {
+    NONE,     // Inside a larger block
+    FREE,     // First page of a free buddy block
+    RESERVED, // Page frame table
+    PAGES,    // Returned by alloc_pages()
+    SLAB,     // Slab page (see slab.hpp)
+    HEAP,     // TLSF pool (see tlsf.hpp)
+};
+
+// One descriptor per physical page
+struct PageFrame {
+    PageFrame*   next; // Free list links, only valid while FREE
+    PageFrame*   prev;
+    std::uint8_t order; // Block order while FREE or allocated
+    PageUse      use;
+};
+
+// Hands a physical memory range belonging to node to the buddy allocator. The
+// frame table for the range is carved from its start, so it is node-local too.
+void page_alloc_add_range(std::uintptr_t base, std::size_t size, unsigned node = 0);
+
+// Relative cost of node from reaching memory on node to, as in the FDT
+// distance-map (10 = local). Nodes without an entry are 20 apart.
+void page_alloc_set_distance(unsigned from, unsigned to, unsigned distance);
+
+// The calling CPU's node, whose memory alloc_pages() and LOCAL_NODE hints
+// prefer. Each CPU sets its own once it is up, 0 until then.
+void     set_local_node(unsigned node);
+unsigned local_node();
+
+// Returns 2^order physically contiguous pages aligned to their size, nullptr
+// if no block is available. Memory comes from the local node first, then from
+// the other nodes by increasing distance.
+extern "C" void* alloc_pages(unsigned order);
+
+// Like alloc_pages(), but starting from node (or the local node for LOCAL_NODE)
+extern "C" void* alloc_pages_node(unsigned order, unsigned node);
+
+// Only takes memory from node, no fallback
+void* alloc_pages_on(unsigned order, unsigned node);
+
+// The i-th node with memory in the fallback order of node (node itself first),
+// MAX_NODES past the last one
+unsigned fallback_node(unsigned node, unsigned i);
+
+// ptr must have been returned by alloc_pages
+extern "C" void free_pages(void* ptr);
+
+// Pre-zeroed pages (zeroed_pages.cpp). Blocks up to MAX_ZEROED_ORDER come from
+// per-node pools that a background thread refills while the system is idle.
+constexpr unsigned    MAX_ZEROED_ORDER = 1;
+constexpr std::size_t ZEROED_POOL_SIZE = 32; // Blocks kept per node and order
+
+// Like alloc_pages_node(), but the block is zero-filled. Larger orders, or an
+// empty pool, are cleared inline. Freed with free_pages().
+extern "C" void* alloc_zeroed_pages(unsigned order, unsigned node = LOCAL_NODE);
+
+// Starts the zeroing thread. Needs a current thread, as it is scheduled
+// alongside the others.
+void start_page_zeroing();
+
+// Blocks waiting in the pools, summed over nodes and orders
+std::size_t zeroed_pool_count();
+
+// Hands every pooled block back to the buddy allocator, for a last try before
+// an allocation reports out of memory. False if the pools were empty.
+bool drain_zeroed_pools();
+
+// Grows an allocated block in place to 2^order pages by absorbing the free
+// buddies above it. Fails if ptr is not the lower half at every level.
+bool expand_pages(void* ptr, unsigned order);
+
+// Frame describing the page ptr lives in, nullptr for unmanaged memory
+PageFrame* page_frame(const void* ptr);
+
+// Serializes the page allocator, the zeroed pools, stack slots and page tables
+// across CPUs. One lock, as a stack fault can nest any of them inside another
+// on the same CPU.
+extern CpuLock page_lock;
+
+// True while a page allocator call is in progress on this CPU. A fault handler
+// that interrupted one must not allocate.
+bool page_alloc_in_use();
+
+// Node the page at ptr belongs to, 0 for unmanaged memory
+unsigned page_node(const void* ptr);
+
+// Smallest order whose block holds bytes
+unsigned pages_to_order(std::size_t bytes);
+
+std::size_t total_pages();
+std::size_t free_pages_count();
+
+// One past the highest node that has memory
+unsigned    node_count();
+std::size_t node_total_pages(unsigned node);
+std::size_t node_free_pages(unsigned node);
+
+// Size of the biggest free block in pages, 0 if none
+std::size_t largest_free_pages();
@@ -0,0 +1,217 @@
+#include "parallel.hpp"
+#include "common/cppruntime_support.hpp" // For panic()
+
+struct ParallelJob;
+
+// The ReadyNode comes first, so the executor's node is the helper
+struct Helper {
+    ReadyNode    node;
+    ParallelJob* job;
+    unsigned     participant;
+};
+
+// On the heap: a helper still queued when the caller is done holds a reference
+struct ParallelJob {
+    Helper        helpers[PARALLEL_MAX_PARTICIPANTS - 1];
+    ChunkFunction fn;
+    void*         body;
+    std::size_t   end;
+    std::size_t   grain;
+    std::size_t   next;      // First element nobody claimed yet
+    std::size_t   chunks;    // In all
+    std::size_t   completed; // Chunks run
+    unsigned      refs;      // The caller and each posted helper
+    WaitQueue     done;      // The caller, until completed reaches chunks
+};
+
+// Claims and runs chunks until none are left. True if it ran the last one
+// to complete.
+static bool run_chunks(ParallelJob& job, const unsigned participant) {
+    bool last = false;
+    while (true) {
+        const std::size_t lo = __atomic_fetch_add(&job.next, job.grain, __ATOMIC_RELAXED);
+        if (lo >= job.end)
+            break;
+
+        const std::size_t hi = job.end - lo > job.grain ? lo + job.grain : job.end;
+        job.fn(job.body, lo, hi, participant);
+
+        if (__atomic_add_fetch(&job.completed, 1, __ATOMIC_ACQ_REL) == job.chunks)
+            last = true;
+    };
+
+    return last;
+};
+
+static void release(ParallelJob* job) {
+    if (__atomic_sub_fetch(&job->refs, 1, __ATOMIC_ACQ_REL) == 0)
+        delete job;
+};
+
+// Started late, a helper finds every chunk claimed and only drops its reference
+static void run_helper(ReadyNode* node) {
+    Helper*      helper = reinterpret_cast<Helper*>(node);
+    ParallelJob* job    = helper->job;
+    if (run_chunks(*job, helper->participant))
+        wake_all(job->done);
+
+    release(job);
+};
+
+std::size_t parallel_grain(const std::size_t count) {
+    std::size_t participants = executor_threads() + 1;
+    if (participants > PARALLEL_MAX_PARTICIPANTS)
+        participants = PARALLEL_MAX_PARTICIPANTS;
+
+    const std::size_t grain = count / (participants * 4);
+    return grain ? grain : 1;
+};
+
+void parallel_run(const std::size_t begin, const std::size_t end, std::size_t grain,
+                  const ChunkFunction fn, void* body) {
+    if (begin >= end)
+        return;
+
+    const std::size_t count = end - begin;
+    if (!grain)
+        grain = parallel_grain(count);
+
+    const std::size_t chunks  = (count + grain - 1) / grain;
+    std::size_t       helpers = executor_threads();
+    if (helpers > PARALLEL_MAX_PARTICIPANTS - 1)
+        helpers = PARALLEL_MAX_PARTICIPANTS - 1;
+    if (helpers > chunks - 1)
+        helpers = chunks - 1;
+
+    // One chunk, or nobody to share with
+    if (!helpers) {
+        fn(body, begin, end, 0);
+        return;
+    };
+
+    auto* job   = new ParallelJob{};
+    job->fn     = fn;
+    job->body   = body;
+    job->end    = end;
+    job->grain  = grain;
+    job->next   = begin;
+    job->chunks = chunks;
+    job->refs   = helpers + 1;
+
+    for (std::size_t i = 0; i < helpers; ++i) {
+        Helper& helper       = job->helpers[i];
+        helper.node.function = run_helper;
+        helper.job           = job;
+        helper.participant   = i + 1;
+        executor_post(&helper.node);
+    };
+
+    run_chunks(*job, 0);
+
+    // Chunks the helpers claimed may still be running
+    {
+        const IrqSpinLockScope guard(job->done.lock);
+        while (__atomic_load_n(&job->completed, __ATOMIC_ACQUIRE) != chunks) {
+            block_on(job->done);
+        };
+    };
+
+    release(job);
+};
+
+struct Edge {
+    TaskGraph::Node* to;
+    Edge*            next;
+};
+
+// The ReadyNode comes first, so the executor's node is the graph node
+struct TaskGraph::Node {
+    ReadyNode  ready;
+    TaskGraph* graph;
+    void (*invoke)(void* callable);
+    void (*destroy)(void* callable);
+    void*    callable;
+    Edge*    successors;
+    unsigned predecessors;
+    unsigned pending; // Predecessors yet to finish in this run
+    Node*    next;    // In the graph's list of nodes
+};
+
+TaskGraph::~TaskGraph() {
+    while (Node* node = m_nodes) {
+        m_nodes = node->next;
+        while (Edge* edge = node->successors) {
+            node->successors = edge->next;
+            delete edge;
+        };
+
+        node->destroy(node->callable);
+        delete node;
+    };
+};
+
+TaskGraph::Node* TaskGraph::add_node(void (*invoke)(void*), void* callable,
+                                     void (*destroy)(void*)) {
+    auto* node           = new Node{};
+    node->ready.function = run_node;
+    node->graph          = this;
+    node->invoke         = invoke;
+    node->destroy        = destroy;
+    node->callable       = callable;
+    node->next           = m_nodes;
+    m_nodes              = node;
+    m_count++;
+    return node;
+};
+
+void TaskGraph::precede(Node* before, Node* after) {
+    before->successors = new Edge{after, before->successors};
+    after->predecessors++;
+};
+
+void TaskGraph::run_node(ReadyNode* ready) {
+    Node*      node  = reinterpret_cast<Node*>(ready);
+    TaskGraph& graph = *node->graph;
+    node->invoke(node->callable);
+
+    for (const Edge* edge = node->successors; edge; edge = edge->next) {
+        if (__atomic_sub_fetch(&edge->to->pending, 1, __ATOMIC_ACQ_REL) == 0)
+            executor_post(&edge->to->ready);
+    };
+
+    // The caller of run() may return as soon as the count is 0
+    if (__atomic_sub_fetch(&graph.m_remaining, 1, __ATOMIC_ACQ_REL) == 0) {
+        wake_all(graph.m_done);
+        __atomic_store_n(&graph.m_released, true, __ATOMIC_RELEASE);
+    };
+};
+
+void TaskGraph::run() {
+    if (!m_count)
+        return;
+
+    if (!executor_threads())
+        panic("TaskGraph: no executor threads to run on");
+
+    m_remaining = m_count;
+    m_released  = false;
+    for (Node* node = m_nodes; node; node = node->next) node->pending = node->predecessors;
+
+    // Only once every count is set, the first nodes may finish right away
+    for (Node* node = m_nodes; node; node = node->next) {
+        if (!node->predecessors)
+            executor_post(&node->ready);
+    };
+
+    {
+        const IrqSpinLockScope guard(m_done.lock);
+        while (__atomic_load_n(&m_remaining, __ATOMIC_ACQUIRE)) {
+            block_on(m_done);
+        };
+    };
+
+    // Woken before wake_all() has let go of m_done
+    while (!__atomic_load_n(&m_released, __ATOMIC_ACQUIRE)) {
+        cpu::relax();
+    };
+};
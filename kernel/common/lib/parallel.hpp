@@ -0,0 +1,122 @@
+#pragma once
+#include "common/lib/task.hpp"
+#include "common/std/stdint.hpp"
+#include "common/std/utility.hpp"
+
+#include <arch/aarch64/cpu.hpp>
+
+// Data-parallel loops and dependency graphs on the executor threads
+// (common/lib/task.hpp). A loop's calling thread takes chunks too, so it
+// finishes even when every executor thread is busy, or none was started.
+
+// The calling thread and up to MAX_CPUS - 1 executor threads: more threads
+// than CPUs only add switches
+constexpr unsigned PARALLEL_MAX_PARTICIPANTS = cpu::MAX_CPUS;
+
+// Runs body over elements begin..end-1 of a chunk. participant is 0 on the
+// calling thread and unique to each thread taking part.
+using ChunkFunction = void (*)(void* body, std::size_t begin, std::size_t end,
+                               unsigned participant);
+
+// The engine under parallel_for() and parallel_reduce(): splits [begin, end)
+// into chunks of grain elements, which the participants claim one at a time
+// until none are left. Returns once every chunk has run.
+void parallel_run(std::size_t begin, std::size_t end, std::size_t grain, ChunkFunction fn,
+                  void* body);
+
+// A grain that gives each participant about four chunks, so a slow one can be
+// made up for by the others
+std::size_t parallel_grain(std::size_t count);
+
+// Calls body(lo, hi) for consecutive chunks of [begin, end), each grain
+// elements but for the last, spread over the CPUs. grain 0 picks
+// parallel_grain(). Usage:
+//     parallel_for(0, size, [&](std::size_t lo, std::size_t hi) {
+//         memset(buffer + lo, 0, hi - lo);
+//     });
+template <typename Body>
+void parallel_for(const std::size_t begin, const std::size_t end, Body body,
+                  const std::size_t grain = 0) {
+    const ChunkFunction run = [](void* context, const std::size_t lo, const std::size_t hi,
+                                 unsigned) { (*static_cast<Body*>(context))(lo, hi); };
+
+    parallel_run(begin, end, grain, run, &body);
+};
+
+// Folds [begin, end) into one T: map(lo, hi) reduces a chunk, combine(a, b)
+// merges two results. Each thread folds the chunks it claims into its own
+// partial result, in no set order, so combine must be associative and
+// commutative with identity as its neutral element.
+template <typename T, typename Map, typename Combine>
+T parallel_reduce(const std::size_t begin, const std::size_t end, const T identity, Map map,
+                  Combine combine, const std::size_t grain = 0) {
+    // A cache line each, so threads don't contend on their neighbours' partials
+    struct alignas(64) Partial {
+        T value;
+    };
+
+    struct Context {
+        Map&     map;
+        Combine& combine;
+        Partial  partials[PARALLEL_MAX_PARTICIPANTS];
+    };
+
+    Context context{map, combine, {}};
+    for (Partial& partial : context.partials) partial.value = identity;
+
+    const ChunkFunction run = [](void* body, const std::size_t lo, const std::size_t hi,
+                                 const unsigned participant) {
+        auto& c   = *static_cast<Context*>(body);
+        T&    acc = c.partials[participant].value;
+        acc       = c.combine(acc, c.map(lo, hi));
+    };
+
+    parallel_run(begin, end, grain, run, &context);
+
+    T result = identity;
+    for (const Partial& partial : context.partials) result = combine(result, partial.value);
+
+    return result;
+};
+
+// Tasks with dependencies: each node runs on an executor thread once every node
+// it depends on has finished, and independent nodes run side by side. Built
+// once, it can be run any number of times.
+class TaskGraph {
+public:
+    struct Node;
+
+    TaskGraph() = default;
+
+    TaskGraph(const TaskGraph&) = delete;
+
+    TaskGraph& operator=(const TaskGraph&) = delete;
+
+    ~TaskGraph();
+
+    // A node that calls f(), kept on the heap until the graph is destroyed
+    template <typename F>
+    Node* add(F f) {
+        auto* callable = new F(std::move(f));
+        return add_node([](void* c) { (*static_cast<F*>(c))(); }, callable,
+                        [](void* c) { delete static_cast<F*>(c); });
+    };
+
+    // after only starts once before has finished
+    void precede(Node* before, Node* after);
+
+    // Runs every node and returns once all have finished. Needs the executor
+    // threads; a graph with a cycle never finishes.
+    void run();
+
+private:
+    Node* add_node(void (*invoke)(void*), void* callable, void (*destroy)(void*));
+
+    static void run_node(ReadyNode* ready);
+
+    Node*       m_nodes{};
+    std::size_t m_count{};
+    std::size_t m_remaining{}; // Nodes of this run not finished yet
+    bool        m_released{};  // Until then the last node may still touch m_done
+    WaitQueue   m_done;
+};
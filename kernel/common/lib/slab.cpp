@@ -0,0 +1,176 @@
+#include "slab.hpp"
+#include "page_alloc.hpp"
+
+struct FreeObject {
+    FreeObject* next;
+};
+
+// Lives at the start of every slab page
+struct SlabPage {
+    SlabPage*     next; // Link in the class partial list
+    SlabPage*     prev;
+    FreeObject*   free_list; // Objects returned to this page
+    std::uint16_t bump;      // Offset of the first never-used object
+    std::uint16_t in_use;
+    std::uint16_t capacity;
+    std::uint8_t  size_class;
+};
+
+constexpr std::size_t SLAB_HEADER = (sizeof(SlabPage) + 15) & ~static_cast<std::size_t>(15);
+
+constexpr std::uint16_t CLASS_SIZES[] = {16,  32,  48,  64,  80,  96,  112, 128,
+                                         160, 192, 224, 256, 320, 384, 448, 512};
+constexpr std::size_t   CLASS_COUNT   = sizeof(CLASS_SIZES) / sizeof(CLASS_SIZES[0]);
+
+static_assert(CLASS_SIZES[CLASS_COUNT - 1] == slab::MAX_SIZE);
+static_assert(slab::PAGE_SIZE == PAGE_SIZE);
+
+// Maps (size + 15) / 16 to its size class in a single load, and records where
+// the first object of each class starts. Objects are placed so that every one
+// is aligned to the largest power of two dividing the class size.
+struct ClassLookup {
+    std::uint8_t  index[slab::MAX_SIZE / 16 + 1]{};
+    std::uint16_t first_offset[CLASS_COUNT]{};
+
+    constexpr ClassLookup() {
+        std::size_t cls = 0;
+        for (std::size_t i = 0; i <= slab::MAX_SIZE / 16; ++i) {
+            while (CLASS_SIZES[cls] < i * 16) ++cls;
+            index[i] = static_cast<std::uint8_t>(cls);
+        };
+
+        for (std::size_t c = 0; c < CLASS_COUNT; ++c) {
+            const std::size_t align = CLASS_SIZES[c] & -CLASS_SIZES[c];
+            first_offset[c]         = (SLAB_HEADER + align - 1) & ~(align - 1);
+        };
+    };
+};
+
+static constexpr ClassLookup class_lookup{};
+
+static SlabPage* partial_pages[CLASS_COUNT]; // Pages with at least one free object
+
+static SlabPage* page_of(const void* ptr) {
+    return reinterpret_cast<SlabPage*>(
+        reinterpret_cast<std::uintptr_t>(ptr) & ~(slab::PAGE_SIZE - 1)
+    );
+};
+
+static void push_partial(SlabPage* page) {
+    SlabPage*& head = partial_pages[page->size_class];
+
+    page->prev = nullptr;
+    page->next = head;
+    if (head)
+        head->prev = page;
+
+    head = page;
+};
+
+static void unlink_partial(SlabPage* page) {
+    if (page->prev)
+        page->prev->next = page->next;
+    else
+        partial_pages[page->size_class] = page->next;
+
+    if (page->next)
+        page->next->prev = page->prev;
+
+    page->next = page->prev = nullptr;
+};
+
+static SlabPage* new_page(const std::uint8_t cls) {
+    auto* page = static_cast<SlabPage*>(alloc_pages(0));
+    if (!page)
+        return nullptr;
+
+    page_frame(page)->use = PageUse::SLAB;
+
+    const std::uint16_t first = class_lookup.first_offset[cls];
+    page->free_list           = nullptr;
+    page->bump                = first;
+    page->in_use              = 0;
+    page->capacity            = (slab::PAGE_SIZE - first) / CLASS_SIZES[cls];
+    page->size_class          = cls;
+    return page;
+};
+
+static void* alloc_from_class(const std::uint8_t cls) {
+    SlabPage* page = partial_pages[cls];
+    if (!page) {
+        page = new_page(cls);
+        if (!page)
+            return nullptr;
+
+        push_partial(page);
+    };
+
+    void* obj;
+    if (page->free_list) {
+        obj             = page->free_list;
+        page->free_list = page->free_list->next;
+    }
+    else {
+        obj         = reinterpret_cast<char*>(page) + page->bump;
+        page->bump += CLASS_SIZES[cls];
+    };
+
+    if (++page->in_use == page->capacity)
+        unlink_partial(page);
+
+    return obj;
+};
+
+namespace slab {
+    void* alloc(const std::size_t size) {
+        if (size > MAX_SIZE)
+            return nullptr;
+
+        return alloc_from_class(class_lookup.index[(size + 15) >> 4]);
+    };
+
+    void* alloc_aligned(const std::size_t size, const std::size_t align) {
+        std::size_t rounded = size < align ? align : size;
+        if (rounded > MAX_SIZE)
+            return nullptr;
+
+        std::uint8_t cls = class_lookup.index[(rounded + 15) >> 4];
+        if ((CLASS_SIZES[cls] & -CLASS_SIZES[cls]) < align) {
+            // Power-of-two classes are aligned to their own size
+            rounded = static_cast<std::size_t>(1) << (64 - __builtin_clzll(rounded - 1));
+            if (rounded > MAX_SIZE)
+                return nullptr;
+
+            cls = class_lookup.index[(rounded + 15) >> 4];
+        };
+
+        return alloc_from_class(cls);
+    };
+
+    void free(void* ptr) {
+        SlabPage* page = page_of(ptr);
+        auto*     obj  = static_cast<FreeObject*>(ptr);
+
+        obj->next       = page->free_list;
+        page->free_list = obj;
+
+        if (page->in_use-- == page->capacity)
+            push_partial(page); // Was full, becomes allocatable again
+
+        // Return fully free pages to the page allocator, but keep the last one of
+        // the class around so alloc/free ping-pong doesn't churn pages
+        if (page->in_use == 0 && (partial_pages[page->size_class] != page || page->next)) {
+            unlink_partial(page);
+            free_pages(page);
+        };
+    };
+
+    bool owns(const void* ptr) {
+        const PageFrame* frame = page_frame(ptr);
+        return frame && frame->use == PageUse::SLAB;
+    };
+
+    std::size_t usable_size(const void* ptr) {
+        return CLASS_SIZES[page_of(ptr)->size_class];
+    };
+}; // namespace slab
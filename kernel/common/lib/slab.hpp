@@ -0,0 +1,26 @@
+#pragma once
+#include <common/std/stdint.hpp>
+
+// Segregated size-class allocator for small objects.
+// Each size class owns a set of 4 KiB slab pages taken from the page allocator;
+// objects carry no header, the owning page (and therefore the size class) is
+// found by masking the pointer.
+namespace slab {
+    constexpr std::size_t PAGE_SIZE = 4096;
+    constexpr std::size_t MAX_SIZE  = 512; // Larger requests go to the general allocator
+
+    // Returns nullptr if no slab page could be obtained
+    void* alloc(std::size_t size);
+
+    // Picks a class whose objects are aligned to align (a power of two <= MAX_SIZE)
+    void* alloc_aligned(std::size_t size, std::size_t align);
+
+    // ptr must have been returned by slab::alloc
+    void free(void* ptr);
+
+    // True if ptr lies inside a slab page
+    bool owns(const void* ptr);
+
+    // Size of the class ptr was allocated from
+    std::size_t usable_size(const void* ptr);
+}; // namespace slab
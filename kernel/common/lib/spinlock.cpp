@@ -0,0 +1,31 @@
+#include "spinlock.hpp"
+#include "thread.hpp"
+
+// Only this CPU ever stores its own id in m_owner, so seeing it there means
+// this CPU holds the lock
+void CpuLock::lock() {
+    preempt_disable();
+
+    const unsigned self = cpu::id();
+    if (__atomic_load_n(&m_owner, __ATOMIC_RELAXED) == self) {
+        m_depth++;
+        return;
+    };
+
+    m_lock.lock();
+    __atomic_store_n(&m_owner, self, __ATOMIC_RELAXED);
+    m_depth = 1;
+};
+
+void CpuLock::unlock() {
+    if (--m_depth == 0) {
+        __atomic_store_n(&m_owner, NO_OWNER, __ATOMIC_RELAXED);
+        m_lock.unlock();
+    };
+
+    preempt_enable();
+};
+
+bool CpuLock::held() const {
+    return __atomic_load_n(&m_owner, __ATOMIC_RELAXED) == cpu::id();
+};
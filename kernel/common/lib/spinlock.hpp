@@ -0,0 +1,96 @@
+#pragma once
+#include <arch/aarch64/cpu.hpp>
+#include <common/std/stdint.hpp>
+
+// Ticket lock, CPUs get it in the order they asked. Never held across a
+// switch: holders keep preemption off, and IRQs masked if an interrupt handler
+// takes the same lock.
+class SpinLock {
+public:
+    constexpr SpinLock() = default;
+
+    SpinLock(const SpinLock&) = delete;
+
+    SpinLock& operator=(const SpinLock&) = delete;
+
+    void lock() {
+        const std::uint32_t ticket = __atomic_fetch_add(&m_next, 1, __ATOMIC_RELAXED);
+        while (__atomic_load_n(&m_serving, __ATOMIC_ACQUIRE) != ticket) {
+            cpu::relax();
+        };
+    };
+
+    [[nodiscard]] bool try_lock() {
+        std::uint32_t serving = __atomic_load_n(&m_serving, __ATOMIC_ACQUIRE);
+        return __atomic_compare_exchange_n(&m_next, &serving, serving + 1, false,
+                                           __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+    };
+
+    void unlock() {
+        __atomic_store_n(&m_serving, m_serving + 1, __ATOMIC_RELEASE);
+    };
+
+private:
+    std::uint32_t m_next{};
+    std::uint32_t m_serving{};
+};
+
+// IRQs masked and the lock held, for state interrupt handlers touch too
+struct IrqSpinLockScope {
+    SpinLock&           lock;
+    const std::uint64_t flags;
+
+    explicit IrqSpinLockScope(SpinLock& l) : lock(l), flags(cpu::irq_save()) {
+        lock.lock();
+    };
+
+    ~IrqSpinLockScope() {
+        lock.unlock();
+        cpu::irq_restore(flags);
+    };
+
+    IrqSpinLockScope(const IrqSpinLockScope&) = delete;
+
+    IrqSpinLockScope& operator=(const IrqSpinLockScope&) = delete;
+};
+
+// A lock the holding CPU may take again, which only counts. For subsystems with
+// nested entry points, or that a fault handler re-enters on the same CPU (a
+// stack growing inside the page allocator). Holders aren't preempted.
+class CpuLock {
+public:
+    constexpr CpuLock() = default;
+
+    CpuLock(const CpuLock&) = delete;
+
+    CpuLock& operator=(const CpuLock&) = delete;
+
+    void lock();
+    void unlock();
+
+    // Whether this CPU holds it
+    [[nodiscard]] bool held() const;
+
+private:
+    static constexpr unsigned NO_OWNER = ~0u;
+
+    SpinLock m_lock;
+    unsigned m_owner{NO_OWNER};
+    unsigned m_depth{};
+};
+
+struct CpuLockScope {
+    CpuLock& lock;
+
+    explicit CpuLockScope(CpuLock& l) : lock(l) {
+        lock.lock();
+    };
+
+    ~CpuLockScope() {
+        lock.unlock();
+    };
+
+    CpuLockScope(const CpuLockScope&) = delete;
+
+    CpuLockScope& operator=(const CpuLockScope&) = delete;
+};
@@ -0,0 +1,163 @@
+#include "stack.hpp"
+#include "page_alloc.hpp"
+#include "thread.hpp"
+
+#include <arch/aarch64/mmu.hpp>
+#include <common/cppruntime_support.hpp>
+#include <common/std/print.hpp>
+
+constexpr std::size_t INITIAL_COMMIT = 1; // Pages mapped when the stack is created
+constexpr std::size_t RESERVE_PAGES  = 8;
+constexpr std::size_t SLOT_PAGES     = STACK_SLOT_SIZE / PAGE_SIZE;
+
+static std::uint64_t slot_bitmap[STACK_SLOT_COUNT / 64];
+static std::uint8_t  slot_pages[STACK_SLOT_COUNT]; // Usable pages per live slot, 0 if free
+static std::size_t   next_word  = 0;               // Where the next search starts
+static std::size_t   live_count = 0;
+static std::size_t   committed  = 0;
+
+// A fault can hit while the page allocator is half way through an operation
+// on the same thread, so the handler falls back to pages set aside earlier
+static void*       reserve[RESERVE_PAGES];
+static std::size_t reserve_count = 0;
+
+static void refill_reserve() {
+    while (reserve_count < RESERVE_PAGES && !page_alloc_in_use()) {
+        void* page = alloc_pages(0);
+        if (!page)
+            break;
+
+        reserve[reserve_count++] = page;
+    };
+};
+
+static void* take_page() {
+    if (!page_alloc_in_use()) {
+        if (void* page = alloc_pages(0))
+            return page;
+    };
+
+    return reserve_count ? reserve[--reserve_count] : nullptr;
+};
+
+static std::uintptr_t slot_base(const std::size_t slot) {
+    return STACK_REGION_BASE + slot * STACK_SLOT_SIZE;
+};
+
+static bool commit(const std::uintptr_t page_va) {
+    void* page = take_page();
+    if (!page)
+        return false;
+
+    if (!mmu::map(page_va, reinterpret_cast<std::uintptr_t>(page), PAGE_SIZE,
+                  mmu::MemoryType::NORMAL)) {
+        free_pages(page);
+        return false;
+    };
+
+    committed++;
+    return true;
+};
+
+static std::size_t find_free_slot() {
+    for (std::size_t i = 0; i < STACK_SLOT_COUNT / 64; ++i) {
+        const std::size_t word = (next_word + i) % (STACK_SLOT_COUNT / 64);
+        if (~slot_bitmap[word]) {
+            next_word = word;
+            return word * 64 + __builtin_ctzll(~slot_bitmap[word]);
+        };
+    };
+
+    return STACK_SLOT_COUNT;
+};
+
+static void release_slot(const std::size_t slot) {
+    const std::uintptr_t top = slot_base(slot) + STACK_SLOT_SIZE;
+    for (std::size_t i = 1; i <= slot_pages[slot]; ++i) {
+        if (const std::uintptr_t pa = mmu::unmap_page(top - i * PAGE_SIZE)) {
+            free_pages(reinterpret_cast<void*>(pa));
+            committed--;
+        };
+    };
+
+    slot_pages[slot]       = 0;
+    slot_bitmap[slot / 64] &= ~(1ull << (slot % 64));
+    live_count--;
+};
+
+std::uint8_t* stack_alloc(std::size_t size) {
+    if (size == 0 || size > MAX_STACK_SIZE)
+        size = MAX_STACK_SIZE;
+
+    const CpuLockScope guard(page_lock);
+
+    const std::size_t slot = find_free_slot();
+    if (slot == STACK_SLOT_COUNT)
+        return nullptr;
+
+    const std::size_t pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+    slot_bitmap[slot / 64] |= 1ull << (slot % 64);
+    slot_pages[slot]        = static_cast<std::uint8_t>(pages);
+    live_count++;
+
+    const std::uintptr_t top = slot_base(slot) + STACK_SLOT_SIZE;
+    for (std::size_t i = 1; i <= INITIAL_COMMIT && i <= pages; ++i) {
+        if (!commit(top - i * PAGE_SIZE)) {
+            release_slot(slot);
+            return nullptr;
+        };
+    };
+
+    refill_reserve();
+    return reinterpret_cast<std::uint8_t*>(top - pages * PAGE_SIZE);
+};
+
+void stack_free(std::uint8_t* stack) {
+    if (!stack)
+        return;
+
+    const std::uintptr_t address = reinterpret_cast<std::uintptr_t>(stack);
+    const std::size_t    slot    = (address - STACK_REGION_BASE) / STACK_SLOT_SIZE;
+    if (address < STACK_REGION_BASE || slot >= STACK_SLOT_COUNT || !slot_pages[slot])
+        return;
+
+    const CpuLockScope guard(page_lock);
+    release_slot(slot);
+};
+
+bool stack_handle_fault(const std::uintptr_t address) {
+    if (address < STACK_REGION_BASE ||
+        address >= STACK_REGION_BASE + STACK_SLOT_COUNT * STACK_SLOT_SIZE)
+        return false;
+
+    // Another CPU may be allocating, freeing or growing a stack
+    const CpuLockScope guard(page_lock);
+
+    const std::size_t slot   = (address - STACK_REGION_BASE) / STACK_SLOT_SIZE;
+    const std::size_t offset = (address - slot_base(slot)) / PAGE_SIZE;
+    if (!slot_pages[slot])
+        return false; // Freed stack, a use-after-free
+
+    // Pages below the usable range, the guard page included, are never mapped.
+    // No heap from here on, the fault may have interrupted the allocator.
+    if (offset < SLOT_PAGES - slot_pages[slot]) {
+        std::println("Stack overflow: {} is below the {} KiB stack ending at {}",
+                     reinterpret_cast<void*>(address), slot_pages[slot] * PAGE_SIZE / 1024,
+                     reinterpret_cast<void*>(slot_base(slot) + STACK_SLOT_SIZE));
+        panic("Stack overflow");
+    };
+
+    if (!commit(address & ~(PAGE_SIZE - 1)))
+        panic("Out of memory while growing a stack");
+
+    refill_reserve();
+    return true;
+};
+
+std::size_t stack_count() {
+    return live_count;
+};
+
+std::size_t stack_committed_pages() {
+    return committed;
+};
@@ -0,0 +1,28 @@
+#pragma once
+#include <common/std/stdint.hpp>
+
+// Thread stacks live in a dedicated virtual window, one fixed-size slot per
+// stack. Only the top page is mapped up front; the rest is committed page by
+// page from the translation-fault handler as the stack grows. The page below
+// the usable range is never mapped, so an overflow faults instead of silently
+// running into other memory.
+//
+// Stack memory is not identity-mapped: don't hand stack addresses to devices.
+constexpr std::uintptr_t STACK_REGION_BASE = 0x6000000000; // 384 GiB
+constexpr std::size_t    STACK_SLOT_SIZE   = 256 * 1024;
+constexpr std::size_t    STACK_SLOT_COUNT  = 65536; // 16 GiB of address space
+constexpr std::size_t    MAX_STACK_SIZE    = STACK_SLOT_SIZE - 4096; // Leaves the guard page
+
+// Reserves a stack of size bytes (rounded up to pages, at most MAX_STACK_SIZE).
+// Returns its lowest usable address, nullptr if no slot or page is available.
+std::uint8_t* stack_alloc(std::size_t size);
+
+// Unmaps and frees every committed page. nullptr is ignored.
+void stack_free(std::uint8_t* stack);
+
+// Called on a translation fault. Commits the page holding address if it lies
+// in a live stack, panics on a guard page hit, returns false otherwise.
+bool stack_handle_fault(std::uintptr_t address);
+
+std::size_t stack_count();
+std::size_t stack_committed_pages();
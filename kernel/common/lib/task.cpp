@@ -0,0 +1,122 @@
+#include "task.hpp"
+#include "thread_pool.hpp"
+
+// Its lock guards ready and pending too, so an executor thread that finds
+// nothing to run is on the queue before the next post can look for it
+static WaitQueue   workers;
+static ReadyList   ready;
+static std::size_t pending;
+static unsigned    thread_count;
+
+void executor_post(ReadyNode* node) {
+    {
+        const IrqSpinLockScope guard(workers.lock);
+        ready.push(node);
+        pending++;
+    };
+
+    wake_one(workers);
+};
+
+static void executor_loop(void*) {
+    while (true) {
+        ReadyNode* node;
+        {
+            const IrqSpinLockScope guard(workers.lock);
+            while (!ready.head) {
+                block_on(workers);
+            };
+
+            node = ready.pop();
+            pending--;
+        };
+
+        // A coroutine's node is in its frame, which it may free as it runs, so
+        // nothing reads the node after it is resumed
+        if (node->function)
+            node->function(node);
+        else
+            node->handle.resume();
+    };
+};
+
+void start_executor(const unsigned count, const unsigned priority) {
+    for (unsigned i = 0; i < count; ++i) {
+        Thread* t = thread_pool_acquire();
+        if (!t)
+            panic("start_executor: out of stack space");
+
+        spawn_thread(t, executor_loop, nullptr, priority);
+        __atomic_fetch_add(&thread_count, 1, __ATOMIC_RELAXED);
+    };
+};
+
+unsigned executor_threads() {
+    return __atomic_load_n(&thread_count, __ATOMIC_RELAXED);
+};
+
+std::size_t executor_pending() {
+    return __atomic_load_n(&pending, __ATOMIC_RELAXED);
+};
+
+void spawn_task(Task<void> task) {
+    const Task<void>::Handle handle = task.release();
+    if (!handle)
+        return;
+
+    handle.promise().detached    = true;
+    handle.promise().node.handle = handle;
+    executor_post(&handle.promise().node);
+};
+
+struct SyncWait {
+    WaitQueue queue;
+    bool      done;
+    bool      released; // Until then the task may still touch this
+};
+
+static Task<void> signal_when_done(Task<void> task, SyncWait& state) {
+    co_await std::move(task);
+
+    {
+        const IrqSpinLockScope guard(state.queue.lock);
+        state.done = true;
+    };
+
+    wake_all(state.queue);
+    __atomic_store_n(&state.released, true, __ATOMIC_RELEASE);
+};
+
+void sync_wait(Task<void> task) {
+    SyncWait state{};
+    spawn_task(signal_when_done(std::move(task), state));
+
+    {
+        const IrqSpinLockScope guard(state.queue.lock);
+        while (!state.done) {
+            block_on(state.queue);
+        };
+    };
+
+    // Woken before wake_all() has let go of the queue
+    while (!__atomic_load_n(&state.released, __ATOMIC_ACQUIRE)) {
+        cpu::relax();
+    };
+};
+
+void AsyncEvent::notify_all() {
+    ReadyList list;
+    {
+        const IrqSpinLockScope guard(m_lock);
+        list      = m_waiters;
+        m_waiters = ReadyList{};
+    };
+
+    // Read next first, the node may be resumed and gone as soon as it is posted
+    ReadyNode* node = list.head;
+    while (node) {
+        ReadyNode* next = node->next;
+        executor_post(node);
+        node = next;
+    };
+};
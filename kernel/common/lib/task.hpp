@@ -0,0 +1,345 @@
+#pragma once
+#include "common/cppruntime_support.hpp" // For panic()
+#include "common/lib/spinlock.hpp"
+#include "common/lib/thread.hpp"
+#include "common/lib/timer_wheel.hpp"
+#include "common/std/chrono.hpp"
+#include "common/std/coroutine.hpp"
+#include "common/std/new.hpp"
+#include "common/std/utility.hpp"
+
+#include <arch/aarch64/cpu.hpp>
+
+// Stackless C++20 coroutines on top of the scheduler. A Task is a coroutine
+// whose frame, a few hundred bytes at most, is all it owns: no stack and no
+// Thread. A few executor threads resume whichever tasks are ready, and a
+// suspended task costs nothing but its frame.
+
+// A suspended coroutine, queued to be resumed by an executor thread. It lives
+// in whatever suspended the coroutine (an awaiter or a promise, both in the
+// frame), so queueing never allocates. Plain work (common/lib/parallel.hpp)
+// sets function instead, which is called with the node.
+struct ReadyNode {
+    ReadyNode*              next{};
+    std::coroutine_handle<> handle{};
+    void (*function)(ReadyNode* node){};
+};
+
+// A FIFO of ReadyNodes, guarded by whoever owns it
+struct ReadyList {
+    ReadyNode* head{};
+    ReadyNode* tail{};
+
+    void push(ReadyNode* node) {
+        node->next = nullptr;
+        if (tail)
+            tail->next = node;
+        else
+            head = node;
+
+        tail = node;
+    };
+
+    ReadyNode* pop() {
+        ReadyNode* node = head;
+        if (node) {
+            head = node->next;
+            if (!head)
+                tail = nullptr;
+        };
+
+        return node;
+    };
+};
+
+// Queues node->handle to be resumed by an executor thread. Any context, IRQ
+// handlers and timer callbacks included.
+void executor_post(ReadyNode* node);
+
+// Starts count executor threads at priority. Each resumes posted tasks in FIFO
+// order and sleeps on a wait queue while there are none.
+void start_executor(unsigned count, unsigned priority = PRIORITY_DEFAULT);
+
+// Posted and not yet resumed
+std::size_t executor_pending();
+
+// Executor threads started
+unsigned executor_threads();
+
+template <typename T = void>
+class Task;
+
+namespace detail {
+    struct TaskPromiseBase {
+        std::coroutine_handle<> continuation{}; // The awaiting coroutine, if any
+        ReadyNode               node{};         // Queues it for spawn_task()
+        bool                    detached{};     // Frees itself once done
+
+        // Hands the thread straight to the awaiting coroutine, without going
+        // back through the executor
+        struct FinalAwaiter {
+            bool await_ready() const noexcept {
+                return false;
+            };
+
+            template <typename Promise>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> h) noexcept {
+                TaskPromiseBase& promise = h.promise();
+                if (promise.continuation)
+                    return promise.continuation;
+
+                if (promise.detached)
+                    h.destroy();
+
+                return std::noop_coroutine();
+            };
+
+            void await_resume() const noexcept {};
+        };
+
+        // Lazy: a task runs once awaited or spawned
+        std::suspend_always initial_suspend() noexcept {
+            return {};
+        };
+        FinalAwaiter final_suspend() noexcept {
+            return {};
+        };
+
+        void unhandled_exception() {
+            panic("Task: unhandled exception");
+        };
+    };
+
+    template <typename T>
+    struct TaskPromise : TaskPromiseBase {
+        alignas(T) unsigned char storage[sizeof(T)];
+        bool has_value{};
+
+        ~TaskPromise() {
+            if (has_value)
+                reinterpret_cast<T*>(storage)->~T();
+        };
+
+        Task<T> get_return_object() noexcept;
+
+        template <typename U>
+        void return_value(U&& value) {
+            new (storage) T(std::forward<U>(value));
+            has_value = true;
+        };
+
+        T&& result() {
+            return static_cast<T&&>(*reinterpret_cast<T*>(storage));
+        };
+    };
+
+    template <>
+    struct TaskPromise<void> : TaskPromiseBase {
+        Task<void> get_return_object() noexcept;
+
+        void return_void() noexcept {};
+
+        void result() {};
+    };
+}; // namespace detail
+
+// The handle to a coroutine that returns T. Owns the frame until it is
+// awaited to completion, destroyed, or given to spawn_task().
+template <typename T>
+class [[nodiscard]] Task {
+public:
+    using promise_type = detail::TaskPromise<T>;
+    using Handle       = std::coroutine_handle<promise_type>;
+
+    constexpr Task() noexcept = default;
+
+    explicit Task(const Handle handle) noexcept : m_handle(handle) {};
+
+    Task(Task&& other) noexcept : m_handle(other.m_handle) {
+        other.m_handle = nullptr;
+    };
+
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            destroy();
+            m_handle       = other.m_handle;
+            other.m_handle = nullptr;
+        };
+
+        return *this;
+    };
+
+    Task(const Task&) = delete;
+
+    Task& operator=(const Task&) = delete;
+
+    ~Task() {
+        destroy();
+    };
+
+    // Starts the task in place of the awaiting coroutine, which is resumed
+    // with the result once the task returns. An empty (default-constructed or
+    // moved-from) task has no result to give.
+    auto operator co_await() && noexcept {
+        if (!m_handle)
+            panic("Task: co_await on an empty task");
+
+        struct Awaiter {
+            Handle handle;
+
+            bool await_ready() const noexcept {
+                return handle.done();
+            };
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+                handle.promise().continuation = awaiting;
+                return handle;
+            };
+
+            decltype(auto) await_resume() {
+                return handle.promise().result();
+            };
+        };
+
+        return Awaiter{m_handle};
+    };
+
+    // Gives up ownership of the frame
+    Handle release() noexcept {
+        const Handle handle = m_handle;
+        m_handle            = nullptr;
+        return handle;
+    };
+
+private:
+    void destroy() {
+        if (m_handle)
+            m_handle.destroy();
+
+        m_handle = nullptr;
+    };
+
+    Handle m_handle{};
+};
+
+namespace detail {
+    template <typename T>
+    Task<T> TaskPromise<T>::get_return_object() noexcept {
+        return Task<T>(Task<T>::Handle::from_promise(*this));
+    };
+
+    inline Task<void> TaskPromise<void>::get_return_object() noexcept {
+        return Task<void>(Task<void>::Handle::from_promise(*this));
+    };
+}; // namespace detail
+
+// Runs task on the executor threads. Nothing waits for it, and its frame is
+// freed once it returns.
+void spawn_task(Task<void> task);
+
+// Blocks the calling thread until task, run on the executor threads, returns
+void sync_wait(Task<void> task);
+
+// co_await async_yield(): back of the executor queue, so every other ready task
+// runs first
+struct YieldAwaiter {
+    ReadyNode node{};
+
+    bool await_ready() const noexcept {
+        return false;
+    };
+
+    void await_suspend(const std::coroutine_handle<> h) noexcept {
+        node.handle = h;
+        executor_post(&node);
+    };
+
+    void await_resume() const noexcept {};
+};
+
+inline YieldAwaiter async_yield() noexcept {
+    return {};
+};
+
+// co_await async_sleep_until(deadline): resumed from the timer wheel once
+// cpu::counter() reaches deadline. A task destroyed while it sleeps takes its
+// timer off the wheel. Once the timer has fired the task is queued, and must
+// be resumed rather than destroyed.
+struct SleepAwaiter {
+    std::uint64_t deadline;
+    Timer         timer{};
+    ReadyNode     node{};
+
+    ~SleepAwaiter() {
+        // Only set once armed
+        if (timer.callback)
+            cancel_timer(&timer);
+    };
+
+    bool await_ready() const noexcept {
+        return cpu::counter() >= deadline;
+    };
+
+    void await_suspend(const std::coroutine_handle<> h) noexcept {
+        node.handle    = h;
+        timer.callback = [](void* context) { executor_post(static_cast<ReadyNode*>(context)); };
+        timer.context  = &node;
+        add_timer(&timer, deadline);
+    };
+
+    void await_resume() const noexcept {};
+};
+
+inline SleepAwaiter async_sleep_until(const std::uint64_t deadline) noexcept {
+    return SleepAwaiter{deadline};
+};
+
+template <typename Rep, typename Period>
+SleepAwaiter async_sleep_for(const std::chrono::duration<Rep, Period>& d) noexcept {
+    const std::int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+    return SleepAwaiter{cpu::counter() + (ns > 0 ? cpu::ns_to_counter(ns) : 0)};
+};
+
+// Tasks waiting for something an interrupt handler or another thread signals,
+// such as a device becoming ready. The WaitQueue of tasks: the ready check runs
+// under the event's lock, so a notify_all() landing between the check and the
+// suspension can't be lost.
+class AsyncEvent {
+public:
+    template <typename Ready>
+    struct Awaiter {
+        AsyncEvent& event;
+        Ready       ready;
+        ReadyNode   node{};
+
+        bool await_ready() {
+            return ready();
+        };
+
+        bool await_suspend(const std::coroutine_handle<> h) {
+            const IrqSpinLockScope guard(event.m_lock);
+            if (ready())
+                return false;
+
+            node.handle = h;
+            event.m_waiters.push(&node);
+            return true;
+        };
+
+        void await_resume() const noexcept {};
+    };
+
+    // co_await event.wait(ready): returns at once if ready() holds, otherwise
+    // at the next notify_all(). Like block_on(), check again after.
+    template <typename Ready>
+    Awaiter<Ready> wait(Ready ready) noexcept {
+        return Awaiter<Ready>{*this, ready};
+    };
+
+    // Posts every waiting task to the executor. Any context, IRQ handlers included.
+    void notify_all();
+
+private:
+    SpinLock  m_lock;
+    ReadyList m_waiters;
+};
@@ -1,64 +1,347 @@
 #include "thread.hpp"
-#include "common/std/print.hpp"
+#include "thread_pool.hpp"
+#include "timer_wheel.hpp"
+#include "common/cppruntime_support.hpp" // For panic()
 
-// Configuration
-constexpr int MAX_THREADS = 16;
+#include <arch/aarch64/cpu.hpp>
+#include <arch/aarch64/timer.hpp>
+#include <common/std/print.hpp>
 
-// A proper Ring Buffer
-static Thread* thread_queue[MAX_THREADS];
-static int     queue_head   = 0; // Read from here
-static int     queue_tail   = 0; // Write to here
-static int     active_count = 0; // Number of runnable threads in queue
+// How often aging runs, and how long the oldest thread of a level may wait
+// before it is raised one level, both in calls to schedule() on its CPU
+constexpr std::uint64_t AGING_PERIOD        = 8;
+constexpr std::uint64_t STARVATION_SWITCHES = 32;
 
-// Pointer to the currently executing thread
-Thread* current_thread = nullptr;
+// The boot CPU's idle thread needs a stack of its own, secondaries idle on
+// their boot stacks
+constexpr std::size_t IDLE_STACK_SIZE = 16 * 1024;
 
-// Helper: Ring Buffer Enqueue
-static void enqueue(Thread* t) {
-    if (active_count >= MAX_THREADS) {
-        std::println("Scheduler queue full! Dropping thread.");
-        return;
+// One FIFO per priority level. Bit n of ready_levels is set while level n is
+// non-empty, so the highest runnable level is one clz away. Other CPUs take
+// the lock to steal from it.
+struct RunQueue {
+    SpinLock      lock;
+    ThreadQueue   levels[PRIORITY_LEVELS];
+    std::uint32_t ready_levels;
+    std::size_t   count; // Read without the lock by CPUs looking for work
+    std::uint64_t switches;
+};
+
+static_assert(PRIORITY_LEVELS <= 32, "ready_levels holds one bit per level");
+
+// Everything but the run queue is only touched by its own CPU, with IRQs masked.
+// A cache line apiece, so CPUs don't contend on each other's state.
+struct alignas(64) CpuScheduler {
+    RunQueue      queue;
+    Thread*       idle;
+    Thread*       previous;     // Switched away from, on_cpu until the switch is done
+    volatile bool need_resched; // Set from the timer interrupt
+    bool          preempting;   // The next switch is forced, see preempt()
+};
+
+static CpuScheduler cpus[cpu::MAX_CPUS];
+static Thread       idle_threads[cpu::MAX_CPUS];
+static unsigned     time_slice = DEFAULT_TIME_SLICE_MS;
+
+// Every thread from spawn (or adoption as a boot or idle thread) until it exits
+static SpinLock all_threads_lock;
+static Thread*  all_threads;
+
+// The switch trace, slots claimed by every CPU with one atomic add
+static SchedTraceRecord sched_trace[SCHED_TRACE_CAPACITY];
+static std::uint64_t    sched_trace_written; // Since boot or sched_trace_clear()
+static bool             sched_trace_paused;  // While sched_trace_dump() reads it
+
+static_assert((SCHED_TRACE_CAPACITY & (SCHED_TRACE_CAPACITY - 1)) == 0,
+              "slots are taken modulo the capacity");
+
+// A preemption or migration in the middle of a queue update would corrupt it,
+// so every entry point runs with IRQs masked
+struct IrqScope {
+    const std::uint64_t flags = cpu::irq_save();
+
+    ~IrqScope() {
+        cpu::irq_restore(flags);
     };
+};
+
+static CpuScheduler& this_cpu() {
+    return cpus[cpu::id()];
+};
+
+// The idle thread runs without a slice, so an idle CPU takes no timer
+// interrupts but for its timer wheel
+static void start_slice(CpuScheduler& cpu_state, const Thread* t) {
+    const std::uint64_t length = cpu::counter_frequency() / 1000 * time_slice;
+
+    cpu_state.need_resched = false;
+    timer::set_slice_deadline(t == cpu_state.idle ? 0 : cpu::counter() + length);
+};
+
+static void set_current_thread(Thread* t) {
+    asm volatile("msr tpidrro_el0, %0" : : "r"(t) : "memory");
+};
+
+// O(1) append and unlink from anywhere in the queue
+static void push(ThreadQueue& queue, Thread* t) {
+    t->next = nullptr;
+    t->prev = queue.tail;
+    if (queue.tail)
+        queue.tail->next = t;
+    else
+        queue.head = t;
+
+    queue.tail = t;
+    queue.count++;
+    t->queue = &queue;
+};
+
+static void remove(Thread* t) {
+    ThreadQueue* queue = t->queue;
+    if (!queue)
+        return;
+
+    if (t->prev)
+        t->prev->next = t->next;
+    else
+        queue->head = t->next;
+
+    if (t->next)
+        t->next->prev = t->prev;
+    else
+        queue->tail = t->prev;
+
+    t->next  = nullptr;
+    t->prev  = nullptr;
+    t->queue = nullptr;
+    queue->count--;
+};
+
+static Thread* pop(ThreadQueue& queue) {
+    Thread* t = queue.head;
+    if (t)
+        remove(t);
 
-    thread_queue[queue_tail] = t;
-    queue_tail               = (queue_tail + 1) % MAX_THREADS;
-    active_count++;
+    return t;
+};
+
+// The run queue functions below are called with rq.lock held
+
+static bool in_run_queue(const RunQueue& rq, const Thread* t) {
+    return t->queue >= rq.levels && t->queue < rq.levels + PRIORITY_LEVELS;
 };
 
-// Helper: Ring Buffer Dequeue
-static Thread* dequeue() {
-    if (active_count == 0)
+static void push_level(RunQueue& rq, Thread* t, const unsigned level) {
+    t->effective_priority = level;
+    t->enqueued_at        = rq.switches;
+    push(rq.levels[level], t);
+    rq.ready_levels |= 1u << level;
+    __atomic_store_n(&rq.count, rq.count + 1, __ATOMIC_RELAXED);
+};
+
+// Unlinks t from rq, keeping ready_levels in sync
+static void unlink(RunQueue& rq, Thread* t) {
+    ThreadQueue* queue = t->queue;
+    remove(t);
+    __atomic_store_n(&rq.count, rq.count - 1, __ATOMIC_RELAXED);
+
+    if (queue->count == 0)
+        rq.ready_levels &= ~(1u << (queue - rq.levels));
+};
+
+// Aging drops back to the base priority every time a thread is queued again
+static void enqueue(RunQueue& rq, Thread* t) {
+    if (t->queue)
+        return;
+
+    push_level(rq, t, t->priority);
+};
+
+static Thread* dequeue(RunQueue& rq) {
+    if (!rq.ready_levels)
         return nullptr;
 
-    Thread* t  = thread_queue[queue_head];
-    queue_head = (queue_head + 1) % MAX_THREADS;
-    active_count--;
+    const unsigned level = 31 - __builtin_clz(rq.ready_levels);
+    Thread*        t     = rq.levels[level].head;
+    unlink(rq, t);
     return t;
 };
 
-extern "C" [[noreturn]] void exit_thread() {
-    // Mark as dead so join() knows we are done
-    if (current_thread)
-        current_thread->state = ThreadState::DEAD;
+// Raises the oldest thread of each starving level by one. Levels are walked top
+// down so a thread moves at most one level per pass. IDLE threads never age.
+static void age(RunQueue& rq) {
+    if (!rq.ready_levels)
+        return;
 
-    // Switch straight to the next thread WITHOUT enqueueing ourselves
-    schedule();
+    const unsigned top = 31 - __builtin_clz(rq.ready_levels);
+    for (unsigned level = top; level-- > PRIORITY_IDLE + 1;) {
+        Thread* t = rq.levels[level].head;
+        if (!t || rq.switches - t->enqueued_at < STARVATION_SWITCHES)
+            continue;
 
-    // We should never reach here (stack is gone/we are stopped)
-    while (true) {
-        asm volatile("wfe");
+        unlink(rq, t);
+        push_level(rq, t, level + 1);
     };
 };
 
-extern "C" [[noreturn]] void thread_trampoline(void (*func)(void*), void* arg) {
-    func(arg);
+// Queues t on this CPU and wakes any CPU idling in wait_for_event(), it may
+// steal t. IRQs are masked.
+static void make_runnable(Thread* t) {
+    const unsigned self = cpu::id();
+    RunQueue&      rq   = cpus[self].queue;
 
-    exit_thread();
+    rq.lock.lock();
+    t->state          = ThreadState::RUNNABLE;
+    t->cpu            = self;
+    t->runnable_since = cpu::counter();
+    enqueue(rq, t);
+    rq.lock.unlock();
+
+    cpu::send_event();
+};
+
+// A driver's thread woken from its IRQ handler, or a sleeper from the timer
+// wheel, shouldn't wait out the current slice if it outranks the running thread
+static void wake(Thread* t) {
+    make_runnable(t);
+
+    const Thread* running = current_thread();
+    if (running && t->priority > running->effective_priority)
+        this_cpu().need_resched = true;
+};
+
+// Takes the most urgent thread from the CPU with the most waiting. try_lock(),
+// so an idle CPU never holds up a busy one in its own schedule(). A thread still
+// on_cpu is being switched out where it was queued, that CPU takes it back.
+static Thread* steal(const unsigned self) {
+    RunQueue*   victim = nullptr;
+    std::size_t most   = 0;
+    for (unsigned i = 0; i < cpu::MAX_CPUS; ++i) {
+        const std::size_t count = __atomic_load_n(&cpus[i].queue.count, __ATOMIC_RELAXED);
+        if (i != self && count > most) {
+            most   = count;
+            victim = &cpus[i].queue;
+        };
+    };
+
+    if (!victim || !victim->lock.try_lock())
+        return nullptr;
+
+    Thread* stolen = nullptr;
+    for (std::uint32_t levels = victim->ready_levels; levels && !stolen;) {
+        const unsigned level = 31 - __builtin_clz(levels);
+        levels &= ~(1u << level);
+
+        for (Thread* t = victim->levels[level].head; t && !stolen; t = t->next) {
+            if (!__atomic_load_n(&t->on_cpu, __ATOMIC_ACQUIRE))
+                stolen = t;
+        };
+    };
+
+    if (stolen) {
+        unlink(*victim, stolen);
+        stolen->cpu = self;
+    };
+
+    victim->lock.unlock();
+    return stolen;
+};
+
+static void link_thread(Thread* t) {
+    const IrqSpinLockScope guard(all_threads_lock);
+    t->all_prev = nullptr;
+    t->all_next = all_threads;
+    if (all_threads)
+        all_threads->all_prev = t;
+
+    all_threads = t;
+};
+
+static void unlink_thread(Thread* t) {
+    const IrqSpinLockScope guard(all_threads_lock);
+    if (t->all_prev)
+        t->all_prev->all_next = t->all_next;
+    else
+        all_threads = t->all_next;
+
+    if (t->all_next)
+        t->all_next->all_prev = t->all_prev;
+
+    t->all_next = nullptr;
+    t->all_prev = nullptr;
+};
+
+static std::uint32_t trace_id(const Thread* t) {
+    return static_cast<std::uint32_t>(reinterpret_cast<std::uintptr_t>(t) >> 4);
+};
+
+// Accounting and the trace record for a switch from prev to next, with one
+// counter read for both. Only the CPU switching a thread writes its stats.
+static void account_switch(const CpuScheduler& cpu_state, Thread* prev, Thread* next,
+                           const bool preempted) {
+    const std::uint64_t now = cpu::counter();
+    if (prev) {
+        prev->stats.run_ticks += now - prev->running_since;
+        if (preempted)
+            prev->stats.preempted++;
+        else
+            prev->stats.voluntary++;
+    };
+
+    // Idle threads are never queued, they take over when nothing else can run
+    const bool          idle = next == cpu_state.idle;
+    const std::uint64_t wait = idle ? 0 : now - next->runnable_since;
+    next->running_since      = now;
+    next->stats.switches++;
+    if (!idle) {
+        const unsigned log2 = 63 - __builtin_clzll(wait | 1);
+        const unsigned last = THREAD_HISTOGRAM_BUCKETS - 1;
+        next->stats.wait_histogram[log2 < last ? log2 : last]++;
+        if (wait > next->stats.wait_max)
+            next->stats.wait_max = wait;
+    };
+
+    if (__atomic_load_n(&sched_trace_paused, __ATOMIC_RELAXED))
+        return;
+
+    const auto prev_state = prev ? prev->state : ThreadState::UNUSED;
+    const auto saturated  = wait < 0xffffffff ? wait : 0xffffffff;
+    const auto slot       = __atomic_fetch_add(&sched_trace_written, 1, __ATOMIC_RELAXED);
+    SchedTraceRecord& record = sched_trace[slot % SCHED_TRACE_CAPACITY];
+    record.timestamp         = now;
+    record.prev              = trace_id(prev);
+    record.next              = trace_id(next);
+    record.wait              = static_cast<std::uint32_t>(saturated);
+    record.cpu               = static_cast<std::uint8_t>(cpu::id());
+    record.prev_state        = static_cast<std::uint8_t>(prev_state);
+    record.preempted         = preempted;
+    record.priority          = next->effective_priority;
+};
+
+// Runs first on the thread switched to: the previous one's context is saved
+// now, so another CPU may run it, or join_thread() let it be freed
+static void finish_switch() {
+    CpuScheduler& cpu_state = this_cpu();
+    if (cpu_state.previous) {
+        __atomic_store_n(&cpu_state.previous->on_cpu, false, __ATOMIC_RELEASE);
+        cpu_state.previous = nullptr;
+    };
+};
+
+// Never queued: schedule() falls back to it when nothing here is runnable and
+// nothing could be stolen. With no slice to end, only an interrupt (the next
+// timer wheel deadline, a device) or another CPU queueing work wakes it. WFE
+// catches both; WFI would need an IPI for the second.
+[[noreturn]] static void idle_loop(void*) {
+    while (true) {
+        schedule();
+        cpu::wait_for_event();
+    };
 };
 
-extern "C" void spawn_thread(Thread* t, void (*func)(void*), void* arg) {
+static void initialize_context(Thread* t, void (*func)(void*), void* arg) {
     // Calculate Stack Pointer (Top of stack, growing down)
-    auto* sp_raw = t->stack + t->stack_size;
+    auto* sp_raw = t->stack + t->stack_size - t->stack_reserved;
 
     // Align to 16 bytes (AArch64 Requirement)
     auto* sp_aligned =
@@ -84,56 +367,464 @@ extern "C" void spawn_thread(Thread* t, void (*func)(void*), void* arg) {
     t->ctx.x29 = 0;
     t->ctx.x30 = 0;
 
-    // Add to run queue
-    enqueue(t);
+    // Loaded by the trap on its first FP/SIMD instruction, if it ever has one
+    t->ctx.fp = {};
 };
 
-extern "C" void schedule() {
-    // Get next thread
-    Thread* next_thread = dequeue();
+void* reserve_stack_top(Thread* t, const std::size_t size) {
+    t->stack_reserved += (size + 15) & ~std::size_t{15};
+    return t->stack + t->stack_size - t->stack_reserved;
+};
 
-    // Skip any DEAD threads that might have snuck into the queue
-    while (next_thread && next_thread->state == ThreadState::DEAD) {
-        next_thread = dequeue();
+static void make_idle(Thread* t, const unsigned self) {
+    t->priority           = PRIORITY_IDLE;
+    t->effective_priority = PRIORITY_IDLE;
+    t->cpu                = self;
+    t->running_since      = cpu::counter();
+    cpus[self].idle       = t;
+    link_thread(t);
+};
+
+void set_priority(Thread* t, const unsigned priority) {
+    const IrqScope irq;
+
+    // t->cpu only changes while t is in no run queue, or under the lock of the
+    // one it is moving to, so once locked it names the queue t is in, if any
+    RunQueue* rq;
+    while (true) {
+        const unsigned cpu_index = __atomic_load_n(&t->cpu, __ATOMIC_RELAXED);
+        rq                       = &cpus[cpu_index].queue;
+        rq->lock.lock();
+        if (__atomic_load_n(&t->cpu, __ATOMIC_RELAXED) == cpu_index)
+            break;
+
+        rq->lock.unlock();
     };
 
-    if (!next_thread) {
-        // We are yielding, but no one else is ready.
-        // If current thread is valid and runnable, just keep running it.
-        if (current_thread && current_thread->state != ThreadState::DEAD)
-            return;
+    t->priority = priority < PRIORITY_LEVELS ? priority : PRIORITY_MAX;
+    if (in_run_queue(*rq, t)) {
+        unlink(*rq, t);
+        enqueue(*rq, t);
+    };
 
-        // Current thread is DEAD (exiting) and queue is empty.
-        // The system is now idle. In a real OS, we sleep or wait for interrupts.
-        std::println("System Idle: No runnable threads.");
+    rq->lock.unlock();
+};
+
+std::size_t runnable_threads() {
+    std::size_t count = 0;
+    for (const CpuScheduler& cpu_state : cpus)
+        count += __atomic_load_n(&cpu_state.queue.count, __ATOMIC_RELAXED);
+
+    return count;
+};
+
+extern "C" [[noreturn]] void exit_thread() {
+    cpu::irq_save(); // Never restored, this thread doesn't run again
+
+    // DEAD under the joiners' lock, so join_thread() either sees it or is
+    // queued in time to be woken, and detach_thread() either sets detached or
+    // releases the thread itself. Never queued again after this.
+    Thread* self = current_thread();
+    unlink_thread(self);
+    self->joiners.lock.lock();
+    self->state         = ThreadState::DEAD;
+    const bool detached = self->detached;
+    self->joiners.lock.unlock();
 
-        // Unset current thread so we don't try to save context for a dead thread later
-        current_thread = nullptr;
+    if (detached)
+        reap_thread(self);
+    else
+        wake_all(self->joiners);
 
-        while (true) {
-            asm volatile("wfe"); // Wait For Event (save power)
+    // Switch straight to the next thread WITHOUT enqueueing ourselves
+    schedule();
+
+    // We should never reach here (stack is gone/we are stopped)
+    while (true) {
+        asm volatile("wfe");
+    };
+};
+
+extern "C" [[noreturn]] void thread_trampoline(void (*func)(void*), void* arg) {
+    // New threads are switched to from inside schedule(), with IRQs masked
+    finish_switch();
+    cpu::irq_enable();
+
+    func(arg);
+
+    exit_thread();
+};
+
+extern "C" void spawn_thread(Thread* t, void (*func)(void*), void* arg,
+                             const unsigned priority) {
+    initialize_context(t, func, arg);
+
+    // Add to this CPU's run queue, idle CPUs steal from there
+    const IrqScope irq;
+    t->priority = priority < PRIORITY_LEVELS ? priority : PRIORITY_MAX;
+    t->on_cpu   = false;
+    link_thread(t);
+    make_runnable(t);
+};
+
+extern "C" void schedule() {
+    const IrqScope irq;
+
+    const unsigned self      = cpu::id();
+    CpuScheduler&  cpu_state = cpus[self];
+    RunQueue&      rq        = cpu_state.queue;
+    Thread*        prev      = current_thread();
+    const bool     preempted = cpu_state.preempting;
+    cpu_state.preempting     = false;
+
+    // Highest priority first. DEAD threads are never queued, so anything
+    // queued is runnable.
+    rq.lock.lock();
+    if (++rq.switches % AGING_PERIOD == 0)
+        age(rq);
+
+    Thread* next = dequeue(rq);
+    rq.lock.unlock();
+
+    if (!next)
+        next = steal(self);
+
+    if (!next) {
+        // Nobody else is ready. A running thread keeps the CPU with a fresh
+        // slice, a blocked or exiting one hands it to the idle thread.
+        if (prev && prev->state == ThreadState::RUNNING) {
+            start_slice(cpu_state, prev);
+            return;
         };
+
+        next = cpu_state.idle;
     };
 
-    Thread* old_thread = current_thread;
-    current_thread     = next_thread;
+    start_slice(cpu_state, next);
 
-    // Context Switch:
-    // If old_thread is null (boot or idle wake-up) or DEAD,
-    // we must ensure we don't rely on it saving state meaningfully.
-    ThreadContext* old_ctx_ptr = nullptr;
-    if (old_thread)
-        old_ctx_ptr = &old_thread->ctx;
+    // Requeued by yield(), or woken before it was switched out
+    if (next == prev) {
+        prev->state = ThreadState::RUNNING;
+        return;
+    };
+
+    // Queued by a CPU that hasn't finished switching away from it yet
+    while (__atomic_load_n(&next->on_cpu, __ATOMIC_ACQUIRE)) {
+        cpu::relax();
+    };
+
+    if (prev && prev->state == ThreadState::RUNNING)
+        prev->state = ThreadState::RUNNABLE;
 
-    context_switch(old_ctx_ptr, &next_thread->ctx);
+    next->state  = ThreadState::RUNNING;
+    next->cpu    = self;
+    next->on_cpu = true;
+    account_switch(cpu_state, prev, next, preempted);
+
+    cpu_state.previous = prev;
+
+    // Context Switch:
+    // If prev is null (boot), there is no state to save. next becomes
+    // current_thread() in the switch, see threading.s.
+    context_switch(prev ? &prev->ctx : nullptr, &next->ctx);
+    finish_switch();
 };
 
 extern "C" void yield() {
-    // Put current thread back in queue (Round Robin)
-    if (current_thread) {
-        enqueue(current_thread);
+    const IrqScope irq;
+
+    // Put current thread back in queue (Round Robin). The idle thread is only
+    // ever run as a fallback.
+    Thread*       t         = current_thread();
+    CpuScheduler& cpu_state = this_cpu();
+    if (t && t != cpu_state.idle) {
+        t->runnable_since = cpu::counter();
+        cpu_state.queue.lock.lock();
+        enqueue(cpu_state.queue, t);
+        cpu_state.queue.lock.unlock();
     };
 
     // Switch to next
     schedule();
-};
\ No newline at end of file
+};
+
+void block_on(WaitQueue& queue) {
+    Thread* self = current_thread();
+    self->state  = ThreadState::BLOCKED;
+    push(queue.threads, self);
+
+    // A waker on another CPU may make this thread runnable right away, the CPU
+    // that picks it up waits in schedule() until it is switched out
+    queue.lock.unlock();
+    schedule();
+    queue.lock.lock();
+};
+
+struct Timeout {
+    Timer      timer;
+    WaitQueue* queue;
+    Thread*    thread;
+    bool       expired;
+};
+
+// Takes the thread off its wait queue unless a waker got to it first. It can't
+// run, and end its wait, before it is made runnable here.
+static void expire_timeout(void* context) {
+    auto*   timeout = static_cast<Timeout*>(context);
+    Thread* t       = timeout->thread;
+
+    timeout->queue->lock.lock();
+    const bool waiting = t->queue == &timeout->queue->threads;
+    if (waiting) {
+        remove(t);
+        timeout->expired = true;
+    };
+
+    timeout->queue->lock.unlock();
+
+    if (waiting)
+        wake(t);
+};
+
+bool block_on_until(WaitQueue& queue, const std::uint64_t deadline) {
+    if (cpu::counter() >= deadline)
+        return false;
+
+    Timeout timeout{};
+    timeout.timer.callback = expire_timeout;
+    timeout.timer.context  = &timeout;
+    timeout.queue          = &queue;
+    timeout.thread         = current_thread();
+    add_timer(&timeout.timer, deadline);
+
+    block_on(queue);
+
+    // The callback takes queue.lock, so wait for it without holding it
+    queue.lock.unlock();
+    cancel_timer(&timeout.timer);
+    queue.lock.lock();
+
+    return !timeout.expired;
+};
+
+void sleep_until(const std::uint64_t deadline) {
+    // Nothing else knows this queue, so only the timeout ends the wait
+    WaitQueue              queue;
+    const IrqSpinLockScope guard(queue.lock);
+    block_on_until(queue, deadline);
+};
+
+bool wake_one(WaitQueue& queue) {
+    const IrqScope irq;
+
+    queue.lock.lock();
+    Thread* t = pop(queue.threads);
+    queue.lock.unlock();
+    if (!t)
+        return false;
+
+    wake(t);
+    return true;
+};
+
+std::size_t wake_all(WaitQueue& queue) {
+    std::size_t woken = 0;
+    while (wake_one(queue)) ++woken;
+
+    return woken;
+};
+
+void join_thread(Thread* t) {
+    {
+        const IrqSpinLockScope guard(t->joiners.lock);
+        while (t->state != ThreadState::DEAD) {
+            block_on(t->joiners);
+        };
+    };
+
+    // exit_thread() still runs on t's stack until its CPU has switched away
+    while (__atomic_load_n(&t->on_cpu, __ATOMIC_ACQUIRE)) {
+        cpu::relax();
+    };
+};
+
+void adopt_boot_thread(Thread* t) {
+    const IrqScope irq;
+
+    // We don't need to allocate a stack because we are ALREADY running on the
+    // boot stack. The scheduler just needs a place to save registers (ctx).
+    const unsigned self = cpu::id();
+    t->state            = ThreadState::RUNNING;
+    t->stack            = nullptr; // Indicates we shouldn't delete this stack
+    t->cpu              = self;
+    t->on_cpu           = true;
+    t->running_since    = cpu::counter();
+    set_current_thread(t);
+    link_thread(t);
+
+    Thread* idle     = &idle_threads[self];
+    idle->stack      = stack_alloc(IDLE_STACK_SIZE);
+    idle->stack_size = IDLE_STACK_SIZE;
+    if (!idle->stack)
+        panic("adopt_boot_thread: no stack for the idle thread!");
+
+    initialize_context(idle, idle_loop, nullptr);
+    idle->state = ThreadState::RUNNABLE;
+    make_idle(idle, self);
+    start_slice(cpus[self], t);
+};
+
+[[noreturn]] void run_idle_thread() {
+    cpu::irq_save();
+
+    const unsigned self = cpu::id();
+    Thread*        idle = &idle_threads[self];
+    idle->state         = ThreadState::RUNNING;
+    idle->on_cpu        = true;
+    make_idle(idle, self);
+    start_slice(cpus[self], idle);
+    set_current_thread(idle);
+
+    cpu::irq_enable();
+    idle_loop(nullptr);
+};
+
+void set_time_slice(const unsigned ms) {
+    time_slice = ms ? ms : 1;
+};
+
+void time_slice_expired() {
+    this_cpu().need_resched = true;
+};
+
+bool preemption_pending() {
+    const Thread* t = current_thread();
+    return this_cpu().need_resched && t && t->state == ThreadState::RUNNING &&
+           t->preempt_count == 0;
+};
+
+// yield(), counted as a forced switch rather than a voluntary one
+static void preempt() {
+    const IrqScope irq;
+    this_cpu().preempting = true;
+    yield();
+};
+
+void preempt_disable() {
+    if (Thread* t = current_thread())
+        t->preempt_count++;
+
+    __atomic_signal_fence(__ATOMIC_SEQ_CST);
+};
+
+void preempt_enable() {
+    __atomic_signal_fence(__ATOMIC_SEQ_CST);
+    Thread* t = current_thread();
+    if (!t || --t->preempt_count)
+        return;
+
+    // The slice ran out, or a higher priority thread woke, inside the critical
+    // section. With IRQs masked this is an exception handler or the scheduler
+    // itself, and the next IRQ return will preempt instead.
+    if (this_cpu().need_resched && cpu::irqs_enabled())
+        preempt();
+};
+
+// exceptions.s returns here, on the preempted thread's stack with IRQs masked,
+// when an interrupt found preemption_pending()
+extern "C" void preempt_schedule() {
+    preempt();
+};
+
+void get_thread_stats(const Thread* t, ThreadStats& out) {
+    out = t->stats;
+    if (__atomic_load_n(&t->state, __ATOMIC_RELAXED) == ThreadState::RUNNING)
+        out.run_ticks += cpu::counter() - __atomic_load_n(&t->running_since, __ATOMIC_RELAXED);
+};
+
+static const char* const STATE_NAMES[] = {"unused", "runnable", "running", "blocked", "dead"};
+
+// Threads dump_thread_stats() shows, the rest are only counted
+constexpr std::size_t THREAD_DUMP_MAX = 256;
+
+struct ThreadSnapshot {
+    void*       thread;
+    ThreadStats stats;
+    ThreadState state;
+    unsigned    priority;
+    unsigned    cpu;
+};
+
+void dump_thread_stats() {
+    // Copied under the lock and printed after it, so spawns and exits only wait
+    // for the copy. Allocated first, the heap may block.
+    auto*       snapshots = new ThreadSnapshot[THREAD_DUMP_MAX];
+    std::size_t count     = 0;
+    std::size_t total     = 0;
+    {
+        const IrqSpinLockScope guard(all_threads_lock);
+        for (Thread* t = all_threads; t; t = t->all_next, ++total) {
+            if (count == THREAD_DUMP_MAX)
+                continue;
+
+            ThreadSnapshot& snapshot = snapshots[count++];
+            snapshot.thread          = t;
+            snapshot.state           = t->state;
+            snapshot.priority        = t->priority;
+            snapshot.cpu             = t->cpu;
+            get_thread_stats(t, snapshot.stats);
+        };
+    };
+
+    std::println("--- Thread Stats ---");
+    for (std::size_t i = 0; i < count; ++i) {
+        const ThreadSnapshot& snapshot = snapshots[i];
+        const ThreadStats&    stats    = snapshot.stats;
+        std::println("Thread {} ({}, priority {}, CPU {}): ran {} us, {} switches in, "
+                     "{} voluntary and {} preempted out, wait max {} us",
+                     snapshot.thread, STATE_NAMES[static_cast<unsigned>(snapshot.state)],
+                     snapshot.priority, snapshot.cpu,
+                     cpu::counter_to_ns(stats.run_ticks) / 1000, stats.switches,
+                     stats.voluntary, stats.preempted,
+                     cpu::counter_to_ns(stats.wait_max) / 1000);
+
+        for (unsigned b = 0; b < THREAD_HISTOGRAM_BUCKETS; ++b) {
+            if (stats.wait_histogram[b])
+                std::println("  wait >= {} ns: {}", cpu::counter_to_ns(b ? 1ull << b : 0),
+                             stats.wait_histogram[b]);
+        };
+    };
+
+    if (total > count)
+        std::println("... and {} more threads", total - count);
+
+    std::println("--------------------");
+    delete[] snapshots;
+};
+
+void sched_trace_clear() {
+    __atomic_store_n(&sched_trace_paused, true, __ATOMIC_RELAXED);
+    __atomic_store_n(&sched_trace_written, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&sched_trace_paused, false, __ATOMIC_RELEASE);
+};
+
+void sched_trace_dump() {
+    __atomic_store_n(&sched_trace_paused, true, __ATOMIC_RELAXED);
+
+    const std::uint64_t written = __atomic_load_n(&sched_trace_written, __ATOMIC_ACQUIRE);
+    const std::uint64_t dropped =
+        written > SCHED_TRACE_CAPACITY ? written - SCHED_TRACE_CAPACITY : 0;
+
+    // One record per line, the fields of SchedTraceRecord in order
+    std::println("PRISM-SCHED-TRACE BEGIN records={} dropped={} frequency={}",
+                 written - dropped, dropped, cpu::counter_frequency());
+    for (std::uint64_t i = dropped; i < written; ++i) {
+        const SchedTraceRecord& r = sched_trace[i % SCHED_TRACE_CAPACITY];
+        std::println("{} {} {} {} {} {} {} {}", r.timestamp, r.prev, r.next, r.wait,
+                     unsigned{r.cpu}, unsigned{r.prev_state}, unsigned{r.preempted},
+                     unsigned{r.priority});
+    };
+
+    std::println("PRISM-SCHED-TRACE END");
+    __atomic_store_n(&sched_trace_paused, false, __ATOMIC_RELEASE);
+};
@@ -1,6 +1,16 @@
 #pragma once
+#include "common/lib/spinlock.hpp"
+#include "common/lib/stack.hpp"
 #include "common/std/stdint.hpp"
 
+// FP/SIMD registers, saved by context_switch() only for a thread that used them
+// since it was switched in (exceptions.s)
+struct FpState {
+    std::uint64_t q[32][2]; // q0-q31, low half first
+    std::uint64_t fpsr;
+    std::uint64_t fpcr;
+};
+
 struct ThreadContext {
     std::uint64_t sp;         // 0: Stack pointer
     std::uint64_t pc;         // 8: Program counter
@@ -18,28 +28,217 @@ struct ThreadContext {
     std::uint64_t x30;        // 104: Link register
     std::uint64_t initial_x0; // 112: First arg for new thread
     std::uint64_t initial_x1; // 120: Second arg for new thread
+    FpState       fp;         // 128: Zero until the thread first uses FP/SIMD
 };
 
-enum class ThreadState { UNUSED, RUNNABLE, RUNNING, DEAD };
+static_assert(__builtin_offsetof(ThreadContext, fp) == 128,
+              "threading.s and exceptions.s rely on this layout");
+
+enum class ThreadState { UNUSED, RUNNABLE, RUNNING, BLOCKED, DEAD };
+
+struct Thread;
+
+// A FIFO of threads, linked through Thread itself so queueing never allocates.
+// Run queues and wait queues are both ThreadQueues, and a thread sits in at
+// most one of them.
+struct ThreadQueue {
+    Thread*     head{}; // Read from here
+    Thread*     tail{}; // Write to here
+    std::size_t count{};
+};
+
+// Threads blocked until some condition holds. The lock guards the queue, and
+// callers check their condition under it too, see block_on().
+struct WaitQueue {
+    SpinLock    lock;
+    ThreadQueue threads;
+};
+
+// Higher runs first. IDLE threads only run when nothing else is runnable, every
+// other level is aged so it can't starve.
+constexpr unsigned PRIORITY_LEVELS  = 32;
+constexpr unsigned PRIORITY_IDLE    = 0;
+constexpr unsigned PRIORITY_LOW     = 8;
+constexpr unsigned PRIORITY_DEFAULT = 16;
+constexpr unsigned PRIORITY_HIGH    = 24;
+constexpr unsigned PRIORITY_MAX     = PRIORITY_LEVELS - 1;
+
+constexpr unsigned THREAD_HISTOGRAM_BUCKETS = 24;
+
+// Scheduler accounting, kept by the CPU that switches the thread. Times are in
+// counter ticks. Bucket i of the histogram counts the waits in [2^i, 2^(i+1)),
+// the last one everything above.
+struct ThreadStats {
+    std::uint64_t run_ticks; // On a CPU
+    std::uint64_t switches;  // Times switched in
+    std::uint64_t voluntary; // Switched out blocking, yielding or exiting
+    std::uint64_t preempted; // Switched out when its slice ran out or a wake-up outranked it
+    std::uint64_t wait_max;  // Runnable until switched in
+    std::uint64_t wait_histogram[THREAD_HISTOGRAM_BUCKETS];
+};
 
 struct Thread {
     ThreadContext ctx{};
-    std::uint8_t* stack{};
+    std::uint8_t* stack{}; // From stack_alloc(), lowest usable address
     std::size_t   stack_size{};
+    std::size_t   stack_reserved{}; // Off the top, see reserve_stack_top()
+
+    ThreadState   state{ThreadState::UNUSED};
+    std::uint8_t  priority{PRIORITY_DEFAULT};
+    std::uint8_t  effective_priority{PRIORITY_DEFAULT}; // Raised by aging while waiting
+    std::uint64_t enqueued_at{}; // Switch count when it last entered a run queue
 
-    ThreadState state{ThreadState::UNUSED};
+    // Queue links, owned by the scheduler
+    Thread*      next{};
+    Thread*      prev{};
+    ThreadQueue* queue{}; // The queue holding this thread, if any
+
+    unsigned cpu{};    // CPU it runs on, or whose run queue holds it
+    bool     on_cpu{}; // Until the CPU that ran it has saved its context
+
+    unsigned preempt_count{}; // Not preempted while non-zero, see NoPreemptScope
+
+    WaitQueue joiners;  // Threads blocked in join(), woken by exit_thread()
+    bool      detached{}; // Never joined, exit_thread() hands it to reap_thread()
+
+    ThreadStats   stats{};
+    std::uint64_t runnable_since{}; // Counter when it was last queued to run
+    std::uint64_t running_since{};  // Counter when it was last switched in
+
+    // Every live thread, see dump_thread_stats()
+    Thread* all_next{};
+    Thread* all_prev{};
 
     ~Thread() {
-        delete[] stack; // free stack memory
+        stack_free(stack);
     };
 };
 
-// Forward declarations
-extern Thread* current_thread;
+static_assert(__builtin_offsetof(Thread, ctx) == 0,
+              "context_switch() and fp_trap find the thread from its ctx");
+
+// The running thread, kept in TPIDRRO_EL0 (nothing runs at EL0) so reading it
+// is one instruction that a migration can't split
+inline Thread* current_thread() {
+    Thread* t;
+    asm volatile("mrs %0, tpidrro_el0" : "=r"(t));
+    return t;
+};
 
 extern "C" void              context_switch(ThreadContext* old_ctx, ThreadContext* new_ctx);
 extern "C" [[noreturn]] void exit_thread();
 extern "C" [[noreturn]] void thread_trampoline(void (*func)(void*), void* arg);
-extern "C" void              spawn_thread(Thread* t, void (*func)(void*), void* arg);
+extern "C" void              spawn_thread(Thread* t, void (*func)(void*), void* arg,
+                                          unsigned priority = PRIORITY_DEFAULT);
 extern "C" void              schedule();
-extern "C" void              yield();
\ No newline at end of file
+extern "C" void              yield();
+
+// Carves size bytes, rounded up to 16, off the top of t's stack before
+// spawn_thread(). The thread starts below them, so they stay valid until it
+// exits. The top page is always committed.
+void* reserve_stack_top(Thread* t, std::size_t size);
+
+// Changes a thread's base priority, moving it if it is waiting in a run queue
+void set_priority(Thread* t, unsigned priority);
+
+// Blocks until t has exited and its CPU has switched away from it, after which
+// t and its stack may be freed
+void join_thread(Thread* t);
+
+// Makes the code running on the boot CPU's boot stack thread t, so it can
+// yield and block like any other
+void adopt_boot_thread(Thread* t);
+
+// Secondary CPUs, once up: the boot stack becomes this CPU's idle thread,
+// which runs whenever nothing else can and steals work from the other CPUs
+[[noreturn]] void run_idle_thread();
+
+// Each switch programs the CPU's timer for the end of the new thread's slice.
+// A thread that uses it up is preempted then if anything of equal or higher
+// priority is runnable on its CPU. The idle thread has no slice.
+constexpr unsigned DEFAULT_TIME_SLICE_MS = 10;
+
+void set_time_slice(unsigned ms);
+
+// From the timer interrupt, when the running thread's slice is over
+void time_slice_expired();
+
+// From the IRQ path: whether the interrupted thread should be switched out
+bool preemption_pending();
+
+// Keeps the current thread from being preempted while shared state (the heap,
+// page tables, a lock word) is inconsistent. Nests, and runs a preemption that
+// came due in the meantime on release.
+void preempt_disable();
+void preempt_enable();
+
+struct NoPreemptScope {
+    NoPreemptScope() {
+        preempt_disable();
+    };
+
+    ~NoPreemptScope() {
+        preempt_enable();
+    };
+
+    NoPreemptScope(const NoPreemptScope&) = delete;
+
+    NoPreemptScope& operator=(const NoPreemptScope&) = delete;
+};
+
+// Threads waiting in the run queues of every CPU, excluding the running ones
+std::size_t runnable_threads();
+
+// The caller holds queue.lock through an IrqSpinLockScope and has found its
+// wait condition false under it. Parks the current thread on queue as BLOCKED,
+// drops the lock while it sleeps and takes it again once woken by wake_one()
+// or wake_all(), so the caller can check the condition again.
+void block_on(WaitQueue& queue);
+
+// Like block_on(), but gives up once cpu::counter() reaches deadline, through a
+// timer wheel timeout. True if woken by wake_one() or wake_all(), false if it
+// timed out.
+bool block_on_until(WaitQueue& queue, std::uint64_t deadline);
+
+// Blocks the current thread until cpu::counter() reaches deadline
+void sleep_until(std::uint64_t deadline);
+
+// Make the oldest (or every) waiter runnable again, on the calling CPU. They
+// run at their next turn, the caller keeps the CPU unless a woken thread
+// outranks it. These take queue.lock themselves.
+bool        wake_one(WaitQueue& queue);
+std::size_t wake_all(WaitQueue& queue);
+
+// A snapshot of t's accounting, another CPU may be running it meanwhile. The
+// run time includes the current turn of a running thread.
+void get_thread_stats(const Thread* t, ThreadStats& out);
+
+// Run time, switches and wait histogram of every thread that hasn't exited, up
+// to the first 256. Takes a snapshot under the thread list lock and prints it
+// after releasing it.
+void dump_thread_stats();
+
+// Every CPU logs each switch into one ring that keeps the newest
+// SCHED_TRACE_CAPACITY. Always on, a record costs one atomic add and a store.
+constexpr std::size_t SCHED_TRACE_CAPACITY = 16384;
+
+// Threads are named by their address >> 4, as in the heap trace
+struct SchedTraceRecord {
+    std::uint64_t timestamp;  // CNTVCT
+    std::uint32_t prev;       // 0 if there was none
+    std::uint32_t next;
+    std::uint32_t wait;       // Ticks next was runnable, saturated. 0 for an idle thread.
+    std::uint8_t  cpu;
+    std::uint8_t  prev_state; // ThreadState prev was switched out as
+    std::uint8_t  preempted;  // 1 if its slice ran out or a wake-up outranked it
+    std::uint8_t  priority;   // next's effective priority
+};
+
+static_assert(sizeof(SchedTraceRecord) == 24);
+
+// Clears the ring, to trace one workload
+void sched_trace_clear();
+
+// Prints the ring oldest first, one record per line, framed so it can be cut
+// out of a serial log. Switches that are already logging may still land in it.
+void sched_trace_dump();
@@ -0,0 +1,140 @@
+#include "thread_pool.hpp"
+
+#include <arch/aarch64/cpu.hpp>
+#include <common/std/new.hpp>
+
+constexpr std::size_t REAPER_STACK_SIZE = 16 * 1024;
+
+// Both lists are linked through Thread::next, which only the run and wait
+// queues use otherwise, and a thread that exited is in neither
+static SpinLock        pool_lock;
+static Thread*         pool; // LIFO, the last stack used is the warmest
+static ThreadPoolStats stats;
+
+static WaitQueue reaper_queue; // Its lock guards zombies too
+static Thread*   zombies;      // Exited detached threads, maybe still on their CPU
+static Thread    reaper_thread;
+
+// Back to a freshly constructed Thread, keeping the stack
+static void reset(Thread* t) {
+    std::uint8_t* stack = t->stack;
+    t->stack            = nullptr; // ~Thread would free it
+
+    t->~Thread();
+    new (t) Thread();
+    t->stack      = stack;
+    t->stack_size = POOLED_STACK_SIZE;
+};
+
+Thread* thread_pool_acquire() {
+    {
+        const IrqSpinLockScope guard(pool_lock);
+        if (Thread* t = pool) {
+            pool    = t->next;
+            t->next = nullptr;
+            stats.cached--;
+            stats.recycled++;
+            return t;
+        };
+
+        stats.created++;
+    };
+
+    auto* t       = new Thread();
+    t->stack_size = POOLED_STACK_SIZE;
+    t->stack      = stack_alloc(POOLED_STACK_SIZE);
+    if (!t->stack) {
+        delete t;
+        return nullptr;
+    };
+
+    return t;
+};
+
+void thread_pool_release(Thread* t) {
+    if (t->stack && t->stack_size == POOLED_STACK_SIZE) {
+        reset(t);
+
+        const IrqSpinLockScope guard(pool_lock);
+        if (stats.cached < THREAD_POOL_MAX) {
+            t->next = pool;
+            pool    = t;
+            stats.cached++;
+            return;
+        };
+    };
+
+    delete t;
+};
+
+void detach_thread(Thread* t) {
+    {
+        // exit_thread() checks detached under the same lock it sets DEAD with
+        const IrqSpinLockScope guard(t->joiners.lock);
+        if (t->state != ThreadState::DEAD) {
+            t->detached = true;
+            return;
+        };
+    };
+
+    // Already exited, so nobody else will release it
+    join_thread(t);
+    thread_pool_release(t);
+};
+
+void reap_thread(Thread* t) {
+    reaper_queue.lock.lock();
+    t->next = zombies;
+    zombies = t;
+    reaper_queue.lock.unlock();
+
+    wake_one(reaper_queue);
+};
+
+static void reaper_loop(void*) {
+    while (true) {
+        Thread* list;
+        {
+            const IrqSpinLockScope guard(reaper_queue.lock);
+            while (!zombies) {
+                block_on(reaper_queue);
+            };
+
+            list    = zombies;
+            zombies = nullptr;
+        };
+
+        while (Thread* t = list) {
+            list = t->next;
+
+            // exit_thread() still runs on t's stack until its CPU has switched away
+            while (__atomic_load_n(&t->on_cpu, __ATOMIC_ACQUIRE)) {
+                cpu::relax();
+            };
+
+            thread_pool_release(t);
+
+            const IrqSpinLockScope guard(pool_lock);
+            stats.reaped++;
+        };
+    };
+};
+
+void start_thread_reaper() {
+    if (reaper_thread.state != ThreadState::UNUSED)
+        return;
+
+    reaper_thread.stack_size = REAPER_STACK_SIZE;
+    reaper_thread.stack      = stack_alloc(REAPER_STACK_SIZE);
+    if (!reaper_thread.stack)
+        return;
+
+    reaper_thread.state = ThreadState::RUNNABLE;
+
+    spawn_thread(&reaper_thread, reaper_loop, nullptr, PRIORITY_LOW);
+};
+
+ThreadPoolStats thread_pool_stats() {
+    const IrqSpinLockScope guard(pool_lock);
+    return stats;
+};
@@ -0,0 +1,36 @@
+#pragma once
+#include "common/lib/thread.hpp"
+#include "common/std/stdint.hpp"
+
+// Exited threads are kept, Thread object and stack together, and handed out
+// again, so spawning a short-lived thread allocates nothing once the pool is
+// warm. A recycled stack keeps the pages it has committed.
+constexpr std::size_t POOLED_STACK_SIZE = 64 * 1024;
+constexpr std::size_t THREAD_POOL_MAX   = 64; // Threads cached, more are freed
+
+struct ThreadPoolStats {
+    std::size_t cached;   // Waiting in the pool
+    std::size_t created;  // Allocated because the pool was empty
+    std::size_t recycled; // Handed out from the pool
+    std::size_t reaped;   // Detached threads taken back by the reaper
+};
+
+// An UNUSED thread with a POOLED_STACK_SIZE stack, ready for spawn_thread().
+// nullptr if the pool is empty and no stack can be allocated.
+Thread* thread_pool_acquire();
+
+// Takes back a thread from thread_pool_acquire() once join_thread() returned.
+// It is reset for the next spawn_thread(), or freed if the pool is full.
+void thread_pool_release(Thread* t);
+
+// Nobody will join t: once it exits, the reaper releases it to the pool
+void detach_thread(Thread* t);
+
+// From exit_thread() with IRQs masked, for a detached thread that is done
+void reap_thread(Thread* t);
+
+// Starts the reaper, a LOW priority thread. Detached threads are only taken
+// back once it runs.
+void start_thread_reaper();
+
+ThreadPoolStats thread_pool_stats();
@@ -0,0 +1,231 @@
+#include "timer_wheel.hpp"
+#include "spinlock.hpp"
+
+#include <arch/aarch64/cpu.hpp>
+#include <arch/aarch64/timer.hpp>
+
+constexpr std::uint64_t WHEEL_MASK = WHEEL_SLOTS - 1;
+
+struct alignas(64) Wheel {
+    SpinLock      lock;
+    TimerList     slots[WHEEL_LEVELS][WHEEL_SLOTS];
+    std::uint64_t occupied[WHEEL_LEVELS]; // Bit n set while slot n holds a timer
+    std::uint64_t now;                    // Every slot before this one has run
+    std::size_t   count;
+    Timer*        running; // Whose callback is running, see cancel_timer()
+};
+
+static Wheel wheels[cpu::MAX_CPUS];
+
+static std::uint64_t slot_period() {
+    return cpu::counter_frequency() / WHEEL_HZ;
+};
+
+static std::uint64_t rotate_right(const std::uint64_t bits, const unsigned count) {
+    return count ? bits >> count | bits << (64 - count) : bits;
+};
+
+static void push(TimerList& list, Timer* t) {
+    t->prev = nullptr;
+    t->next = list.head;
+    if (list.head)
+        list.head->prev = t;
+
+    list.head = t;
+    t->list   = &list;
+};
+
+static void unlink(Wheel& wheel, Timer* t) {
+    TimerList* list = t->list;
+    if (t->prev)
+        t->prev->next = t->next;
+    else
+        list->head = t->next;
+
+    if (t->next)
+        t->next->prev = t->prev;
+
+    t->next = nullptr;
+    t->prev = nullptr;
+    t->list = nullptr;
+    wheel.count--;
+
+    // Timers taken off the wheel to run are on a list of run_timers()' own
+    const TimerList* first = &wheel.slots[0][0];
+    if (!list->head && list >= first && list < first + WHEEL_LEVELS * WHEEL_SLOTS) {
+        const std::size_t index = list - first;
+        wheel.occupied[index / WHEEL_SLOTS] &= ~(1ull << index % WHEEL_SLOTS);
+    };
+};
+
+// The lowest level whose range reaches t->expires, in the slot it falls in.
+// Already due timers go in the current slot.
+static void place(Wheel& wheel, Timer* t) {
+    const std::uint64_t expires = t->expires > wheel.now ? t->expires : wheel.now;
+    const std::uint64_t delta   = expires - wheel.now;
+
+    unsigned level = 0;
+    while (level < WHEEL_LEVELS - 1 && delta >> (level + 1) * WHEEL_BITS) level++;
+
+    const unsigned shift    = level * WHEEL_BITS;
+    std::uint64_t  position = expires >> shift;
+
+    // Past the top level: the slot that comes up last, placed again from there
+    if (delta >> WHEEL_LEVELS * WHEEL_BITS)
+        position = (wheel.now >> shift) + WHEEL_MASK;
+
+    const unsigned slot = position & WHEEL_MASK;
+    push(wheel.slots[level][slot], t);
+    wheel.occupied[level] |= 1ull << slot;
+    wheel.count++;
+};
+
+// The slot at which something next happens: a timer runs, or a higher level
+// slot is cascaded. ~0 if the wheel is empty.
+static std::uint64_t next_event(const Wheel& wheel) {
+    std::uint64_t next = ~0ull;
+    for (unsigned level = 0; level < WHEEL_LEVELS; ++level) {
+        if (!wheel.occupied[level])
+            continue;
+
+        const unsigned      shift    = level * WHEEL_BITS;
+        const std::uint64_t position = wheel.now >> shift;
+        std::uint64_t       rotated  = rotate_right(wheel.occupied[level], position & WHEEL_MASK);
+
+        // Above level 0 the current slot was cascaded on the way in, anything
+        // in it now is a full turn away
+        if (level > 0)
+            rotated &= ~1ull;
+
+        const std::uint64_t steps = rotated ? __builtin_ctzll(rotated) : WHEEL_SLOTS;
+        const std::uint64_t at    = level ? (position + steps) << shift : wheel.now + steps;
+        if (at < next)
+            next = at;
+    };
+
+    return next;
+};
+
+// Moves the timers of the higher level slots that come up at wheel.now down
+static void cascade(Wheel& wheel) {
+    for (unsigned level = 1; level < WHEEL_LEVELS; ++level) {
+        const unsigned slot = (wheel.now >> level * WHEEL_BITS) & WHEEL_MASK;
+        while (Timer* t = wheel.slots[level][slot].head) {
+            unlink(wheel, t);
+            place(wheel, t);
+        };
+
+        if (slot != 0)
+            break;
+    };
+};
+
+// Runs the wheel up to and including slot target, moving due timers to expired
+static void advance(Wheel& wheel, const std::uint64_t target, TimerList& expired) {
+    while (wheel.now <= target) {
+        TimerList& slot = wheel.slots[0][wheel.now & WHEEL_MASK];
+        while (Timer* t = slot.head) {
+            unlink(wheel, t);
+            push(expired, t);
+            wheel.count++; // Still counted, as cancel_timer() may find it there
+        };
+
+        wheel.now++;
+
+        // Skip empty slots, but never past the next cascade
+        const std::uint64_t boundary = (wheel.now | WHEEL_MASK) + 1;
+        std::uint64_t       next     = target + 1 < boundary ? target + 1 : boundary;
+        if (wheel.occupied[0]) {
+            const std::uint64_t rotated =
+                rotate_right(wheel.occupied[0], wheel.now & WHEEL_MASK);
+            const std::uint64_t due = wheel.now + __builtin_ctzll(rotated);
+            if (due < next)
+                next = due;
+        };
+
+        if ((wheel.now & WHEEL_MASK) != 0 && next > wheel.now)
+            wheel.now = next;
+
+        // On arrival, even past target, as next_event() counts the current
+        // higher level slots as cascaded
+        if ((wheel.now & WHEEL_MASK) == 0)
+            cascade(wheel);
+    };
+};
+
+static void program(const Wheel& wheel) {
+    const std::uint64_t next = next_event(wheel);
+    timer::set_wheel_deadline(next == ~0ull ? 0 : next * slot_period());
+};
+
+void add_timer(Timer* t, const std::uint64_t deadline) {
+    const std::uint64_t period = slot_period();
+    const std::uint64_t flags  = cpu::irq_save();
+    const unsigned      self   = cpu::id();
+    Wheel&              wheel  = wheels[self];
+
+    wheel.lock.lock();
+
+    // An empty wheel may have stood still for a while
+    if (!wheel.count)
+        wheel.now = cpu::counter() / period;
+
+    t->expires = (deadline + period - 1) / period;
+    t->cpu     = self;
+    place(wheel, t);
+    program(wheel);
+
+    wheel.lock.unlock();
+    cpu::irq_restore(flags);
+};
+
+bool cancel_timer(Timer* t) {
+    Wheel& wheel = wheels[t->cpu];
+
+    const std::uint64_t flags = cpu::irq_save();
+    wheel.lock.lock();
+
+    const bool armed = t->list != nullptr;
+    if (armed)
+        unlink(wheel, t);
+
+    wheel.lock.unlock();
+    cpu::irq_restore(flags);
+
+    while (__atomic_load_n(&wheel.running, __ATOMIC_ACQUIRE) == t) {
+        cpu::relax();
+    };
+
+    return armed;
+};
+
+void run_timers() {
+    Wheel&    wheel = wheels[cpu::id()];
+    TimerList expired;
+
+    wheel.lock.lock();
+    advance(wheel, cpu::counter() / slot_period(), expired);
+
+    // Without the lock, so a callback may arm timers or wake threads. A timer
+    // cancelled meanwhile is just taken off expired.
+    while (Timer* t = expired.head) {
+        unlink(wheel, t);
+        __atomic_store_n(&wheel.running, t, __ATOMIC_RELAXED);
+        wheel.lock.unlock();
+
+        t->callback(t->context);
+
+        wheel.lock.lock();
+        __atomic_store_n(&wheel.running, nullptr, __ATOMIC_RELEASE);
+    };
+
+    program(wheel);
+    wheel.lock.unlock();
+};
+
+std::size_t pending_timers() {
+    std::size_t count = 0;
+    for (const Wheel& wheel : wheels) count += __atomic_load_n(&wheel.count, __ATOMIC_RELAXED);
+
+    return count;
+};
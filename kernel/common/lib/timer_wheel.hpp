@@ -0,0 +1,47 @@
+#pragma once
+#include <common/std/stdint.hpp>
+
+// One-shot kernel timers on a hierarchical timing wheel per CPU: WHEEL_LEVELS
+// levels of 64 slots, each level's slots 64 times coarser than the one below.
+// Arming and disarming are O(1). A timer moves down a level each time its slot
+// comes up, until it lands in the 1 ms level and runs. The CPU's timer is only
+// programmed for the next slot that holds anything, not ticked.
+constexpr unsigned WHEEL_HZ     = 1000; // Slot width of the finest level
+constexpr unsigned WHEEL_BITS   = 6;
+constexpr unsigned WHEEL_SLOTS  = 1u << WHEEL_BITS;
+constexpr unsigned WHEEL_LEVELS = 4; // 2^24 ms, about 4.6 hours; later timers go round again
+
+struct Timer;
+
+struct TimerList {
+    Timer* head{};
+};
+
+struct Timer {
+    void (*callback)(void* context){};
+    void* context{};
+
+    // Owned by the wheel
+    std::uint64_t expires{}; // In wheel slots of 1 / WHEEL_HZ
+    Timer*        next{};
+    Timer*        prev{};
+    TimerList*    list{}; // Set while armed
+    unsigned      cpu{};  // Whose wheel
+};
+
+// Arms t to call t->callback(t->context) from the calling CPU's timer
+// interrupt once cpu::counter() has reached deadline, up to one slot late but
+// never early. Callbacks run with IRQs masked and must not block. t must not
+// be armed already.
+void add_timer(Timer* t, std::uint64_t deadline);
+
+// Disarms t. If its callback is running on another CPU, waits for it to return,
+// so t may be freed afterwards. False if it already fired or wasn't armed.
+bool cancel_timer(Timer* t);
+
+// From the timer interrupt: runs the callbacks that are due on this CPU and
+// programs the timer for the next one
+void run_timers();
+
+// Timers armed on every CPU
+std::size_t pending_timers();
@@ -0,0 +1,319 @@
+#include "tlsf.hpp"
+
+// Physical block layout:
+//   [prev_phys | size+flags | payload ...][next block]
+// prev_phys is only maintained while the previous block is free. next_free and
+// prev_free overlay the payload, so they only exist for free blocks.
+struct Tlsf::Block {
+    Block*      prev_phys;
+    std::size_t header;
+    Block*      next_free;
+    Block*      prev_free;
+
+    static constexpr std::size_t FREE      = 1 << 0;
+    static constexpr std::size_t PREV_FREE = 1 << 1;
+    static constexpr std::size_t FLAGS     = ALIGN - 1;
+
+    [[nodiscard]] std::size_t size() const {
+        return header & ~FLAGS;
+    };
+    void set_size(const std::size_t size) {
+        header = size | (header & FLAGS);
+    };
+
+    [[nodiscard]] bool is_free() const {
+        return header & FREE;
+    };
+    [[nodiscard]] bool is_prev_free() const {
+        return header & PREV_FREE;
+    };
+
+    [[nodiscard]] void* payload() {
+        return reinterpret_cast<char*>(this) + BLOCK_OVERHEAD;
+    };
+    [[nodiscard]] Block* next() {
+        return reinterpret_cast<Block*>(static_cast<char*>(payload()) + size());
+    };
+
+    static Block* from_payload(const void* ptr) {
+        return reinterpret_cast<Block*>(
+            const_cast<char*>(static_cast<const char*>(ptr)) - BLOCK_OVERHEAD
+        );
+    };
+
+    // Update this block's boundary tag in the physical successor
+    void mark_free() {
+        header          |= FREE;
+        Block* n         = next();
+        n->prev_phys     = this;
+        n->header       |= PREV_FREE;
+    };
+
+    void mark_used() {
+        header         &= ~FREE;
+        next()->header &= ~PREV_FREE;
+    };
+};
+
+static_assert(sizeof(void*) * 2 == Tlsf::BLOCK_OVERHEAD);
+
+constexpr std::size_t MIN_BLOCK_SIZE = 2 * sizeof(void*); // Room for the free-list links
+
+static std::size_t fls(const std::size_t x) {
+    return 63 - __builtin_clzll(x);
+};
+
+void Tlsf::mapping_insert(const std::size_t size, std::size_t& fl, std::size_t& sl) {
+    if (size < SMALL_BLOCK_SIZE) {
+        // Small blocks are spread linearly over the first level
+        fl = 0;
+        sl = size / (SMALL_BLOCK_SIZE / SL_INDEX_COUNT);
+        return;
+    };
+
+    const std::size_t f = fls(size);
+    sl                  = (size >> (f - SL_INDEX_COUNT_LOG2)) ^ SL_INDEX_COUNT;
+    fl                  = f - (FL_INDEX_SHIFT - 1);
+};
+
+// Rounds up to the next bin boundary so any block found in the bin fits
+void Tlsf::mapping_search(std::size_t size, std::size_t& fl, std::size_t& sl) {
+    if (size >= SMALL_BLOCK_SIZE)
+        size += (static_cast<std::size_t>(1) << (fls(size) - SL_INDEX_COUNT_LOG2)) - 1;
+
+    mapping_insert(size, fl, sl);
+};
+
+std::size_t Tlsf::adjust_size(const std::size_t size) {
+    const std::size_t aligned = (size + (ALIGN - 1)) & ~(ALIGN - 1);
+    return aligned < MIN_BLOCK_SIZE ? MIN_BLOCK_SIZE : aligned;
+};
+
+Tlsf::Block* Tlsf::find_suitable(std::size_t& fl, std::size_t& sl) const {
+    std::uint32_t sl_map = m_sl_bitmap[fl] & (~0u << sl);
+    if (!sl_map) {
+        // Nothing left in this first level, move to the next non-empty one
+        const std::uint64_t fl_map = m_fl_bitmap & (~0ull << (fl + 1));
+        if (!fl_map)
+            return nullptr;
+
+        fl     = __builtin_ctzll(fl_map);
+        sl_map = m_sl_bitmap[fl];
+    };
+
+    sl = __builtin_ctz(sl_map);
+    return m_blocks[fl][sl];
+};
+
+void Tlsf::insert(Block* block) {
+    std::size_t fl, sl;
+    mapping_insert(block->size(), fl, sl);
+
+    Block* head      = m_blocks[fl][sl];
+    block->next_free = head;
+    block->prev_free = nullptr;
+    if (head)
+        head->prev_free = block;
+
+    m_blocks[fl][sl]  = block;
+    m_fl_bitmap      |= 1ull << fl;
+    m_sl_bitmap[fl]  |= 1u << sl;
+    m_free_bytes     += block->size();
+    m_free_blocks++;
+};
+
+void Tlsf::remove(Block* block) {
+    std::size_t fl, sl;
+    mapping_insert(block->size(), fl, sl);
+
+    if (block->prev_free)
+        block->prev_free->next_free = block->next_free;
+    if (block->next_free)
+        block->next_free->prev_free = block->prev_free;
+
+    if (m_blocks[fl][sl] == block) {
+        m_blocks[fl][sl] = block->next_free;
+        if (!m_blocks[fl][sl]) {
+            m_sl_bitmap[fl] &= ~(1u << sl);
+            if (!m_sl_bitmap[fl])
+                m_fl_bitmap &= ~(1ull << fl);
+        };
+    };
+
+    m_free_bytes -= block->size();
+    m_free_blocks--;
+};
+
+Tlsf::Block* Tlsf::merge_neighbours(Block* block) {
+    if (block->is_prev_free()) {
+        Block* prev = block->prev_phys;
+        remove(prev);
+        prev->set_size(prev->size() + BLOCK_OVERHEAD + block->size());
+        block = prev;
+    };
+
+    if (Block* next = block->next(); next->is_free()) {
+        remove(next);
+        block->set_size(block->size() + BLOCK_OVERHEAD + next->size());
+    };
+
+    return block;
+};
+
+// Carves a free tail off block if the remainder can hold a block of its own
+void Tlsf::split(Block* block, const std::size_t size) {
+    if (block->size() < size + BLOCK_OVERHEAD + MIN_BLOCK_SIZE)
+        return;
+
+    auto* rest   = reinterpret_cast<Block*>(static_cast<char*>(block->payload()) + size);
+    rest->header = block->size() - size - BLOCK_OVERHEAD;
+    block->set_size(size);
+
+    rest->mark_free();
+    insert(rest);
+};
+
+void Tlsf::add_pool(void* mem, std::size_t bytes) {
+    bytes &= ~(ALIGN - 1);
+    if (bytes < MIN_POOL_SIZE)
+        return;
+
+    // One free block spanning the pool, followed by a zero-sized used sentinel
+    auto* block   = static_cast<Block*>(mem);
+    block->header = bytes - 2 * BLOCK_OVERHEAD;
+
+    Block* sentinel  = block->next();
+    sentinel->header = 0;
+
+    block->mark_free();
+    insert(block);
+};
+
+void* Tlsf::malloc(const std::size_t size) {
+    if (size >= (static_cast<std::size_t>(1) << (FL_INDEX_MAX - 1)))
+        return nullptr;
+
+    const std::size_t adjusted = adjust_size(size);
+
+    std::size_t fl, sl;
+    mapping_search(adjusted, fl, sl);
+
+    Block* block = find_suitable(fl, sl);
+    if (!block)
+        return nullptr;
+
+    remove(block);
+    split(block, adjusted);
+    block->mark_used();
+
+    return block->payload();
+};
+
+void* Tlsf::malloc_aligned(const std::size_t size, const std::size_t align) {
+    if (align <= ALIGN)
+        return malloc(size);
+
+    // A gap in front of the payload must hold a free block
+    constexpr std::size_t GAP_MIN = BLOCK_OVERHEAD + MIN_BLOCK_SIZE;
+
+    // Room to move the payload up to the next boundary
+    constexpr std::size_t LIMIT = static_cast<std::size_t>(1) << (FL_INDEX_MAX - 1);
+    if (size >= LIMIT || align >= LIMIT)
+        return nullptr;
+
+    const std::size_t adjusted = adjust_size(size);
+    const std::size_t search   = adjusted + align + GAP_MIN;
+    if (search >= LIMIT)
+        return nullptr;
+
+    std::size_t fl, sl;
+    mapping_search(search, fl, sl);
+
+    Block* block = find_suitable(fl, sl);
+    if (!block)
+        return nullptr;
+
+    remove(block);
+
+    const auto     payload = reinterpret_cast<std::uintptr_t>(block->payload());
+    std::uintptr_t aligned = (payload + align - 1) & ~(align - 1);
+    if (aligned != payload && aligned - payload < GAP_MIN)
+        aligned = (payload + GAP_MIN + align - 1) & ~(align - 1);
+
+    if (const std::size_t gap = aligned - payload) {
+        auto* moved   = reinterpret_cast<Block*>(aligned - BLOCK_OVERHEAD);
+        moved->header = block->size() - gap;
+        block->set_size(gap - BLOCK_OVERHEAD);
+
+        block->mark_free();
+        insert(block);
+        block = moved;
+    };
+
+    split(block, adjusted);
+    block->mark_used();
+
+    return block->payload();
+};
+
+void Tlsf::free(void* ptr) {
+    if (!ptr)
+        return;
+
+    Block* block = merge_neighbours(Block::from_payload(ptr));
+    block->mark_free();
+    insert(block);
+};
+
+void Tlsf::shrink(void* ptr, const std::size_t size) {
+    Block*            block    = Block::from_payload(ptr);
+    const std::size_t adjusted = adjust_size(size);
+    if (block->size() < adjusted + BLOCK_OVERHEAD + MIN_BLOCK_SIZE)
+        return;
+
+    // Turn the tail into a used block of its own, then free it so it merges forward
+    auto* rest   = reinterpret_cast<Block*>(static_cast<char*>(block->payload()) + adjusted);
+    rest->header = block->size() - adjusted - BLOCK_OVERHEAD;
+    block->set_size(adjusted);
+
+    free(rest->payload());
+};
+
+bool Tlsf::try_expand(void* ptr, const std::size_t size) {
+    Block*            block    = Block::from_payload(ptr);
+    const std::size_t adjusted = adjust_size(size);
+    if (block->size() >= adjusted)
+        return true;
+
+    Block* next = block->next();
+    if (!next->is_free() || block->size() + BLOCK_OVERHEAD + next->size() < adjusted)
+        return false;
+
+    remove(next);
+    block->set_size(block->size() + BLOCK_OVERHEAD + next->size());
+
+    split(block, adjusted);
+    block->mark_used();
+    return true;
+};
+
+std::size_t Tlsf::usable_size(const void* ptr) {
+    return Block::from_payload(ptr)->size();
+};
+
+std::size_t Tlsf::largest_free_block() const {
+    if (!m_fl_bitmap)
+        return 0;
+
+    // The highest non-empty bin holds the largest blocks, but not sorted
+    const std::size_t fl = 63 - __builtin_clzll(m_fl_bitmap);
+    const std::size_t sl = 31 - __builtin_clz(m_sl_bitmap[fl]);
+
+    std::size_t largest = 0;
+    for (const Block* block = m_blocks[fl][sl]; block; block = block->next_free) {
+        if (block->size() > largest)
+            largest = block->size();
+    };
+
+    return largest;
+};
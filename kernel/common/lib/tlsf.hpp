@@ -0,0 +1,85 @@
+#pragma once
+#include <common/std/stdint.hpp>
+
+// Two-Level Segregated Fit allocator.
+// Free blocks are binned by (first level = log2 size, second level = linear
+// subdivision of that range), with one bitmap per level so finding a fitting
+// bin is a couple of clz/ctz instructions. Every block carries a boundary tag,
+// freed blocks are merged with free neighbours immediately. All operations are
+// O(1) regardless of heap size or fragmentation.
+class Tlsf {
+public:
+    static constexpr std::size_t ALIGN_LOG2 = 4;
+    static constexpr std::size_t ALIGN      = 1 << ALIGN_LOG2;
+
+    // Each block has a 16-byte header in front of its payload
+    static constexpr std::size_t BLOCK_OVERHEAD = 16;
+
+    // Smallest region that can be given to add_pool() (first block + end sentinel)
+    static constexpr std::size_t MIN_POOL_SIZE = 2 * BLOCK_OVERHEAD + ALIGN;
+
+    constexpr Tlsf() = default;
+
+    Tlsf(const Tlsf&)            = delete;
+    Tlsf& operator=(const Tlsf&) = delete;
+
+    // Hands a memory region to the allocator. mem must be ALIGN aligned.
+    void add_pool(void* mem, std::size_t bytes);
+
+    // Returns nullptr if no free block is large enough
+    void* malloc(std::size_t size);
+    void  free(void* ptr);
+
+    // malloc with the payload aligned to align, a power of two. The block is cut
+    // out of a larger free one, and the gap in front is freed as a block of its
+    // own.
+    void* malloc_aligned(std::size_t size, std::size_t align);
+
+    // Shrinks a block in place, returning the tail to the free bins
+    void shrink(void* ptr, std::size_t size);
+
+    // Grows a block in place by absorbing its free physical successor.
+    // Returns false (leaving the block untouched) if that is not enough.
+    bool try_expand(void* ptr, std::size_t size);
+
+    [[nodiscard]] static std::size_t usable_size(const void* ptr);
+
+    [[nodiscard]] std::size_t free_bytes() const {
+        return m_free_bytes;
+    };
+
+    // Number of blocks sitting in the free bins
+    [[nodiscard]] std::size_t free_blocks() const {
+        return m_free_blocks;
+    };
+
+    // Payload size of the biggest free block, walks one bin
+    [[nodiscard]] std::size_t largest_free_block() const;
+
+private:
+    static constexpr std::size_t SL_INDEX_COUNT_LOG2 = 5;
+    static constexpr std::size_t SL_INDEX_COUNT      = 1 << SL_INDEX_COUNT_LOG2;
+    static constexpr std::size_t FL_INDEX_SHIFT      = SL_INDEX_COUNT_LOG2 + ALIGN_LOG2;
+    static constexpr std::size_t FL_INDEX_MAX        = 40; // Blocks up to 1 TiB
+    static constexpr std::size_t FL_INDEX_COUNT      = FL_INDEX_MAX - FL_INDEX_SHIFT + 1;
+    static constexpr std::size_t SMALL_BLOCK_SIZE    = 1 << FL_INDEX_SHIFT;
+
+    struct Block;
+
+    static void        mapping_insert(std::size_t size, std::size_t& fl, std::size_t& sl);
+    static void        mapping_search(std::size_t size, std::size_t& fl, std::size_t& sl);
+    static std::size_t adjust_size(std::size_t size);
+
+    std::uint64_t m_fl_bitmap{0};
+    std::uint32_t m_sl_bitmap[FL_INDEX_COUNT]{};
+    Block*        m_blocks[FL_INDEX_COUNT][SL_INDEX_COUNT]{};
+
+    std::size_t m_free_bytes{0};
+    std::size_t m_free_blocks{0};
+
+    Block* find_suitable(std::size_t& fl, std::size_t& sl) const;
+    void   insert(Block* block);
+    void   remove(Block* block);
+    Block* merge_neighbours(Block* block);
+    void   split(Block* block, std::size_t size);
+};
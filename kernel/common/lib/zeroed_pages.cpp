@@ -0,0 +1,117 @@
+#include "page_alloc.hpp"
+#include "memory.hpp"
+#include "thread.hpp"
+
+constexpr std::size_t ZEROING_STACK_SIZE = 16 * 1024;
+
+struct ZeroedPool {
+    void*       blocks[ZEROED_POOL_SIZE];
+    std::size_t count;
+};
+
+static ZeroedPool pools[MAX_NODES][MAX_ZEROED_ORDER + 1];
+static Thread     zeroing_thread;
+
+extern "C" void* alloc_zeroed_pages(const unsigned order, unsigned node) {
+    if (node >= MAX_NODES)
+        node = local_node();
+
+    if (order <= MAX_ZEROED_ORDER) {
+        const CpuLockScope guard(page_lock);
+
+        ZeroedPool& pool = pools[node][order];
+        if (pool.count)
+            return pool.blocks[--pool.count];
+    };
+
+    void* ptr = alloc_pages_node(order, node);
+    if (ptr)
+        memset(ptr, 0, PAGE_SIZE << order);
+
+    return ptr;
+};
+
+// Zeroes one block for the emptiest pool, false when every pool is full (or
+// its node is out of memory)
+static bool refill_one() {
+    ZeroedPool* target       = nullptr;
+    unsigned    target_node  = 0;
+    unsigned    target_order = 0;
+    for (unsigned node = 0; node < node_count(); ++node) {
+        for (unsigned order = 0; order <= MAX_ZEROED_ORDER; ++order) {
+            ZeroedPool& pool = pools[node][order];
+            if (pool.count < ZEROED_POOL_SIZE && (!target || pool.count < target->count)) {
+                target       = &pool;
+                target_node  = node;
+                target_order = order;
+            };
+        };
+    };
+
+    if (!target)
+        return false;
+
+    // Node-local pages only, a remote block would defeat the per-node pools
+    void* ptr = alloc_pages_on(target_order, target_node);
+    if (!ptr)
+        return false;
+
+    // Zeroing is preemptible; only the zeroing thread adds, so the pool can
+    // just have shrunk meanwhile
+    memset(ptr, 0, PAGE_SIZE << target_order);
+
+    const CpuLockScope guard(page_lock);
+    target->blocks[target->count++] = ptr;
+    return true;
+};
+
+// IDLE priority threads only run when nothing else is runnable, so the zeroing
+// happens in otherwise idle time. Yielding after every block keeps it from
+// holding the CPU once work shows up.
+static void zeroing_loop(void*) {
+    while (true) {
+        if (!refill_one())
+            asm volatile("wfe"); // Pools full, same as the idle threads
+
+        yield();
+    };
+};
+
+void start_page_zeroing() {
+    if (zeroing_thread.state != ThreadState::UNUSED)
+        return;
+
+    zeroing_thread.stack_size = ZEROING_STACK_SIZE;
+    zeroing_thread.stack      = stack_alloc(ZEROING_STACK_SIZE);
+    if (!zeroing_thread.stack)
+        return;
+
+    zeroing_thread.state = ThreadState::RUNNABLE;
+
+    spawn_thread(&zeroing_thread, zeroing_loop, nullptr, PRIORITY_IDLE);
+};
+
+bool drain_zeroed_pools() {
+    const CpuLockScope guard(page_lock);
+
+    bool drained = false;
+    for (auto& node : pools) {
+        for (ZeroedPool& pool : node) {
+            while (pool.count) {
+                free_pages(pool.blocks[--pool.count]);
+                drained = true;
+            };
+        };
+    };
+
+    return drained;
+};
+
+std::size_t zeroed_pool_count() {
+    std::size_t count = 0;
+    for (const auto& node : pools) {
+        for (const ZeroedPool& pool : node) count += pool.count;
+    };
+
+    return count;
+};
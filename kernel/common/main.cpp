@@ -1,4 +1,7 @@
 #include <common/lib/memory.hpp>
+#include <common/lib/page_alloc.hpp>
+#include <common/lib/task.hpp>
+#include <common/lib/thread_pool.hpp>
 #include <common/std/atomic.hpp>
 #include <common/std/limits.hpp>
 #include <common/std/print.hpp>
@@ -7,6 +10,12 @@
 #include <common/drivers/fdt.hpp>
 #include <common/drivers/virtio.hpp>
 
+#include <arch/aarch64/smp.hpp>
+
+#if PRISM_BENCH
+#include <common/bench/bench.hpp>
+#endif
+
 std::atomic<int> l{0};
 
 static Thread main_thread_obj;
@@ -15,11 +24,26 @@ extern "C" void kernel_main() {
     std::println("Main thread starting...");
     std::println("Max memory: {} MB", total_heap_size() / (1024 * 1024));
 
-    // We don't need to allocate a stack because we are ALREADY running on the boot stack.
-    // The scheduler just needs a place to save registers (ctx).
-    main_thread_obj.state = ThreadState::RUNNING;
-    main_thread_obj.stack = nullptr;          // Indicates we shouldn't delete this stack
-    current_thread        = &main_thread_obj; // Tell the scheduler "I am the current thread"
+    // Tell the scheduler "I am the current thread", on the boot stack
+    adopt_boot_thread(&main_thread_obj);
+
+    // Keeps a pool of zeroed pages filled whenever nothing else is runnable
+    start_page_zeroing();
+
+    // Returns detached threads to the thread pool once they exit
+    start_thread_reaper();
+
+    // Only now that static constructors have run, the other CPUs share them
+    const unsigned cpus = smp::start_secondaries();
+
+    // One executor thread per CPU resumes the coroutine tasks
+    start_executor(cpus);
+
+#if PRISM_BENCH
+    bench::run_memory();
+    bench::run_scheduler();
+    bench::run_parallel();
+#endif
 
     std::thread threads[4];
 
@@ -44,11 +68,8 @@ extern "C" void kernel_main() {
 };
 
 /*extern "C" void kernel_main() {
-    // We don't need to allocate a stack because we are ALREADY running on the boot stack.
-    // The scheduler just needs a place to save registers (ctx).
-    main_thread_obj.state = ThreadState::RUNNING;
-    main_thread_obj.stack = nullptr; // Indicates we shouldn't delete this stack
-    current_thread = &main_thread_obj; // Tell the scheduler "I am the current thread"
+    // Tell the scheduler "I am the current thread", on the boot stack
+    adopt_boot_thread(&main_thread_obj);
 
     // Find VirtIO Network Device (ID = 1)
     if (const std::uint64_t net_base = fdt::find_virtio_device(1); net_base != 0) {
@@ -61,7 +82,7 @@ extern "C" void kernel_main() {
     };
 
     while (true) {
+        virtio_net_wait();
         virtio_net_poll();
-        yield();
     };
 };*/
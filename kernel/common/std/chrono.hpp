@@ -0,0 +1,201 @@
+#ifndef STD_CHRONO_HPP
+#define STD_CHRONO_HPP
+#include "common/std/stdint.hpp"
+
+#include <arch/aarch64/cpu.hpp>
+
+namespace std {
+    template <std::int64_t Num, std::int64_t Den = 1>
+    struct ratio {
+        static constexpr std::int64_t num = Num;
+        static constexpr std::int64_t den = Den;
+    };
+
+    using nano  = ratio<1, 1'000'000'000>;
+    using micro = ratio<1, 1'000'000>;
+    using milli = ratio<1, 1'000>;
+
+    namespace chrono {
+        namespace detail {
+            constexpr std::int64_t gcd(const std::int64_t a, const std::int64_t b) {
+                return b ? gcd(b, a % b) : a;
+            };
+
+            // From one period to another as a reduced fraction, to keep the
+            // intermediate product small
+            template <typename From, typename To>
+            struct conversion {
+                static constexpr std::int64_t n   = From::num * To::den;
+                static constexpr std::int64_t d   = From::den * To::num;
+                static constexpr std::int64_t num = n / gcd(n, d);
+                static constexpr std::int64_t den = d / gcd(n, d);
+            };
+        } // namespace detail
+
+        template <typename Rep, typename Period = ratio<1>>
+        class duration {
+        public:
+            using rep    = Rep;
+            using period = Period;
+
+            constexpr duration() = default;
+
+            constexpr explicit duration(const Rep count) : m_count(count) {};
+
+            // Only to a unit that holds it exactly, duration_cast() for the rest
+            template <typename Rep2, typename Period2>
+            constexpr duration(const duration<Rep2, Period2>& other)
+                : m_count(other.count() * detail::conversion<Period2, Period>::num) {
+                static_assert(detail::conversion<Period2, Period>::den == 1,
+                              "std::chrono::duration: lossy conversion, use duration_cast");
+            };
+
+            [[nodiscard]] constexpr Rep count() const {
+                return m_count;
+            };
+
+            constexpr duration operator+(const duration other) const {
+                return duration(m_count + other.m_count);
+            };
+            constexpr duration operator-(const duration other) const {
+                return duration(m_count - other.m_count);
+            };
+
+            constexpr bool operator==(const duration other) const {
+                return m_count == other.m_count;
+            };
+            constexpr bool operator!=(const duration other) const {
+                return m_count != other.m_count;
+            };
+            constexpr bool operator<(const duration other) const {
+                return m_count < other.m_count;
+            };
+            constexpr bool operator<=(const duration other) const {
+                return m_count <= other.m_count;
+            };
+            constexpr bool operator>(const duration other) const {
+                return m_count > other.m_count;
+            };
+            constexpr bool operator>=(const duration other) const {
+                return m_count >= other.m_count;
+            };
+
+        private:
+            Rep m_count{};
+        };
+
+        // Truncates toward zero, like the standard one
+        template <typename To, typename Rep, typename Period>
+        constexpr To duration_cast(const duration<Rep, Period>& d) {
+            using Conversion = detail::conversion<Period, typename To::period>;
+            using ToRep      = typename To::rep;
+            return To(static_cast<ToRep>(d.count() * Conversion::num / Conversion::den));
+        };
+
+        using nanoseconds  = duration<std::int64_t, nano>;
+        using microseconds = duration<std::int64_t, micro>;
+        using milliseconds = duration<std::int64_t, milli>;
+        using seconds      = duration<std::int64_t>;
+        using minutes      = duration<std::int64_t, ratio<60>>;
+        using hours        = duration<std::int64_t, ratio<3600>>;
+
+        template <typename Clock, typename Duration = typename Clock::duration>
+        class time_point {
+        public:
+            using clock    = Clock;
+            using duration = Duration;
+
+            constexpr time_point() = default;
+
+            constexpr explicit time_point(const Duration since_epoch)
+                : m_since_epoch(since_epoch) {};
+
+            [[nodiscard]] constexpr Duration time_since_epoch() const {
+                return m_since_epoch;
+            };
+
+            constexpr time_point operator+(const Duration d) const {
+                return time_point(m_since_epoch + d);
+            };
+            constexpr time_point operator-(const Duration d) const {
+                return time_point(m_since_epoch - d);
+            };
+            constexpr Duration operator-(const time_point other) const {
+                return m_since_epoch - other.m_since_epoch;
+            };
+
+            constexpr bool operator==(const time_point other) const {
+                return m_since_epoch == other.m_since_epoch;
+            };
+            constexpr bool operator!=(const time_point other) const {
+                return m_since_epoch != other.m_since_epoch;
+            };
+            constexpr bool operator<(const time_point other) const {
+                return m_since_epoch < other.m_since_epoch;
+            };
+            constexpr bool operator<=(const time_point other) const {
+                return m_since_epoch <= other.m_since_epoch;
+            };
+            constexpr bool operator>(const time_point other) const {
+                return m_since_epoch > other.m_since_epoch;
+            };
+            constexpr bool operator>=(const time_point other) const {
+                return m_since_epoch >= other.m_since_epoch;
+            };
+
+        private:
+            Duration m_since_epoch{};
+        };
+
+        template <typename ToDuration, typename Clock, typename Duration>
+        constexpr time_point<Clock, ToDuration>
+        time_point_cast(const time_point<Clock, Duration>& t) {
+            const ToDuration since_epoch = duration_cast<ToDuration>(t.time_since_epoch());
+            return time_point<Clock, ToDuration>(since_epoch);
+        };
+
+        // CNTVCT_EL0, which starts at boot and never goes back
+        struct steady_clock {
+            using duration   = nanoseconds;
+            using rep        = duration::rep;
+            using period     = duration::period;
+            using time_point = chrono::time_point<steady_clock>;
+
+            static constexpr bool is_steady = true;
+
+            static time_point now() noexcept {
+                return time_point(duration(cpu::counter_to_ns(cpu::counter())));
+            };
+
+            // Kernel extension: the cpu::counter() value at t, the unit of
+            // kernel deadlines such as block_on_until()
+            static std::uint64_t to_counter(const time_point t) noexcept {
+                const rep ns = t.time_since_epoch().count();
+                return ns > 0 ? cpu::ns_to_counter(ns) : 0;
+            };
+        };
+    } // namespace chrono
+
+    // The standard suffixes, only the standard library may use them without an underscore
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wliteral-suffix"
+    inline namespace literals {
+        inline namespace chrono_literals {
+            constexpr chrono::nanoseconds operator""ns(const unsigned long long count) {
+                return chrono::nanoseconds(static_cast<std::int64_t>(count));
+            };
+            constexpr chrono::microseconds operator""us(const unsigned long long count) {
+                return chrono::microseconds(static_cast<std::int64_t>(count));
+            };
+            constexpr chrono::milliseconds operator""ms(const unsigned long long count) {
+                return chrono::milliseconds(static_cast<std::int64_t>(count));
+            };
+            constexpr chrono::seconds operator""s(const unsigned long long count) {
+                return chrono::seconds(static_cast<std::int64_t>(count));
+            };
+        } // namespace chrono_literals
+    } // namespace literals
+#pragma GCC diagnostic pop
+} // namespace std
+
+#endif // STD_CHRONO_HPP
@@ -0,0 +1,91 @@
+#ifndef STD_CONDITION_VARIABLE_HPP
+#define STD_CONDITION_VARIABLE_HPP
+#include "common/lib/thread.hpp"
+#include "common/std/chrono.hpp"
+#include "common/std/mutex.hpp"
+
+namespace std {
+    enum class cv_status { no_timeout, timeout };
+
+    class condition_variable {
+    public:
+        constexpr condition_variable() noexcept = default;
+
+        condition_variable(const condition_variable&) = delete;
+
+        condition_variable& operator=(const condition_variable&) = delete;
+
+        void notify_one() noexcept {
+            wake_one(m_waiters);
+        };
+
+        void notify_all() noexcept {
+            wake_all(m_waiters);
+        };
+
+        // The queue is locked before the mutex is released, so a notify can't slip
+        // in before this thread is on the queue and the wake-up can't be lost
+        void wait(unique_lock<mutex>& lock) {
+            {
+                const IrqSpinLockScope guard(m_waiters.lock);
+                lock.unlock();
+                block_on(m_waiters);
+            };
+
+            lock.lock();
+        };
+
+        template <typename Predicate>
+        void wait(unique_lock<mutex>& lock, Predicate predicate) {
+            while (!predicate()) {
+                wait(lock);
+            };
+        };
+
+        // Like wait(), with a timer wheel timeout at t
+        template <typename Duration>
+        cv_status wait_until(unique_lock<mutex>&                                      lock,
+                             const chrono::time_point<chrono::steady_clock, Duration>& t) {
+            const auto          ns       = chrono::time_point_cast<chrono::nanoseconds>(t);
+            const std::uint64_t deadline = chrono::steady_clock::to_counter(ns);
+
+            bool woken;
+            {
+                const IrqSpinLockScope guard(m_waiters.lock);
+                lock.unlock();
+                woken = block_on_until(m_waiters, deadline);
+            };
+
+            lock.lock();
+            return woken ? cv_status::no_timeout : cv_status::timeout;
+        };
+
+        template <typename Duration, typename Predicate>
+        bool wait_until(unique_lock<mutex>&                                      lock,
+                        const chrono::time_point<chrono::steady_clock, Duration>& t,
+                        Predicate                                                 predicate) {
+            while (!predicate()) {
+                if (wait_until(lock, t) == cv_status::timeout)
+                    return predicate();
+            };
+
+            return true;
+        };
+
+        template <typename Rep, typename Period>
+        cv_status wait_for(unique_lock<mutex>& lock, const chrono::duration<Rep, Period>& d) {
+            return wait_until(lock, chrono::steady_clock::now() + d);
+        };
+
+        template <typename Rep, typename Period, typename Predicate>
+        bool wait_for(unique_lock<mutex>& lock, const chrono::duration<Rep, Period>& d,
+                      Predicate predicate) {
+            return wait_until(lock, chrono::steady_clock::now() + d, predicate);
+        };
+
+    private:
+        WaitQueue m_waiters{};
+    };
+} // namespace std
+
+#endif // STD_CONDITION_VARIABLE_HPP
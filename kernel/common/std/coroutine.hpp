@@ -0,0 +1,196 @@
+#ifndef STD_COROUTINE_HPP
+#define STD_COROUTINE_HPP
+#include "common/std/stdint.hpp"
+
+// What the compiler needs to lower C++20 coroutines, over GCC's builtins. A
+// frame starts with its resume and destroy function pointers, which is all
+// noop_coroutine() relies on.
+namespace std {
+    template <typename Return, typename... Args>
+    struct coroutine_traits {
+        using promise_type = typename Return::promise_type;
+    };
+
+    template <typename Promise = void>
+    class coroutine_handle;
+
+    template <>
+    class coroutine_handle<void> {
+    public:
+        constexpr coroutine_handle() noexcept = default;
+
+        constexpr coroutine_handle(decltype(nullptr)) noexcept {};
+
+        coroutine_handle& operator=(decltype(nullptr)) noexcept {
+            m_frame = nullptr;
+            return *this;
+        };
+
+        [[nodiscard]] constexpr void* address() const noexcept {
+            return m_frame;
+        };
+
+        static constexpr coroutine_handle from_address(void* address) noexcept {
+            coroutine_handle handle;
+            handle.m_frame = address;
+            return handle;
+        };
+
+        constexpr explicit operator bool() const noexcept {
+            return m_frame != nullptr;
+        };
+
+        // Only for a handle suspended at a suspend point
+        [[nodiscard]] bool done() const noexcept {
+            return __builtin_coro_done(m_frame);
+        };
+
+        void operator()() const {
+            resume();
+        };
+        void resume() const {
+            __builtin_coro_resume(m_frame);
+        };
+        void destroy() const {
+            __builtin_coro_destroy(m_frame);
+        };
+
+    protected:
+        void* m_frame{nullptr};
+    };
+
+    template <typename Promise>
+    class coroutine_handle {
+    public:
+        constexpr coroutine_handle() noexcept = default;
+
+        constexpr coroutine_handle(decltype(nullptr)) noexcept {};
+
+        static coroutine_handle from_promise(Promise& promise) noexcept {
+            char*            address = reinterpret_cast<char*>(&promise);
+            coroutine_handle handle;
+            handle.m_frame = __builtin_coro_promise(address, __alignof(Promise), true);
+            return handle;
+        };
+
+        static constexpr coroutine_handle from_address(void* address) noexcept {
+            coroutine_handle handle;
+            handle.m_frame = address;
+            return handle;
+        };
+
+        constexpr operator coroutine_handle<>() const noexcept {
+            return coroutine_handle<>::from_address(m_frame);
+        };
+
+        [[nodiscard]] constexpr void* address() const noexcept {
+            return m_frame;
+        };
+
+        constexpr explicit operator bool() const noexcept {
+            return m_frame != nullptr;
+        };
+
+        [[nodiscard]] bool done() const noexcept {
+            return __builtin_coro_done(m_frame);
+        };
+
+        void operator()() const {
+            resume();
+        };
+        void resume() const {
+            __builtin_coro_resume(m_frame);
+        };
+        void destroy() const {
+            __builtin_coro_destroy(m_frame);
+        };
+
+        [[nodiscard]] Promise& promise() const {
+            void* promise = __builtin_coro_promise(m_frame, __alignof(Promise), false);
+            return *static_cast<Promise*>(promise);
+        };
+
+    private:
+        void* m_frame{nullptr};
+    };
+
+    constexpr bool operator==(const coroutine_handle<> a, const coroutine_handle<> b) noexcept {
+        return a.address() == b.address();
+    };
+
+    // A coroutine that does nothing when resumed and is never done, for an
+    // await_suspend() that has nothing to transfer to
+    struct noop_coroutine_promise {};
+
+    template <>
+    class coroutine_handle<noop_coroutine_promise> {
+    public:
+        constexpr operator coroutine_handle<>() const noexcept {
+            return coroutine_handle<>::from_address(m_frame);
+        };
+
+        constexpr explicit operator bool() const noexcept {
+            return true;
+        };
+
+        [[nodiscard]] constexpr bool done() const noexcept {
+            return false;
+        };
+
+        void operator()() const noexcept {};
+        void resume() const noexcept {};
+        void destroy() const noexcept {};
+
+        [[nodiscard]] noop_coroutine_promise& promise() const noexcept {
+            return s_frame.promise;
+        };
+
+        [[nodiscard]] constexpr void* address() const noexcept {
+            return m_frame;
+        };
+
+    private:
+        friend coroutine_handle noop_coroutine() noexcept;
+
+        // Laid out like a real frame, so resuming it through the builtins works too
+        struct Frame {
+            static void nothing() {};
+
+            void (*resume)()               = nothing;
+            void (*destroy)()              = nothing;
+            noop_coroutine_promise promise = {};
+        };
+
+        static Frame s_frame;
+
+        coroutine_handle() noexcept = default;
+
+        void* m_frame{&s_frame};
+    };
+
+    using noop_coroutine_handle = coroutine_handle<noop_coroutine_promise>;
+
+    inline noop_coroutine_handle::Frame noop_coroutine_handle::s_frame{};
+
+    inline noop_coroutine_handle noop_coroutine() noexcept {
+        return noop_coroutine_handle();
+    };
+
+    struct suspend_always {
+        constexpr bool await_ready() const noexcept {
+            return false;
+        };
+        constexpr void await_suspend(coroutine_handle<>) const noexcept {};
+        constexpr void await_resume() const noexcept {};
+    };
+
+    struct suspend_never {
+        constexpr bool await_ready() const noexcept {
+            return true;
+        };
+        constexpr void await_suspend(coroutine_handle<>) const noexcept {};
+        constexpr void await_resume() const noexcept {};
+    };
+} // namespace std
+
+#endif // STD_COROUTINE_HPP
@@ -166,4 +166,14 @@ namespace std {
         format_to(w, fmt, std::forward<Args>(args)...);
         return res;
     };
+
+    // Formats into a string backed by r, e.g. a scratch arena
+    template <typename... Args>
+    std::string format(pmr::memory_resource* r, const char* fmt, Args&&... args) {
+        std::string           res{r};
+        detail::string_writer w{res};
+
+        format_to(w, fmt, std::forward<Args>(args)...);
+        return res;
+    };
 }; // namespace std
\ No newline at end of file
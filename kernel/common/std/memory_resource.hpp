@@ -0,0 +1,222 @@
+#pragma once
+#include "new.hpp"
+#include "stdint.hpp"
+
+namespace std::pmr {
+    constexpr size_t DEFAULT_ALIGNMENT = 16; // Same guarantee as malloc
+
+    // Polymorphic allocator interface, containers allocate through a pointer to one
+    class memory_resource {
+    public:
+        virtual ~memory_resource() = default;
+
+        [[nodiscard]] void* allocate(const size_t bytes,
+                                     const size_t alignment = DEFAULT_ALIGNMENT) {
+            return do_allocate(bytes, alignment);
+        };
+
+        void deallocate(void* ptr, const size_t bytes, const size_t alignment = DEFAULT_ALIGNMENT) {
+            do_deallocate(ptr, bytes, alignment);
+        };
+
+        [[nodiscard]] bool is_equal(const memory_resource& other) const noexcept {
+            return do_is_equal(other);
+        };
+
+    private:
+        virtual void* do_allocate(size_t bytes, size_t alignment)              = 0;
+        virtual void  do_deallocate(void* ptr, size_t bytes, size_t alignment) = 0;
+        [[nodiscard]] virtual bool do_is_equal(const memory_resource& other) const noexcept {
+            return this == &other;
+        };
+    };
+
+    inline bool operator==(const memory_resource& a, const memory_resource& b) noexcept {
+        return &a == &b || a.is_equal(b);
+    };
+
+    inline bool operator!=(const memory_resource& a, const memory_resource& b) noexcept {
+        return !(a == b);
+    };
+
+    namespace detail {
+        // Global heap (lib/memory.cpp) through operator new/delete
+        class new_delete_resource final : public memory_resource {
+        private:
+            void* do_allocate(const size_t bytes, const size_t alignment) override {
+                if (alignment > DEFAULT_ALIGNMENT)
+                    return ::operator new(bytes, static_cast<align_val_t>(alignment));
+
+                return ::operator new(bytes);
+            };
+
+            void do_deallocate(void* ptr, const size_t bytes, const size_t alignment) override {
+                if (alignment > DEFAULT_ALIGNMENT)
+                    ::operator delete(ptr, bytes, static_cast<align_val_t>(alignment));
+                else
+                    ::operator delete(ptr, bytes);
+            };
+        };
+
+        // Fails every allocation, useful as upstream of a fixed buffer arena
+        class null_resource final : public memory_resource {
+        private:
+            void* do_allocate(size_t, size_t) override {
+                return nullptr;
+            };
+
+            void do_deallocate(void*, size_t, size_t) override {};
+        };
+
+        inline new_delete_resource new_delete_instance;
+        inline null_resource       null_instance;
+        inline memory_resource*    default_resource = &new_delete_instance;
+    }; // namespace detail
+
+    inline memory_resource* new_delete_resource() noexcept {
+        return &detail::new_delete_instance;
+    };
+
+    inline memory_resource* null_memory_resource() noexcept {
+        return &detail::null_instance;
+    };
+
+    inline memory_resource* get_default_resource() noexcept {
+        return detail::default_resource;
+    };
+
+    // Returns the previous default, nullptr restores new_delete_resource()
+    inline memory_resource* set_default_resource(memory_resource* r) noexcept {
+        memory_resource* old     = detail::default_resource;
+        detail::default_resource = r ? r : new_delete_resource();
+        return old;
+    };
+
+    // Bump-pointer arena. Memory comes from an optional initial buffer, then from
+    // geometrically growing chunks taken from upstream. deallocate() is a no-op;
+    // everything is dropped at once with reset() or release().
+    class monotonic_buffer_resource : public memory_resource {
+    private:
+        // Header at the start of every upstream chunk
+        struct Chunk {
+            Chunk* next;
+            size_t size; // Including this header
+        };
+
+        static constexpr size_t MIN_CHUNK_SIZE = 1024;
+        static constexpr size_t CHUNK_HEADER   = (sizeof(Chunk) + 15) & ~static_cast<size_t>(15);
+
+        memory_resource* m_upstream;
+        char*            m_initial_buffer = nullptr;
+        size_t           m_initial_size   = 0;
+        size_t           m_next_size      = MIN_CHUNK_SIZE;
+
+        Chunk* m_chunks  = nullptr; // Chunks in the order they are used
+        Chunk* m_current = nullptr; // nullptr while in the initial buffer
+        char*  m_ptr     = nullptr;
+        char*  m_end     = nullptr;
+
+        static char* align_ptr(char* ptr, const size_t alignment) {
+            const auto p = reinterpret_cast<uintptr_t>(ptr);
+            return reinterpret_cast<char*>((p + alignment - 1) & ~(alignment - 1));
+        };
+
+        void enter(Chunk* chunk) {
+            m_current = chunk;
+            m_ptr     = reinterpret_cast<char*>(chunk) + CHUNK_HEADER;
+            m_end     = reinterpret_cast<char*>(chunk) + chunk->size;
+        };
+
+        [[nodiscard]] static bool fits(const Chunk* chunk, const size_t bytes,
+                                       const size_t alignment) {
+            return chunk->size >= CHUNK_HEADER + bytes + alignment - 1;
+        };
+
+        void* do_allocate(const size_t bytes, const size_t alignment) override {
+            char* ptr = align_ptr(m_ptr, alignment);
+            if (m_ptr && ptr + bytes <= m_end) {
+                m_ptr = ptr + bytes;
+                return ptr;
+            };
+
+            // Chunks kept by reset() are reused before asking upstream
+            Chunk* next = m_current ? m_current->next : m_chunks;
+            if (!next || !fits(next, bytes, alignment)) {
+                size_t size = m_next_size;
+                while (size < CHUNK_HEADER + bytes + alignment - 1) size *= 2;
+
+                auto* chunk = static_cast<Chunk*>(m_upstream->allocate(size, DEFAULT_ALIGNMENT));
+                if (!chunk)
+                    return nullptr;
+
+                chunk->size = size;
+                chunk->next = next;
+                if (m_current)
+                    m_current->next = chunk;
+                else
+                    m_chunks = chunk;
+
+                m_next_size = size * 2;
+                next        = chunk;
+            };
+
+            enter(next);
+            ptr   = align_ptr(m_ptr, alignment);
+            m_ptr = ptr + bytes;
+            return ptr;
+        };
+
+        void do_deallocate(void*, size_t, size_t) override {};
+
+    public:
+        explicit monotonic_buffer_resource(memory_resource* upstream = get_default_resource())
+            : m_upstream(upstream) {};
+
+        monotonic_buffer_resource(const size_t initial_size,
+                                  memory_resource* upstream = get_default_resource())
+            : m_upstream(upstream),
+              m_next_size(initial_size > MIN_CHUNK_SIZE ? initial_size : MIN_CHUNK_SIZE) {};
+
+        monotonic_buffer_resource(void* buffer, const size_t size,
+                                  memory_resource* upstream = get_default_resource())
+            : m_upstream(upstream), m_initial_buffer(static_cast<char*>(buffer)),
+              m_initial_size(size), m_ptr(static_cast<char*>(buffer)),
+              m_end(static_cast<char*>(buffer) + size) {};
+
+        monotonic_buffer_resource(const monotonic_buffer_resource&)            = delete;
+        monotonic_buffer_resource& operator=(const monotonic_buffer_resource&) = delete;
+
+        ~monotonic_buffer_resource() override {
+            release();
+        };
+
+        // Drops every allocation in O(1). The chunks stay owned by the arena and
+        // are handed out again, so a steady workload stops touching upstream.
+        void reset() {
+            if (m_initial_buffer || !m_chunks) {
+                m_current = nullptr;
+                m_ptr     = m_initial_buffer;
+                m_end     = m_initial_buffer + m_initial_size;
+            }
+            else {
+                enter(m_chunks);
+            };
+        };
+
+        // Drops every allocation and returns the chunks to upstream
+        void release() {
+            while (m_chunks) {
+                Chunk* next = m_chunks->next;
+                m_upstream->deallocate(m_chunks, m_chunks->size, DEFAULT_ALIGNMENT);
+                m_chunks = next;
+            };
+
+            m_current = nullptr;
+            reset();
+        };
+
+        [[nodiscard]] memory_resource* upstream_resource() const {
+            return m_upstream;
+        };
+    };
+}; // namespace std::pmr
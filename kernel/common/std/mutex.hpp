@@ -0,0 +1,125 @@
+#ifndef STD_MUTEX_HPP
+#define STD_MUTEX_HPP
+#include "common/cppruntime_support.hpp" // For panic()
+#include "common/lib/thread.hpp"
+
+namespace std {
+    // A sleeping lock: contended lock() calls park on a wait queue instead of
+    // spinning through yield()
+    class mutex {
+    public:
+        constexpr mutex() noexcept = default;
+
+        mutex(const mutex&) = delete;
+
+        mutex& operator=(const mutex&) = delete;
+
+        void lock() {
+            const IrqSpinLockScope guard(m_waiters.lock); // Test and set as one step
+
+            if (m_owner == current_thread())
+                panic("std::mutex: recursive lock!");
+
+            // A woken waiter retries, so a thread that gets here first may still
+            // take the lock
+            while (m_owner) {
+                block_on(m_waiters);
+            };
+
+            m_owner = current_thread();
+        };
+
+        [[nodiscard]] bool try_lock() noexcept {
+            const IrqSpinLockScope guard(m_waiters.lock);
+
+            if (m_owner)
+                return false;
+
+            m_owner = current_thread();
+            return true;
+        };
+
+        void unlock() {
+            if (m_owner != current_thread())
+                panic("std::mutex: unlocked by a thread that doesn't own it!");
+
+            {
+                const IrqSpinLockScope guard(m_waiters.lock);
+                m_owner = nullptr;
+            };
+
+            wake_one(m_waiters);
+        };
+
+    private:
+        Thread*   m_owner{nullptr};
+        WaitQueue m_waiters{};
+    };
+
+    struct defer_lock_t {
+        explicit defer_lock_t() = default;
+    };
+
+    inline constexpr defer_lock_t defer_lock{};
+
+    template <typename Mutex>
+    class lock_guard {
+    public:
+        explicit lock_guard(Mutex& m) : m_mutex(m) {
+            m_mutex.lock();
+        };
+
+        ~lock_guard() {
+            m_mutex.unlock();
+        };
+
+        lock_guard(const lock_guard&) = delete;
+
+        lock_guard& operator=(const lock_guard&) = delete;
+
+    private:
+        Mutex& m_mutex;
+    };
+
+    template <typename Mutex>
+    class unique_lock {
+    public:
+        explicit unique_lock(Mutex& m) : m_mutex(&m) {
+            lock();
+        };
+
+        unique_lock(Mutex& m, defer_lock_t) noexcept : m_mutex(&m) {};
+
+        ~unique_lock() {
+            if (m_owns)
+                m_mutex->unlock();
+        };
+
+        unique_lock(const unique_lock&) = delete;
+
+        unique_lock& operator=(const unique_lock&) = delete;
+
+        void lock() {
+            m_mutex->lock();
+            m_owns = true;
+        };
+
+        void unlock() {
+            m_mutex->unlock();
+            m_owns = false;
+        };
+
+        [[nodiscard]] bool owns_lock() const noexcept {
+            return m_owns;
+        };
+        [[nodiscard]] Mutex* mutex() const noexcept {
+            return m_mutex;
+        };
+
+    private:
+        Mutex* m_mutex;
+        bool   m_owns{false};
+    };
+} // namespace std
+
+#endif // STD_MUTEX_HPP
@@ -0,0 +1,22 @@
+#pragma once
+#include "stdint.hpp"
+
+namespace std {
+    // Alignment tag used by the compiler for over-aligned new/delete
+    enum class align_val_t : size_t {};
+}; // namespace std
+
+void* operator new(std::size_t size, std::align_val_t align);
+void* operator new[](std::size_t size, std::align_val_t align);
+void  operator delete(void* ptr, std::align_val_t align) noexcept;
+void  operator delete(void* ptr, std::size_t size, std::align_val_t align) noexcept;
+void  operator delete[](void* ptr, std::align_val_t align) noexcept;
+void  operator delete[](void* ptr, std::size_t size, std::align_val_t align) noexcept;
+
+// Placement new: constructs in storage the caller already owns
+inline void* operator new(std::size_t, void* ptr) noexcept {
+    return ptr;
+};
+inline void* operator new[](std::size_t, void* ptr) noexcept {
+    return ptr;
+};
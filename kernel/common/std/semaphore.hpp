@@ -0,0 +1,89 @@
+#ifndef STD_SEMAPHORE_HPP
+#define STD_SEMAPHORE_HPP
+#include "common/cppruntime_support.hpp" // For panic()
+#include "common/lib/thread.hpp"
+#include "common/std/chrono.hpp"
+#include "common/std/stdint.hpp"
+
+namespace std {
+    template <std::ptrdiff_t LeastMaxValue = 0x7fffffff>
+    class counting_semaphore {
+    public:
+        static constexpr std::ptrdiff_t max() noexcept {
+            return LeastMaxValue;
+        };
+
+        constexpr explicit counting_semaphore(const std::ptrdiff_t desired)
+            : m_count(desired) {};
+
+        counting_semaphore(const counting_semaphore&) = delete;
+
+        counting_semaphore& operator=(const counting_semaphore&) = delete;
+
+        void release(const std::ptrdiff_t update = 1) {
+            {
+                const IrqSpinLockScope guard(m_waiters.lock);
+
+                if (update < 0 || update > max() - m_count)
+                    panic("std::counting_semaphore: release past max()!");
+
+                m_count += update;
+            };
+
+            for (std::ptrdiff_t i = 0; i < update; ++i) {
+                if (!wake_one(m_waiters))
+                    break;
+            };
+        };
+
+        void acquire() {
+            const IrqSpinLockScope guard(m_waiters.lock);
+
+            while (m_count == 0) {
+                block_on(m_waiters);
+            };
+
+            m_count--;
+        };
+
+        [[nodiscard]] bool try_acquire() noexcept {
+            const IrqSpinLockScope guard(m_waiters.lock);
+
+            if (m_count == 0)
+                return false;
+
+            m_count--;
+            return true;
+        };
+
+        template <typename Duration>
+        [[nodiscard]] bool
+        try_acquire_until(const chrono::time_point<chrono::steady_clock, Duration>& t) {
+            const auto             ns       = chrono::time_point_cast<chrono::nanoseconds>(t);
+            const std::uint64_t    deadline = chrono::steady_clock::to_counter(ns);
+            const IrqSpinLockScope guard(m_waiters.lock);
+
+            while (m_count == 0) {
+                // A release() may have landed just as the timeout fired
+                if (!block_on_until(m_waiters, deadline) && m_count == 0)
+                    return false;
+            };
+
+            m_count--;
+            return true;
+        };
+
+        template <typename Rep, typename Period>
+        [[nodiscard]] bool try_acquire_for(const chrono::duration<Rep, Period>& d) {
+            return try_acquire_until(chrono::steady_clock::now() + d);
+        };
+
+    private:
+        std::ptrdiff_t m_count;
+        WaitQueue      m_waiters{};
+    };
+
+    using binary_semaphore = counting_semaphore<1>;
+} // namespace std
+
+#endif // STD_SEMAPHORE_HPP
@@ -1,12 +1,16 @@
 #pragma once
+#include "common/lib/cstring.hpp"
+#include "common/lib/memory.hpp"
+#include "memory_resource.hpp"
 #include "stdint.hpp"
 
 namespace std {
     class string {
     private:
-        char*  data{};
-        size_t length{0};
-        size_t capacity{0};
+        char*                 data{};
+        size_t                length{0};
+        size_t                capacity{0};
+        pmr::memory_resource* resource{pmr::get_default_resource()};
 
         // Geometric growth to prevent heap fragmentation
         // Returns the next power of 2 or adequate size
@@ -17,16 +21,40 @@ namespace std {
             return new_cap;
         };
 
+        [[nodiscard]] char* allocate(const size_t size) const {
+            return static_cast<char*>(resource->allocate(size, 1));
+        };
+
+        void deallocate() {
+            if (data != nullptr)
+                resource->deallocate(data, capacity, 1);
+        };
+
+        void copy_from(const string& other) {
+            capacity   = other.capacity ? other.capacity : 16;
+            length     = other.length;
+            this->data = allocate(capacity);
+            std::memcpy(this->data, other.data, length);
+            this->data[length] = '\0';
+        };
+
     public:
         string() : capacity(16) {
-            this->data    = new char[this->capacity];
+            this->data    = allocate(this->capacity);
+            this->data[0] = '\0';
+        };
+
+        // Allocates from r instead of the default resource, e.g. a scratch arena
+        explicit string(pmr::memory_resource* r) : capacity(16), resource(r) {
+            this->data    = allocate(this->capacity);
             this->data[0] = '\0';
         };
 
-        explicit string(const char* s) {
+        explicit string(const char* s, pmr::memory_resource* r = pmr::get_default_resource())
+            : resource(r) {
             if (!s) {
                 capacity = 16;
-                data     = new char[capacity];
+                data     = allocate(capacity);
                 data[0]  = '\0';
             }
             else {
@@ -35,41 +63,44 @@ namespace std {
         };
 
         // Copy Constructor
-        string(const string& other) : length(other.length), capacity(other.capacity) {
-            this->data = new char[capacity];
-            for (size_t i = 0; i <= length; i++) this->data[i] = other.data[i];
+        // Copies go to the default resource so they can outlive the source's arena
+        string(const string& other) {
+            copy_from(other);
+        };
+
+        string(const string& other, pmr::memory_resource* r) : resource(r) {
+            copy_from(other);
         };
 
         // Move Constructor
         string(string&& other) noexcept
-            : data(other.data), length(other.length), capacity(other.capacity) {
+            : data(other.data), length(other.length), capacity(other.capacity),
+              resource(other.resource) {
             other.data     = nullptr;
             other.length   = 0;
             other.capacity = 0;
         };
 
         ~string() {
-            if (data != nullptr)
-                delete[] data;
+            deallocate();
         };
 
         // Operators
         string& operator=(const string& other) {
             if (this != &other) {
-                const auto new_data = new char[other.capacity];
-                for (size_t i = 0; i <= other.length; i++) new_data[i] = other.data[i];
-
-                delete[] data;
-                data     = new_data;
-                length   = other.length;
-                capacity = other.capacity;
+                deallocate();
+                copy_from(other);
             };
             return *this;
         };
 
         string& operator=(string&& other) noexcept {
+            // Memory from another resource can't be adopted, copy it instead
+            if (*resource != *other.resource)
+                return *this = static_cast<const string&>(other);
+
             if (this != &other) {
-                delete[] data;
+                deallocate();
                 data     = other.data;
                 length   = other.length;
                 capacity = other.capacity;
@@ -96,18 +127,25 @@ namespace std {
         [[nodiscard]] bool empty() const {
             return length == 0;
         };
+        [[nodiscard]] pmr::memory_resource* get_resource() const {
+            return resource;
+        };
 
         // Core Logic
         void resize(const size_t new_cap) {
             if (new_cap <= capacity)
                 return;
 
-            const auto new_data = new char[new_cap];
+            // Grow in place when the heap has free memory right behind us
+            if (data && resource == pmr::new_delete_resource() && try_expand(data, new_cap)) {
+                capacity = new_cap;
+                return;
+            };
+
+            const auto new_data = allocate(new_cap);
             if (data) {
-                for (size_t i = 0; i <= length; ++i) {
-                    new_data[i] = data[i];
-                };
-                delete[] data;
+                std::memcpy(new_data, data, length + 1);
+                deallocate();
             }
             else {
                 new_data[0] = '\0';
@@ -129,15 +167,12 @@ namespace std {
             if (!s)
                 return;
 
-            size_t s_len = 0;
-            while (s[s_len]) s_len++; // Manual strlen
+            const size_t s_len = strlen(s);
 
             if (length + s_len >= capacity)
                 resize(recommend_size(length + s_len));
 
-            for (size_t i = 0; i < s_len; ++i) {
-                data[length + i] = s[i];
-            };
+            std::memcpy(data + length, s, s_len);
 
             length       += s_len;
             data[length]  = '\0';
@@ -150,9 +185,7 @@ namespace std {
             if (length + other.length >= capacity)
                 resize(recommend_size(length + other.length));
 
-            for (size_t i = 0; i < other.length; ++i) {
-                data[length + i] = other.data[i];
-            };
+            std::memcpy(data + length, other.data, other.length);
 
             length       += other.length;
             data[length]  = '\0';
@@ -2,6 +2,8 @@
 #define STD_THREAD_HPP
 #include "common/cppruntime_support.hpp" // For panic()
 #include "common/lib/thread.hpp"
+#include "common/lib/thread_pool.hpp"
+#include "common/std/chrono.hpp"
 #include "common/std/utility.hpp"
 
 namespace std {
@@ -20,6 +22,10 @@ namespace std {
         typedef T type;
     };
 
+    // Callables up to this size are kept at the top of the new thread's stack
+    // instead of on the heap
+    constexpr std::size_t THREAD_INLINE_CALLABLE_SIZE = 256;
+
     class thread {
     public:
         using native_handle_type = Thread*;
@@ -30,7 +36,14 @@ namespace std {
         // Usage: std::thread t([=] { my_func(10); });
         template <typename Callable>
         explicit thread(Callable&& f) {
-            start_thread(std::forward<Callable>(f));
+            start_thread(std::forward<Callable>(f), PRIORITY_DEFAULT);
+        };
+
+        // Kernel extension: start at a given priority (PRIORITY_IDLE..PRIORITY_MAX)
+        // Usage: std::thread t(PRIORITY_HIGH, [=] { poll_network(); });
+        template <typename Callable>
+        thread(const unsigned priority, Callable&& f) {
+            start_thread(std::forward<Callable>(f), priority);
         };
 
         // Move Constructor
@@ -66,14 +79,11 @@ namespace std {
             if (!joinable())
                 return;
 
-            // Wait for DEAD state
-            while (m_handle->state != ThreadState::DEAD) {
-                yield();
-            };
+            // Sleep until exit_thread() wakes us, off the run queue
+            join_thread(m_handle);
 
-            // Clean up kernel resources
-            delete[] m_handle->stack;
-            delete m_handle;
+            // Thread and stack go back to the pool for the next std::thread
+            thread_pool_release(m_handle);
             m_handle = nullptr;
         };
 
@@ -81,6 +91,8 @@ namespace std {
             if (!joinable())
                 return;
 
+            // The reaper returns it to the pool once it exits
+            detach_thread(m_handle);
             m_handle = nullptr;
         };
 
@@ -91,35 +103,75 @@ namespace std {
             return m_handle;
         };
 
+        void set_priority(const unsigned priority) {
+            if (joinable())
+                ::set_priority(m_handle, priority);
+        };
+
     private:
         native_handle_type m_handle{nullptr};
 
-        // Helper to move the lambda to the heap and cast to void*
+        // Helper to move the lambda somewhere it outlives this scope and cast to void*
         template <typename Callable>
-        void start_thread(Callable&& f) {
-            // Allocate Kernel Thread
-            m_handle             = new Thread();
-            m_handle->stack_size = 64 * 1024; // 64 KB
-            m_handle->stack      = new uint8_t[m_handle->stack_size];
+        void start_thread(Callable&& f, const unsigned priority) {
+            // A recycled Thread and stack when the pool has one
+            // 64 KB of address space, pages are only committed as they are touched
+            m_handle = thread_pool_acquire();
+            if (!m_handle)
+                panic("std::thread: out of stack space");
 
-            // Move the lambda to the heap so it survives this scope
             // 'Decay' ensures we store the object, not a reference
             using DecayedCallable = typename remove_reference<Callable>::type;
-            auto* heap_callable   = new DecayedCallable(std::forward<Callable>(f));
-
-            spawn_thread(m_handle, &thread_entry_point<DecayedCallable>, heap_callable);
+            constexpr bool fits   = sizeof(DecayedCallable) <= THREAD_INLINE_CALLABLE_SIZE &&
+                                    alignof(DecayedCallable) <= 16;
+
+            if constexpr (fits) {
+                void* storage  = reserve_stack_top(m_handle, sizeof(DecayedCallable));
+                auto* callable = new (storage) DecayedCallable(std::forward<Callable>(f));
+                spawn_thread(m_handle, &thread_entry_point<DecayedCallable, true>, callable,
+                             priority);
+            }
+            else {
+                auto* callable = new DecayedCallable(std::forward<Callable>(f));
+                spawn_thread(m_handle, &thread_entry_point<DecayedCallable, false>, callable,
+                             priority);
+            };
         };
 
         // Static Trampoline to cast void* back to Lambda*
-        template <typename T>
+        template <typename T, bool Inline>
         static void thread_entry_point(void* arg) {
             auto* callable = static_cast<T*>(arg);
             (*callable)();
 
-            delete callable;
+            if constexpr (Inline)
+                callable->~T();
+            else
+                delete callable;
             // Return to kernel trampoline (which sets thread to DEAD)
         };
     };
+    namespace this_thread {
+        inline void yield() noexcept {
+            ::yield();
+        };
+
+        // Sleeps off the run queue, woken by this CPU's timer wheel
+        template <typename Rep, typename Period>
+        void sleep_for(const chrono::duration<Rep, Period>& d) {
+            const std::int64_t ns = chrono::duration_cast<chrono::nanoseconds>(d).count();
+            if (ns <= 0)
+                return;
+
+            ::sleep_until(cpu::counter() + cpu::ns_to_counter(ns));
+        };
+
+        template <typename Duration>
+        void sleep_until(const chrono::time_point<chrono::steady_clock, Duration>& t) {
+            ::sleep_until(chrono::steady_clock::to_counter(
+                chrono::time_point_cast<chrono::nanoseconds>(t)));
+        };
+    } // namespace this_thread
 } // namespace std
 
 #endif // STD_THREAD_HPP
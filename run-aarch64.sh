@@ -28,6 +28,7 @@ fi
 qemu-system-aarch64 \
     -machine virt \
     -cpu cortex-a53 \
+    -smp "${SMP:-4}" \
     -nographic \
     -serial mon:stdio \
     -m 4G \
@@ -0,0 +1,19 @@
+#pragma once
+#include <cstddef>
+
+// An allocator the trace can be replayed against. To evaluate a candidate,
+// compile it natively, wrap it in these hooks and add it to ALLOCATORS in
+// allocators.cpp. Every replay runs in a fresh process.
+struct Allocator {
+    const char* name;
+    void (*init)(std::size_t arena_bytes);
+    void* (*malloc)(std::size_t size);
+    void* (*aligned_alloc)(std::size_t alignment, std::size_t size);
+    void* (*realloc)(void* ptr, std::size_t size);
+    void (*free)(void* ptr);
+    std::size_t (*footprint)(); // Bytes currently taken from the system
+    int (*fragmentation)();     // External fragmentation in percent, -1 if unknown
+};
+
+extern const Allocator   ALLOCATORS[];
+extern const std::size_t ALLOCATOR_COUNT;
@@ -0,0 +1,50 @@
+#include "allocator.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <malloc.h>
+#include <sys/mman.h>
+
+// prismOS heap (kernel/common/lib), see prism_heap.cpp
+extern "C" {
+    void        prism_heap_init(void* base, std::size_t size);
+    std::size_t prism_heap_footprint();
+    int         prism_heap_fragmentation();
+    void*       prism_malloc(std::size_t size);
+    void*       prism_aligned_alloc(std::size_t alignment, std::size_t size);
+    void*       prism_realloc(void* ptr, std::size_t size);
+    void        prism_free(void* ptr);
+}
+
+static void prism_init(const std::size_t arena_bytes) {
+    // Stands in for the RAM the kernel gets from the FDT
+    void* arena = mmap(nullptr, arena_bytes, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (arena == MAP_FAILED) {
+        std::perror("mmap");
+        std::exit(1);
+    };
+
+    prism_heap_init(arena, arena_bytes);
+};
+
+// Host glibc malloc, as a reference point
+static void system_init(std::size_t) {};
+
+static std::size_t system_footprint() {
+    const struct mallinfo2 info = mallinfo2();
+    return info.arena + info.hblkhd;
+};
+
+static int system_fragmentation() {
+    return -1;
+};
+
+const Allocator ALLOCATORS[] = {
+    {"prism", prism_init, prism_malloc, prism_aligned_alloc, prism_realloc, prism_free,
+     prism_heap_footprint, prism_heap_fragmentation},
+    {"system", system_init, std::malloc, std::aligned_alloc, std::realloc, std::free,
+     system_footprint, system_fragmentation},
+};
+
+const std::size_t ALLOCATOR_COUNT = sizeof(ALLOCATORS) / sizeof(ALLOCATORS[0]);
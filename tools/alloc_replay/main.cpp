@@ -0,0 +1,272 @@
+// Replays an allocation trace dumped by heap_trace_dump() against the kernel
+// allocator and any candidate in allocators.cpp.
+//
+//   alloc_replay <serial log> [--arena-mib N] [--only NAME]
+#include "allocator.hpp"
+#include "trace.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+// A trace record with the pointer ids resolved to dense slots, so the replay
+// loop itself does no hashing
+struct ReplayOp {
+    TraceOp       op;
+    std::uint32_t slot;
+    std::uint32_t size;
+    std::uint32_t alignment;
+};
+
+struct ReplayPlan {
+    std::vector<ReplayOp> ops;
+    std::size_t           slots     = 0;
+    std::size_t           unmatched = 0; // Frees/reallocs of pointers allocated before the trace
+    std::size_t           counts[5] = {};
+};
+
+struct Result {
+    bool        ok;
+    double      seconds;
+    std::size_t peak_live;
+    std::size_t peak_footprint;
+    std::size_t final_live;
+    std::size_t final_footprint;
+    int         fragmentation;
+};
+
+static ReplayPlan plan_replay(const Trace& trace) {
+    ReplayPlan                                   plan;
+    std::unordered_map<std::uint32_t, std::uint32_t> live; // id -> slot
+
+    for (const TraceRecord& record : trace.records) {
+        ReplayOp op{record.op, 0, record.size, 1u << record.align_log2};
+
+        switch (record.op) {
+        case TraceOp::MALLOC:
+        case TraceOp::ALIGNED_ALLOC:
+            op.slot         = plan.slots++;
+            live[record.id] = op.slot;
+            break;
+
+        case TraceOp::FREE: {
+            const auto it = live.find(record.id);
+            if (it == live.end()) {
+                plan.unmatched++;
+                continue;
+            };
+
+            op.slot = it->second;
+            live.erase(it);
+            break;
+        };
+
+        case TraceOp::REALLOC: {
+            const auto it = live.find(record.old_id);
+            if (it == live.end()) {
+                // The original allocation predates the trace, start from scratch
+                plan.unmatched++;
+                op.op   = TraceOp::MALLOC;
+                op.slot = plan.slots++;
+            }
+            else {
+                op.slot = it->second;
+                live.erase(it);
+            };
+
+            live[record.id] = op.slot;
+            break;
+        };
+
+        default:
+            continue;
+        };
+
+        plan.counts[static_cast<int>(op.op)]++;
+        plan.ops.push_back(op);
+    };
+
+    return plan;
+};
+
+// Runs in a child so every allocator starts from a fresh process. With measure
+// set, the footprint is sampled after every operation, which skews timing, so
+// throughput comes from a separate unmeasured run.
+static Result replay(const Allocator& allocator, const ReplayPlan& plan,
+                     const std::size_t arena_bytes, const bool measure) {
+    Result                    result{};
+    std::vector<void*>        slots(plan.slots, nullptr);
+    std::vector<std::uint32_t> sizes(measure ? plan.slots : 0, 0);
+
+    allocator.init(arena_bytes);
+    const std::size_t baseline = allocator.footprint();
+
+    std::size_t live  = 0;
+    const auto  start = std::chrono::steady_clock::now();
+    for (const ReplayOp& op : plan.ops) {
+        void*& ptr = slots[op.slot];
+
+        switch (op.op) {
+        case TraceOp::MALLOC:
+            ptr = allocator.malloc(op.size);
+            break;
+        case TraceOp::ALIGNED_ALLOC:
+            ptr = allocator.aligned_alloc(op.alignment, op.size);
+            break;
+        case TraceOp::REALLOC:
+            ptr = allocator.realloc(ptr, op.size);
+            break;
+        case TraceOp::FREE:
+            allocator.free(ptr);
+            ptr = nullptr;
+            break;
+        };
+
+        if (op.op != TraceOp::FREE) {
+            if (!ptr && op.size)
+                return result; // Out of memory
+
+            // Touch the block, as the real caller would
+            if (op.size)
+                static_cast<volatile char*>(ptr)[0] = 0;
+        };
+
+        if (measure) {
+            live -= sizes[op.slot];
+            sizes[op.slot]  = op.op == TraceOp::FREE ? 0 : op.size;
+            live           += sizes[op.slot];
+
+            const std::size_t footprint = allocator.footprint() - baseline;
+            if (footprint > result.peak_footprint)
+                result.peak_footprint = footprint;
+            if (live > result.peak_live)
+                result.peak_live = live;
+        };
+    };
+
+    result.seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.final_live      = live;
+    result.final_footprint = allocator.footprint() - baseline;
+    result.fragmentation   = allocator.fragmentation();
+    result.ok              = true;
+    return result;
+};
+
+static bool replay_in_child(const Allocator& allocator, const ReplayPlan& plan,
+                            const std::size_t arena_bytes, const bool measure, Result& result) {
+    int fds[2];
+    if (pipe(fds) != 0)
+        return false;
+
+    const pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        const Result child = replay(allocator, plan, arena_bytes, measure);
+        const bool   sent  = write(fds[1], &child, sizeof(child)) == sizeof(child);
+        _exit(sent ? 0 : 1);
+    };
+
+    close(fds[1]);
+    const bool received = read(fds[0], &result, sizeof(result)) == sizeof(result);
+    close(fds[0]);
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return received && WIFEXITED(status) && WEXITSTATUS(status) == 0 && result.ok;
+};
+
+static double mib(const std::size_t bytes) {
+    return static_cast<double>(bytes) / (1024.0 * 1024.0);
+};
+
+int main(const int argc, char** argv) {
+    const char* path        = nullptr;
+    const char* only        = nullptr;
+    std::size_t arena_bytes = 1024ull << 20;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--arena-mib") == 0 && i + 1 < argc)
+            arena_bytes = std::strtoull(argv[++i], nullptr, 10) << 20;
+        else if (std::strcmp(argv[i], "--only") == 0 && i + 1 < argc)
+            only = argv[++i];
+        else if (!path && argv[i][0] != '-')
+            path = argv[i];
+        else {
+            std::fprintf(stderr, "usage: %s <serial log> [--arena-mib N] [--only NAME]\n",
+                         argv[0]);
+            return 2;
+        };
+    };
+
+    if (!path) {
+        std::fprintf(stderr, "usage: %s <serial log> [--arena-mib N] [--only NAME]\n", argv[0]);
+        return 2;
+    };
+
+    Trace       trace;
+    std::string error;
+    if (!load_trace(path, trace, error)) {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    };
+
+    const ReplayPlan plan = plan_replay(trace);
+
+    std::printf("trace: %zu records (%llu dropped by the ring)", trace.records.size(),
+                static_cast<unsigned long long>(trace.dropped));
+    if (trace.frequency && trace.records.size() > 1) {
+        const double span = static_cast<double>(trace.records.back().timestamp -
+                                                trace.records.front().timestamp) /
+                            static_cast<double>(trace.frequency);
+        std::printf(", %.3f s of kernel time", span);
+    };
+
+    std::printf("\n  malloc %zu, free %zu, realloc %zu, aligned_alloc %zu, unmatched %zu\n\n",
+                plan.counts[static_cast<int>(TraceOp::MALLOC)],
+                plan.counts[static_cast<int>(TraceOp::FREE)],
+                plan.counts[static_cast<int>(TraceOp::REALLOC)],
+                plan.counts[static_cast<int>(TraceOp::ALIGNED_ALLOC)], plan.unmatched);
+
+    std::printf("%-10s %12s %14s %14s %10s %14s %6s\n", "allocator", "Mops/s", "peak live MiB",
+                "peak fp MiB", "overhead", "final fp MiB", "frag");
+
+    int failures = 0;
+    for (std::size_t i = 0; i < ALLOCATOR_COUNT; ++i) {
+        const Allocator& allocator = ALLOCATORS[i];
+        if (only && std::strcmp(only, allocator.name) != 0)
+            continue;
+
+        Result timed, measured;
+        if (!replay_in_child(allocator, plan, arena_bytes, false, timed) ||
+            !replay_in_child(allocator, plan, arena_bytes, true, measured)) {
+            std::printf("%-10s failed (out of memory or crashed)\n", allocator.name);
+            failures++;
+            continue;
+        };
+
+        const double mops     = timed.seconds > 0
+                                    ? static_cast<double>(plan.ops.size()) / timed.seconds / 1e6
+                                    : 0.0;
+        const double overhead = measured.peak_live
+                                    ? static_cast<double>(measured.peak_footprint) /
+                                          static_cast<double>(measured.peak_live)
+                                    : 0.0;
+
+        char fragmentation[16] = "n/a";
+        if (measured.fragmentation >= 0)
+            std::snprintf(fragmentation, sizeof(fragmentation), "%d%%", measured.fragmentation);
+
+        std::printf("%-10s %12.2f %14.2f %14.2f %9.2fx %14.2f %6s\n", allocator.name, mops,
+                    mib(measured.peak_live), mib(measured.peak_footprint), overhead,
+                    mib(measured.final_footprint), fragmentation);
+    };
+
+    return failures ? 1 : 0;
+};
@@ -0,0 +1,82 @@
+// Glue that runs the kernel allocator inside a host process. Built with the
+// kernel's freestanding flags and headers, see CMakeLists.txt.
+#include <common/console.hpp>
+#include <common/cppruntime_support.hpp>
+#include <common/lib/memory.hpp>
+#include <common/lib/page_alloc.hpp>
+#include <common/lib/thread.hpp>
+
+extern "C" int  putchar(int c);
+extern "C" void abort();
+
+// Linker symbols memory.cpp refers to
+extern "C" {
+    char __text_start, _image_end, _heap_start, _heap_end;
+}
+
+[[noreturn]] void panic(const char* msg) {
+    console::put_string("KERNEL PANIC: ");
+    console::put_string(msg);
+    console::put_character('\n');
+    abort();
+    __builtin_unreachable();
+};
+
+// No zeroing thread on the host, calloc clears its pages inline
+extern "C" void* alloc_zeroed_pages(const unsigned order, const unsigned node) {
+    void* ptr = alloc_pages_node(order, node);
+    if (ptr)
+        memset(ptr, 0, PAGE_SIZE << order);
+
+    return ptr;
+};
+
+std::size_t zeroed_pool_count() {
+    return 0;
+};
+
+bool drain_zeroed_pools() {
+    return false;
+};
+
+// Single-threaded replay, nothing to preempt or to lock out
+void preempt_disable() {};
+void preempt_enable() {};
+
+void CpuLock::lock() {};
+void CpuLock::unlock() {};
+
+bool CpuLock::held() const {
+    return true;
+};
+
+void console::initialize() {};
+void console::lock() {};
+void console::unlock() {};
+
+void console::put_character(const char c) {
+    putchar(c);
+};
+
+void console::put_string(const char* str) {
+    while (*str) putchar(*str++);
+};
+
+extern "C" void prism_heap_init(void* base, const std::size_t size) {
+    page_alloc_add_range(reinterpret_cast<std::uintptr_t>(base), size);
+};
+
+// Memory taken from the page allocator, including slab pages and TLSF pools
+extern "C" std::size_t prism_heap_footprint() {
+    return (total_pages() - free_pages_count()) * PAGE_SIZE;
+};
+
+// Share of free TLSF memory outside the largest free block, in percent
+extern "C" int prism_heap_fragmentation() {
+    HeapStats stats{};
+    heap_get_stats(stats);
+    if (stats.free_block_bytes == 0)
+        return 0;
+
+    return static_cast<int>(100 - stats.largest_free_block * 100 / stats.free_block_bytes);
+};
@@ -0,0 +1,28 @@
+#pragma once
+#include "common/std/stdint.hpp"
+
+// Host stand-in for the kernel's cpu.hpp. The replay runs on one CPU, has no
+// interrupts to mask and keeps no time.
+namespace cpu {
+    constexpr unsigned MAX_CPUS = 1;
+
+    inline unsigned id() {
+        return 0;
+    };
+
+    inline std::uint64_t counter() {
+        return 0;
+    };
+
+    inline std::uint64_t counter_frequency() {
+        return 1'000'000'000;
+    };
+
+    inline std::uint64_t irq_save() {
+        return 0;
+    };
+
+    inline void irq_restore(const std::uint64_t) {};
+
+    inline void relax() {};
+}; // namespace cpu
@@ -0,0 +1,90 @@
+#include "trace.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+static int hex_digit(const char c) {
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+
+    return -1;
+};
+
+static std::uint64_t field(const std::string& line, const char* key) {
+    const std::size_t pos = line.find(key);
+    if (pos == std::string::npos)
+        return 0;
+
+    return std::strtoull(line.c_str() + pos + std::strlen(key), nullptr, 10);
+};
+
+bool load_trace(const std::string& path, Trace& trace, std::string& error) {
+    std::ifstream in(path);
+    if (!in) {
+        error = "cannot open " + path;
+        return false;
+    };
+
+    constexpr const char* BEGIN = "PRISM-HEAP-TRACE BEGIN";
+    constexpr const char* END   = "PRISM-HEAP-TRACE END";
+
+    bool        inside = false;
+    bool        found  = false;
+    Trace       current;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+
+        if (line.find(BEGIN) != std::string::npos) {
+            // A later dump replaces an earlier one
+            current           = Trace{};
+            current.dropped   = field(line, "dropped=");
+            current.frequency = field(line, "frequency=");
+            inside            = true;
+            continue;
+        };
+
+        if (!inside)
+            continue;
+
+        if (line.find(END) != std::string::npos) {
+            trace  = std::move(current);
+            found  = true;
+            inside = false;
+            continue;
+        };
+
+        if (line.size() != sizeof(TraceRecord) * 2) {
+            error = "malformed trace line: " + line;
+            return false;
+        };
+
+        TraceRecord   record;
+        std::uint8_t* bytes = reinterpret_cast<std::uint8_t*>(&record);
+        for (std::size_t i = 0; i < sizeof(TraceRecord); ++i) {
+            const int hi = hex_digit(line[2 * i]);
+            const int lo = hex_digit(line[2 * i + 1]);
+            if (hi < 0 || lo < 0) {
+                error = "malformed trace line: " + line;
+                return false;
+            };
+
+            bytes[i] = static_cast<std::uint8_t>(hi << 4 | lo);
+        };
+
+        current.records.push_back(record);
+    };
+
+    if (!found) {
+        error = "no complete PRISM-HEAP-TRACE block in " + path;
+        return false;
+    };
+
+    return true;
+};
@@ -0,0 +1,34 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Mirrors HeapTraceRecord in kernel/common/lib/memory.hpp
+enum class TraceOp : std::uint8_t {
+    MALLOC = 1,
+    FREE,
+    REALLOC,
+    ALIGNED_ALLOC,
+};
+
+struct TraceRecord {
+    std::uint64_t timestamp;
+    std::uint32_t id;
+    std::uint32_t old_id;
+    std::uint32_t size;
+    std::uint16_t align_log2;
+    TraceOp       op;
+    std::uint8_t  reserved;
+};
+
+static_assert(sizeof(TraceRecord) == 24);
+
+struct Trace {
+    std::vector<TraceRecord> records;
+    std::uint64_t            dropped   = 0; // Overwritten in the ring before the dump
+    std::uint64_t            frequency = 0; // Timestamp ticks per second
+};
+
+// Reads the last PRISM-HEAP-TRACE block from a serial log. Returns false and
+// sets error if there is none or it is malformed.
+bool load_trace(const std::string& path, Trace& trace, std::string& error);
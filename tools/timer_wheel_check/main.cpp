@@ -0,0 +1,164 @@
+// Runs the kernel timer wheel against a simulated counter and checks that every
+// timer fires in its slot or the one after, never early and never later.
+// Stepping from one programmed deadline to the next, as the timer interrupt
+// does, also catches timers that the wheel leaves out of its next deadline.
+//
+//   timer_wheel_check [--rounds N] [--seed N]
+#include <arch/aarch64/cpu.hpp>
+#include <arch/aarch64/timer.hpp>
+#include <common/lib/timer_wheel.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static std::uint64_t now;      // Counter ticks, one per slot
+static std::uint64_t deadline; // Last one programmed, 0 for none
+
+std::uint64_t cpu::counter() {
+    return now;
+};
+
+void timer::set_wheel_deadline(const std::uint64_t value) {
+    deadline = value;
+};
+
+struct Check {
+    Timer         timer;
+    std::uint64_t due;
+    std::uint64_t fired_at;
+    bool          armed;
+    bool          fired;
+};
+
+static unsigned long long failures;
+static unsigned long long worst_lateness;
+
+static void on_fire(void* context) {
+    auto* check = static_cast<Check*>(context);
+    if (check->fired || !check->armed) {
+        std::printf("timer due at %llu fired twice or after cancel\n", check->due);
+        failures++;
+    };
+
+    check->fired    = true;
+    check->fired_at = now;
+};
+
+static void arm(Check& check, const std::uint64_t due) {
+    std::memset(&check, 0, sizeof(check));
+    check.timer.callback = on_fire;
+    check.timer.context  = &check;
+    check.due            = due;
+    check.armed          = true;
+    add_timer(&check.timer, due);
+};
+
+// Takes the counter to each programmed deadline in turn, up to until
+static void run_until(const std::uint64_t until) {
+    while (deadline && deadline <= until) {
+        if (deadline > now)
+            now = deadline;
+
+        run_timers();
+    };
+
+    if (until > now)
+        now = until;
+};
+
+static bool verify(const Check* checks, const std::size_t count) {
+    bool ok = true;
+    for (std::size_t i = 0; i < count; ++i) {
+        const Check& check = checks[i];
+        if (!check.armed)
+            continue;
+
+        if (!check.fired) {
+            std::printf("timer due at %llu never fired\n", check.due);
+            ok = false;
+            continue;
+        };
+
+        const std::uint64_t lateness = check.fired_at - check.due;
+        if (check.fired_at < check.due || lateness > 1) {
+            std::printf("timer due at %llu fired at %llu\n", check.due, check.fired_at);
+            ok = false;
+        };
+
+        if (check.fired_at >= check.due && lateness > worst_lateness)
+            worst_lateness = lateness;
+    };
+
+    return ok;
+};
+
+// A run that ends on the last slot before a 64-slot boundary leaves the wheel
+// on the boundary. The timer in the level 1 slot that comes up there must
+// still be part of the next deadline.
+static bool check_boundary() {
+    Check checks[2];
+
+    now      = 1000;
+    deadline = 0;
+    arm(checks[0], 1023);
+    arm(checks[1], 1080);
+    run_until(1100);
+
+    return verify(checks, 2);
+};
+
+static std::uint64_t rng_state;
+
+static std::uint64_t rng() {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+};
+
+// Timers of every scale armed at random times, some cancelled before they run
+static bool check_random(const std::size_t rounds) {
+    constexpr std::size_t TIMERS = 64;
+
+    auto* checks = new Check[TIMERS * rounds]{};
+    for (std::size_t round = 0; round < rounds; ++round) {
+        Check* batch = checks + round * TIMERS;
+        for (std::size_t i = 0; i < TIMERS; ++i) {
+            run_until(now + rng() % 64);
+            const std::uint64_t delay = rng() % (1ull << rng() % 22);
+            arm(batch[i], now + delay);
+
+            if (rng() % 8 == 0) {
+                Check& victim = batch[rng() % (i + 1)];
+                if (victim.armed && !victim.fired && cancel_timer(&victim.timer))
+                    victim.armed = false;
+            };
+        };
+    };
+
+    while (pending_timers()) run_until(deadline);
+
+    const bool ok = verify(checks, TIMERS * rounds);
+    delete[] checks;
+    return ok;
+};
+
+int main(int argc, char** argv) {
+    std::size_t rounds = 200;
+    rng_state          = 0x9e3779b97f4a7c15ull;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (!std::strcmp(argv[i], "--rounds"))
+            rounds = std::strtoull(argv[i + 1], nullptr, 0);
+        else if (!std::strcmp(argv[i], "--seed"))
+            rng_state = std::strtoull(argv[i + 1], nullptr, 0) | 1;
+    };
+
+    bool ok = check_boundary();
+    ok      = check_random(rounds) && ok;
+
+    std::printf("%s: %llu slot(s) worst lateness\n", ok && !failures ? "ok" : "FAILED",
+                worst_lateness);
+    return ok && !failures ? 0 : 1;
+};
@@ -0,0 +1,26 @@
+#pragma once
+#include "common/std/stdint.hpp"
+
+// Host stand-in for the kernel's cpu.hpp: a single CPU, and a counter that
+// main.cpp moves by hand, one tick per wheel slot
+namespace cpu {
+    constexpr unsigned MAX_CPUS = 1;
+
+    std::uint64_t counter();
+
+    inline unsigned id() {
+        return 0;
+    };
+
+    inline std::uint64_t counter_frequency() {
+        return 1000; // WHEEL_HZ
+    };
+
+    inline std::uint64_t irq_save() {
+        return 0;
+    };
+
+    inline void irq_restore(const std::uint64_t) {};
+
+    inline void relax() {};
+}; // namespace cpu
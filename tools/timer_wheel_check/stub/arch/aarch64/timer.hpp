@@ -0,0 +1,7 @@
+#pragma once
+#include "common/std/stdint.hpp"
+
+// Host stand-in for the kernel's timer.hpp, main.cpp keeps the deadline
+namespace timer {
+    void set_wheel_deadline(std::uint64_t deadline);
+}; // namespace timer